@@ -0,0 +1,221 @@
+#include "batchMode.hpp"
+#include <sstream>
+
+typedef boost::chrono::high_resolution_clock boost_clock;
+
+static char const *result_name(PZ3_Result result)
+{
+    switch (result)
+    {
+    case PZ3_sat:
+        return "sat";
+    case PZ3_unsat:
+        return "unsat";
+    default:
+        return "unknown";
+    }
+}
+
+// larger files first, so the cores are never waiting for a large file behind small ones
+static bool larger_job(std::pair<long, unsigned> const &a, std::pair<long, unsigned> const &b)
+{
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+static void write_job(batch_run &run, batch_job &job)
+{
+    pthread_mutex_lock(&run.mutex);
+    *run.out << job.path << "," << job.result << "," << job.time_ms << ","
+             << (job.decomposed ? "pz3" : "seq") << std::endl;
+    pthread_mutex_unlock(&run.mutex);
+}
+
+static void solve_small(batch_run &run, context &c, batch_job &job)
+{
+    pz3::Options const &opt = run.solver->get_options();
+    boost_clock::time_point start = boost_clock::now();
+    try
+    {
+        job.result = result_name(solve_sequential(c, job.path, run.solver->get_portfolio(), opt.timeout_ms));
+    }
+    catch (exception &ex)
+    {
+        pthread_mutex_lock(&run.mutex);
+        std::cerr << job.path << ": " << ex.msg() << "\n";
+        pthread_mutex_unlock(&run.mutex);
+        job.result = "error";
+    }
+    boost::chrono::duration<double, boost::milli> elapsed = boost_clock::now() - start;
+    job.time_ms = elapsed.count();
+}
+
+static void solve_large(batch_run &run, batch_job &job)
+{
+    pz3::Result result = run.solver->solve_file(job.path);
+    if (result.error)
+    {
+        pthread_mutex_lock(&run.mutex);
+        std::cerr << result.message << "\n";
+        pthread_mutex_unlock(&run.mutex);
+    }
+    job.result = result.error ? "error" : result_name(result.status);
+    job.time_ms = result.stats.total_ms;
+}
+
+void *batch_worker(void *arg)
+{
+    batch_run &run = *(batch_run *) arg;
+    // one context serves all small files of this worker
+    config cfg;
+    cfg.set("MODEL", true);
+    cfg.set("PROOF", true);
+    context c(cfg);
+    pthread_mutex_lock(&run.mutex);
+    while (run.next < run.queue.size())
+    {
+        // a large file has the cores
+        if (run.exclusive)
+        {
+            pthread_cond_wait(&run.idle, &run.mutex);
+            continue;
+        }
+        batch_job &job = run.jobs.at(run.queue.at(run.next));
+        run.next++;
+        if (job.decomposed)
+        {
+            // the cores are taken as the other workers finish their files
+            run.exclusive = true;
+            while (run.busy > 0)
+                pthread_cond_wait(&run.idle, &run.mutex);
+            pthread_mutex_unlock(&run.mutex);
+            solve_large(run, job);
+            write_job(run, job);
+            pthread_mutex_lock(&run.mutex);
+            run.exclusive = false;
+        }
+        else
+        {
+            run.busy++;
+            pthread_mutex_unlock(&run.mutex);
+            solve_small(run, c, job);
+            write_job(run, job);
+            pthread_mutex_lock(&run.mutex);
+            run.busy--;
+        }
+        pthread_cond_broadcast(&run.idle);
+    }
+    pthread_mutex_unlock(&run.mutex);
+    return NULL;
+}
+
+int solve_batch(std::string const &list_path, std::string const &out_path, pz3::Solver &solver)
+{
+    unsigned core_num = solver.get_options().core_num;
+    std::ifstream list(list_path.c_str());
+    if (!list)
+    {
+        std::cerr << "File list doesn't exist.\n";
+        return 1;
+    }
+    batch_run run;
+    run.solver = &solver;
+    run.next = 0;
+    run.busy = 0;
+    run.exclusive = false;
+    std::ofstream out_file;
+    run.out = &std::cout;
+    if (!out_path.empty())
+    {
+        out_file.open(out_path.c_str());
+        if (!out_file)
+        {
+            std::cerr << "Cannot write result file.\n";
+            return 1;
+        }
+        run.out = &out_file;
+    }
+    pthread_mutex_init(&run.mutex, NULL);
+    pthread_cond_init(&run.idle, NULL);
+
+    std::string line;
+    while (std::getline(list, line))
+    {
+        std::istringstream in(line);
+        std::string path;
+        if (!(in >> path) || path[0] == '#')
+            continue;
+        batch_job job;
+        job.path = path;
+        job.result = "error";
+        job.time_ms = 0;
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::ate);
+        job.size = file ? (long) file.tellg() : -1;
+        job.decomposed = (core_num > 1 && job.size >= (long) PZ3_BATCH_SMALL_SIZE);
+        run.jobs.push_back(job);
+    }
+    *run.out << "file,result,time_ms,mode" << std::endl;
+
+    boost_clock::time_point batch_start = boost_clock::now();
+    std::vector<std::pair<long, unsigned> > order;
+    unsigned large_num = 0;
+    for (unsigned i = 0; i < run.jobs.size(); i++)
+    {
+        batch_job &job = run.jobs.at(i);
+        if (job.size < 0)
+        {
+            std::cerr << job.path << ": SMTLIB file doesn't exist.\n";
+            write_job(run, job);
+            continue;
+        }
+        if (job.decomposed)
+            large_num++;
+        order.push_back(std::make_pair(job.size, i));
+    }
+    std::sort(order.begin(), order.end(), larger_job);
+    for (unsigned i = 0; i < order.size(); i++)
+    {
+        run.queue.push_back(order[i].second);
+    }
+
+    // One worker per core
+    unsigned worker_num = std::min((unsigned) run.queue.size(), core_num);
+    pthread_t *thread_handles = (pthread_t *) malloc(core_num * sizeof(pthread_t));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    for (unsigned i = 0; i < worker_num; i++)
+    {
+        // a solver built with PZ3_ONECORE places no threads, so there is no CPU to bind to
+        if (core_num > 1 && solver.get_options().bind_threads)
+            solver.get_topology().bind(&attr, solver.get_topology().get_slave_cpu(i));
+        pthread_create(&thread_handles[i], &attr, batch_worker, &run);
+    }
+    for (unsigned i = 0; i < worker_num; i++)
+    {
+        pthread_join(thread_handles[i], NULL);
+    }
+    pthread_attr_destroy(&attr);
+    free(thread_handles);
+
+    // Summary
+    unsigned sat_num = 0, unsat_num = 0, unknown_num = 0, error_num = 0;
+    for (unsigned i = 0; i < run.jobs.size(); i++)
+    {
+        std::string const &result = run.jobs.at(i).result;
+        if (result == "sat")
+            sat_num++;
+        else if (result == "unsat")
+            unsat_num++;
+        else if (result == "unknown")
+            unknown_num++;
+        else
+            error_num++;
+    }
+    boost::chrono::duration<double, boost::milli> total = boost_clock::now() - batch_start;
+    std::cerr << "Batch: " << run.jobs.size() << " files (" << run.queue.size() - large_num << " sequential, "
+              << large_num << " decomposed), sat " << sat_num << ", unsat " << unsat_num
+              << ", unknown " << unknown_num << ", error " << error_num
+              << ", total " << total.count() << " ms" << std::endl;
+    pthread_cond_destroy(&run.idle);
+    pthread_mutex_destroy(&run.mutex);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef _BATCH_MODE_H_
+#define _BATCH_MODE_H_
+
+#include "pz3Solver.hpp"
+#include <string>
+
+// files smaller than this (in bytes) are solved by sequential Z3 on one core, larger ones are decomposed
+#define PZ3_BATCH_SMALL_SIZE (512u * 1024u)
+
+// batch_job: a file of a batch and its outcome
+struct batch_job
+{
+    std::string path;
+    // size of the file, -1 if it cannot be opened
+    long size;
+    bool decomposed;
+    std::string result;
+    double time_ms;
+};
+
+/*
+  batch_run: state of one call of solve_batch(), shared by its workers under mutex. queue holds the
+  jobs in the order they are taken, next is the first one not taken yet. busy is the number of
+  workers solving small files; exclusive is set while a large file waits for them or is solved.
+*/
+struct batch_run
+{
+    pz3::Solver *solver;
+    std::vector<batch_job> jobs;
+    std::vector<unsigned> queue;
+    unsigned next;
+    unsigned busy;
+    bool exclusive;
+    std::ostream *out;
+    pthread_mutex_t mutex;
+    pthread_cond_t idle;
+};
+
+/*
+  Batch mode: solve every file listed in list_path (one path per line, '#' starts a comment) in one
+  process. All files go into one queue, largest first, taken by one worker per core. A small file is
+  solved by sequential Z3 on the core of its worker, in a context the worker keeps; a large file is
+  decomposed using all cores, so its worker waits until the others are done with their files, and
+  they wait until it is solved. The time limit and the first configuration of the portfolio of
+  solver apply to both.
+  One line "file,result,time_ms,mode" is written per file to out_path (stdout if empty) as soon as
+  the file is done. Large files are solved by solver, which also gives the number of cores.
+*/
+int solve_batch(std::string const &list_path, std::string const &out_path, pz3::Solver &solver);
+
+/* Worker thread of a batch_run taking files from its queue */
+void *batch_worker(void *arg);
+
+#endif
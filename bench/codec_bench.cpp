@@ -0,0 +1,129 @@
+// Benchmark of the binary format in exprCodec against SMTLIB2 text
+// Usage: codec_bench [Repetitions] [SMTLIB2 files]
+// The assertions of every file are written and read back into a fresh context, once as SMTLIB2 text
+// (Z3_benchmark_to_smtlib_string and the parser), once as a document of the binary format. Sizes are
+// in bytes and times are the average of the repetitions. The document is also read into the first
+// context, so same_check tells whether every assertion came back as the same term.
+
+#include "../exprCodec.hpp"
+
+typedef boost::chrono::high_resolution_clock boost_clock;
+
+static double ms_since(boost_clock::time_point start)
+{
+    return boost::chrono::duration_cast<boost::chrono::microseconds>(boost_clock::now() - start).count() / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " [Repetitions] [SMTLIB2 files]" << std::endl;
+        exit(1);
+    }
+    int rep = atoi(argv[1]);
+    if (rep < 1)
+        rep = 1;
+    std::cout << "file,assertions,text_bytes,text_write_ms,text_read_ms,bin_bytes,bin_write_ms,bin_read_ms,same_check" << std::endl;
+    for (int f = 2; f < argc; f++)
+    {
+        context c;
+        Z3_ast m_fs = Z3_parse_smtlib2_file(c, argv[f], 0, 0, 0, 0, 0, 0);
+        if (Z3_get_error_code(c) != Z3_OK)
+        {
+            std::cerr << "cannot read " << argv[f] << std::endl;
+            continue;
+        }
+        expr fs(c, m_fs);
+        expr_vector items(c);
+        if (fs.is_app() && fs.decl().decl_kind() == Z3_OP_AND)
+        {
+            for (unsigned i = 0; i < fs.num_args(); i++)
+                items.push_back(fs.arg(i));
+        }
+        else
+            items.push_back(fs);
+        unsigned num = items.size();
+
+        // SMTLIB2: all assertions but the last one are written as assumptions
+        std::string text;
+        double text_write = 0, text_read = 0;
+        for (int r = 0; r < rep; r++)
+        {
+            boost_clock::time_point start = boost_clock::now();
+            array<Z3_ast> assumptions(num - 1);
+            for (unsigned i = 0; i + 1 < num; i++)
+                assumptions[i] = items[i];
+            expr last = items[num - 1];
+            text = Z3_benchmark_to_smtlib_string(c, "", "", "unknown", "", num - 1, assumptions.ptr(), last);
+            text_write += ms_since(start);
+
+            context other;
+            start = boost_clock::now();
+            Z3_parse_smtlib2_string(other, text.c_str(), 0, 0, 0, 0, 0, 0);
+            text_read += ms_since(start);
+        }
+
+        // binary: one expression section holding the table and the index of every assertion
+        std::string doc;
+        double bin_write = 0, bin_read = 0;
+        bool same = true;
+        for (int r = 0; r < rep; r++)
+        {
+            boost_clock::time_point start = boost_clock::now();
+            exprEncoder table;
+            binWriter body;
+            std::vector<unsigned> roots(num);
+            for (unsigned i = 0; i < num; i++)
+            {
+                if (!table.add(items[i], roots[i]))
+                {
+                    std::cerr << argv[f] << " has terms beyond QF_UF" << std::endl;
+                    exit(1);
+                }
+            }
+            table.write(body);
+            body.put(num);
+            for (unsigned i = 0; i < num; i++)
+                body.put(roots[i]);
+            binWriter out;
+            out.put_header();
+            out.put_section(PZ3_sec_exprs, body);
+            doc = out.data();
+            bin_write += ms_since(start);
+
+            context other;
+            expr_vector decoded(other);
+            start = boost_clock::now();
+            binReader in(doc);
+            binReader section(NULL, 0);
+            unsigned tag, root_num;
+            exprDecoder reader(other);
+            bool ok = in.get_header() && in.get_section(tag, section) && tag == PZ3_sec_exprs;
+            ok = ok && reader.read(section) && section.get(root_num) && root_num == num;
+            for (unsigned i = 0; ok && i < root_num; i++)
+            {
+                expr e(other);
+                ok = reader.get(section, e);
+                decoded.push_back(e);
+            }
+            bin_read += ms_since(start);
+
+            // read into the first context too, where every assertion must come back as itself
+            binReader again(doc);
+            exprDecoder checker(c);
+            checker.know(fs);
+            ok = ok && again.get_header() && again.get_section(tag, section) && checker.read(section) && section.get(root_num);
+            for (unsigned i = 0; ok && i < num; i++)
+            {
+                expr e(c);
+                ok = checker.get(section, e) && Z3_get_ast_id(c, e) == Z3_get_ast_id(c, items[i]);
+            }
+            same = same && ok;
+        }
+
+        std::cout << argv[f] << "," << num << "," << text.size() << "," << text_write / rep << "," << text_read / rep << ","
+                  << doc.size() << "," << bin_write / rep << "," << bin_read / rep << "," << (same ? "yes" : "no") << std::endl;
+    }
+    return 0;
+}
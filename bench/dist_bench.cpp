@@ -0,0 +1,123 @@
+// Benchmark of clause distribution methods in dist/
+// Usage: dist_bench_<method> [Number of cores] [Repetitions] [SMTLIB2 files generated by eval/gen.py]
+// Clauses and symbols are read straight from the text written by gen.py, so Z3 is not involved.
+// Besides time, the quality of a distribution is reported as the number of shared symbols
+// (symbols appearing in more than one partition, as computed by shared_collect) and the size of
+// the largest partition relative to an even split.
+
+#include "../dist/dist.hpp"
+#include "../flatMap.hpp"
+#include "../symbolTable.hpp"
+#include <sstream>
+
+typedef boost::chrono::high_resolution_clock boost_clock;
+
+
+// read clauses of a gen.py instance: every "(or ...)" is a clause over symbols "x<n>"
+static bool read_instance(char const *path, std::vector<symbol_list> &symbol_sub, unsigned &symbol_num)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::stringstream buf;
+    buf << file.rdbuf();
+    std::string text = buf.str();
+
+    flat_map<unsigned, unsigned> ids;
+    std::string::size_type pos = text.find("(assert");
+    if (pos == std::string::npos)
+        return false;
+    unsigned len = text.size();
+    while (pos < len)
+    {
+        if (text.compare(pos, 4, "(or ") == 0)
+        {
+            symbol_sub.push_back(symbol_list());
+            pos += 4;
+        }
+        else if (text[pos] == 'x' && !symbol_sub.empty())
+        {
+            unsigned name = 0;
+            pos++;
+            while (pos < len && text[pos] >= '0' && text[pos] <= '9')
+            {
+                name = name * 10 + (text[pos] - '0');
+                pos++;
+            }
+            unsigned id = ids.insert(std::pair<unsigned, unsigned>(name, ids.size())).first->second;
+            symbol_sub.back().push_back(id);
+        }
+        else
+            pos++;
+    }
+    symbol_num = ids.size();
+    for (unsigned i = 0; i < symbol_sub.size(); i++)
+        sort_symbols(symbol_sub.at(i));
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " [Number of cores] [Repetitions] [SMTLIB2 files]" << std::endl;
+        exit(1);
+    }
+    int core_num = atoi(argv[1]);
+    int rep = atoi(argv[2]);
+    // dist_check is a checksum of the clause distribution, for comparing implementations
+    std::cout << "file,clauses,symbols,dist_ms,shared,max_part,dist_check" << std::endl;
+    for (int f = 3; f < argc; f++)
+    {
+        std::vector<symbol_list> symbol_sub;
+        unsigned symbol_num = 0;
+        if (!read_instance(argv[f], symbol_sub, symbol_num))
+        {
+            std::cerr << "cannot read " << argv[f] << std::endl;
+            continue;
+        }
+        std::vector<int> clause_weight(symbol_sub.size());
+        for (unsigned i = 0; i < symbol_sub.size(); i++)
+            clause_weight.at(i) = symbol_sub.at(i).size() * PZ3_VAR_WEIGHT;
+
+        std::vector<int> expr_dist;
+        boost_clock::time_point start = boost_clock::now();
+        for (int r = 0; r < rep; r++)
+        {
+            dist_clause(core_num, symbol_num, symbol_sub, clause_weight, expr_dist);
+        }
+        boost::chrono::duration<double, boost::milli> elapsed = boost_clock::now() - start;
+        unsigned check = 0;
+        for (unsigned i = 0; i < expr_dist.size(); i++)
+            check = flat_mix(check ^ (i * core_num + expr_dist.at(i)));
+        // quality of the distribution
+        std::vector<int> first_part(symbol_num, -1);
+        std::vector<bool> is_shared(symbol_num, false);
+        std::vector<unsigned> part_size(core_num, 0);
+        for (unsigned i = 0; i < symbol_sub.size(); i++)
+        {
+            int part = expr_dist.at(i);
+            part_size.at(part)++;
+            symbol_list &syms = symbol_sub.at(i);
+            for (unsigned j = 0; j < syms.size(); j++)
+            {
+                if (first_part[syms[j]] < 0)
+                    first_part[syms[j]] = part;
+                else if (first_part[syms[j]] != part)
+                    is_shared[syms[j]] = true;
+            }
+        }
+        unsigned shared = 0;
+        for (unsigned i = 0; i < symbol_num; i++)
+            if (is_shared[i])
+                shared++;
+        unsigned max_part = 0;
+        for (int i = 0; i < core_num; i++)
+            if (part_size.at(i) > max_part)
+                max_part = part_size.at(i);
+        std::cout << argv[f] << "," << symbol_sub.size() << "," << symbol_num << ","
+                  << elapsed.count() / rep << "," << shared << ","
+                  << (double) max_part * core_num / symbol_sub.size() << "," << check << std::endl;
+    }
+    return 0;
+}
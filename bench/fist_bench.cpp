@@ -0,0 +1,160 @@
+// Micro-benchmark of containers for function instances
+// Compares the former layout (std::map keyed by instances holding a boost::shared_ptr<closure[]>)
+// with the interned fist_map, and std::map<closure, closure> with flat_map, at 10^5 .. 10^6 entries.
+
+#include "../fistTable.hpp"
+#include "../flatMap.hpp"
+
+typedef boost::chrono::high_resolution_clock boost_clock;
+
+// the layout of func_inst before interning
+class legacy_func_inst
+{
+public:
+    unsigned func;
+    unsigned domain_len;
+    boost::shared_ptr<closure[]> domain;
+
+    legacy_func_inst(fist_key const &key)
+    {
+        func = key.get_func();
+        domain_len = key.get_domain_length();
+        domain = boost::shared_ptr<closure[]>(new closure[domain_len]);
+        for (unsigned i = 0; i < domain_len; i++)
+            domain[i] = key.get_domain()[i];
+    }
+
+    friend bool operator<(const legacy_func_inst &lhs, const legacy_func_inst &rhs)
+    {
+        if (lhs.func < rhs.func) return true;
+        if (lhs.func > rhs.func) return false;
+        for (unsigned i = 0; i < lhs.domain_len; ++i)
+        {
+            if (lhs.domain[i] < rhs.domain[i]) return true;
+            if (lhs.domain[i] > rhs.domain[i]) return false;
+        }
+        return false;
+    }
+};
+
+static unsigned rand_state = 20170805u;
+
+static unsigned next_rand()
+{
+    rand_state = rand_state * 1103515245u + 12345u;
+    return rand_state >> 8;
+}
+
+static double mops(unsigned num, boost_clock::time_point start)
+{
+    boost::chrono::duration<double> sec = boost_clock::now() - start;
+    return num / sec.count() / 1e6;
+}
+
+static void bench_fist(unsigned num)
+{
+    // keys: functions of arity 1..3 over a pool of closures of 4 sorts
+    // (as in PZ3, the arity is fixed by the function)
+    std::vector<fist_key> keys(num);
+    for (unsigned i = 0; i < num; i++)
+    {
+        unsigned func = next_rand() % 64 + 1;
+        unsigned arity = func % 3 + 1;
+        keys[i].reset(func);
+        for (unsigned j = 0; j < arity; j++)
+            keys[i].push(closure(next_rand() % 4 + 1, next_rand() % (num / 4 + 1)));
+    }
+
+    std::vector<legacy_func_inst> legacy;
+    for (unsigned i = 0; i < num; i++)
+        legacy.push_back(legacy_func_inst(keys[i]));
+
+    boost_clock::time_point start = boost_clock::now();
+    std::map<legacy_func_inst, closure> tree;
+    for (unsigned i = 0; i < num; i++)
+        tree.insert(std::pair<legacy_func_inst, closure>(legacy[i], closure(1, i)));
+    double tree_ins = mops(num, start);
+
+    start = boost_clock::now();
+    unsigned hit = 0;
+    for (unsigned i = 0; i < num; i++)
+        if (tree.find(legacy[i]) != tree.end())
+            hit++;
+    double tree_find = mops(num, start);
+
+    start = boost_clock::now();
+    fist_map<closure> flat;
+    for (unsigned i = 0; i < num; i++)
+        flat.insert(keys[i], closure(1, i));
+    double flat_ins = mops(num, start);
+
+    start = boost_clock::now();
+    unsigned flat_hit = 0;
+    unsigned id;
+    for (unsigned i = 0; i < num; i++)
+        if (flat.find(keys[i], id))
+            flat_hit++;
+    double flat_find = mops(num, start);
+
+    if (hit != num || flat_hit != num || tree.size() != flat.size())
+    {
+        std::cerr << "inconsistent results" << std::endl;
+        exit(1);
+    }
+    std::cout << "func_inst," << num << "," << tree_ins << "," << tree_find << ","
+              << flat_ins << "," << flat_find << std::endl;
+}
+
+static void bench_closure(unsigned num)
+{
+    std::vector<closure> keys(num);
+    for (unsigned i = 0; i < num; i++)
+        keys[i] = closure(next_rand() % 4 + 1, next_rand());
+
+    boost_clock::time_point start = boost_clock::now();
+    std::map<closure, closure> tree;
+    for (unsigned i = 0; i < num; i++)
+        tree.insert(std::pair<closure, closure>(keys[i], keys[i]));
+    double tree_ins = mops(num, start);
+
+    start = boost_clock::now();
+    unsigned hit = 0;
+    for (unsigned i = 0; i < num; i++)
+        if (tree.find(keys[i]) != tree.end())
+            hit++;
+    double tree_find = mops(num, start);
+
+    start = boost_clock::now();
+    flat_map<closure, closure> flat;
+    for (unsigned i = 0; i < num; i++)
+        flat.insert(std::pair<closure, closure>(keys[i], keys[i]));
+    double flat_ins = mops(num, start);
+
+    start = boost_clock::now();
+    unsigned flat_hit = 0;
+    for (unsigned i = 0; i < num; i++)
+        if (flat.find(keys[i]) != flat.end())
+            flat_hit++;
+    double flat_find = mops(num, start);
+
+    if (hit != num || flat_hit != num || tree.size() != flat.size())
+    {
+        std::cerr << "inconsistent results" << std::endl;
+        exit(1);
+    }
+    std::cout << "closure," << num << "," << tree_ins << "," << tree_find << ","
+              << flat_ins << "," << flat_find << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // throughput in million operations per second
+    std::cout << "container,size,map_insert,map_lookup,flat_insert,flat_lookup" << std::endl;
+    unsigned sizes[] = {100000u, 300000u, 1000000u};
+    for (unsigned i = 0; i < 3; i++)
+    {
+        bench_fist(sizes[i]);
+        bench_closure(sizes[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Regression check of incremental solving against sequential Z3
+// Usage: inc_check [Number of cores] [SMTLIB2 files]
+// The assertions of every file are split into 4 chunks, given to an incremental pz3::Solver as
+//   chunk 0, check; chunk 1, check; push, chunk 2, check; pop, check; chunks 2 and 3, check
+// and every result is compared with the one of a sequential solver (1 core) on the declarations and
+// the assertions in scope at that check. A line of CSV is written per check, and the check exits
+// with 1 if any sat result stands against an unsat one.
+
+#include "../pz3Solver.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define INC_CHUNKS 4
+
+static char const *result_name(PZ3_Result r)
+{
+    switch (r)
+    {
+    case PZ3_sat:
+        return "sat";
+    case PZ3_unsat:
+        return "unsat";
+    default:
+        return "unknown";
+    }
+}
+
+// declarations and the assertions of every chunk of a file, in the order of the file
+static bool read_chunks(char const *path, std::string &decls, std::vector<std::vector<std::string> > &chunks)
+{
+    smtInput input;
+    if (input.open(path) != PZ3_file_ok)
+        return false;
+    std::vector<std::string> asserts;
+    for (unsigned i = 0; i < input.command_num(); i++)
+    {
+        if (input.command_kind(i) == PZ3_cmd_decl)
+            decls += input.command_text(i) + "\n";
+        else if (input.command_kind(i) == PZ3_cmd_assert)
+            asserts.push_back(input.command_text(i));
+    }
+    input.close();
+    chunks = std::vector<std::vector<std::string> >(INC_CHUNKS);
+    for (unsigned i = 0; i < asserts.size(); i++)
+        chunks.at(i * INC_CHUNKS / asserts.size()).push_back(asserts[i]);
+    return true;
+}
+
+// one step of the sequence: scope change, then the chunks added before the check
+struct inc_step
+{
+    int scope;
+    int chunk_begin;
+    int chunk_end;
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " [Number of cores] [SMTLIB2 files]" << std::endl;
+        exit(1);
+    }
+    pz3::Options inc_opt;
+    inc_opt.core_num = atoi(argv[1]);
+    inc_opt.bind_threads = false;
+    pz3::Options seq_opt;
+    seq_opt.bind_threads = false;
+    // scope: 1 for a push, -1 for a pop before the chunks
+    static const inc_step steps[] = { {0, 0, 1}, {0, 1, 2}, {1, 2, 3}, {-1, 3, 3}, {0, 2, 4} };
+    unsigned step_num = sizeof(steps) / sizeof(steps[0]);
+    bool mismatch = false;
+    std::cout << "file,check,clauses,incremental,sequential" << std::endl;
+    for (int f = 2; f < argc; f++)
+    {
+        std::string decls;
+        std::vector<std::vector<std::string> > chunks;
+        if (!read_chunks(argv[f], decls, chunks))
+        {
+            std::cerr << "cannot read " << argv[f] << std::endl;
+            continue;
+        }
+        pz3::Solver inc(inc_opt);
+        pz3::Solver seq(seq_opt);
+        inc.declare(decls);
+        // in_scope: chunks asserted at every depth of scopes
+        std::vector<std::vector<int> > in_scope(1);
+        for (unsigned s = 0; s < step_num; s++)
+        {
+            if (steps[s].scope > 0)
+            {
+                inc.push(1);
+                in_scope.push_back(std::vector<int>());
+            }
+            else if (steps[s].scope < 0)
+            {
+                inc.pop(1);
+                in_scope.pop_back();
+            }
+            for (int c = steps[s].chunk_begin; c < steps[s].chunk_end; c++)
+            {
+                for (unsigned i = 0; i < chunks.at(c).size(); i++)
+                    inc.add(chunks.at(c)[i]);
+                in_scope.back().push_back(c);
+            }
+            pz3::Result inc_result = inc.check();
+            std::string text = decls;
+            for (unsigned d = 0; d < in_scope.size(); d++)
+            {
+                for (unsigned k = 0; k < in_scope[d].size(); k++)
+                {
+                    std::vector<std::string> &chunk = chunks.at(in_scope[d][k]);
+                    for (unsigned i = 0; i < chunk.size(); i++)
+                        text += chunk[i] + "\n";
+                }
+            }
+            pz3::Result seq_result = seq.solve_text(text);
+            if (inc_result.error || seq_result.error)
+                std::cerr << argv[f] << ": " << inc_result.message << seq_result.message << std::endl;
+            std::cout << argv[f] << "," << s << "," << inc_result.stats.clause_num << ","
+                      << result_name(inc_result.status) << "," << result_name(seq_result.status) << std::endl;
+            if ((inc_result.status == PZ3_sat && seq_result.status == PZ3_unsat) ||
+                (inc_result.status == PZ3_unsat && seq_result.status == PZ3_sat))
+                mismatch = true;
+        }
+    }
+    if (mismatch)
+        std::cerr << "incremental results differ from sequential Z3" << std::endl;
+    return mismatch ? 1 : 0;
+}
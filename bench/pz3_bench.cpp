@@ -0,0 +1,338 @@
+// Benchmark driver of pz3 over a corpus and a sweep of core numbers
+// Usage: pz3_bench [--solver path] [--reps n] [--timeout s] [--out dir] [--baseline dir] [--threshold %]
+//                  [Maximum cores] [Corpus directory or file list]
+// Every .smt2 file of the corpus is solved by sequential Z3 (pz3 with 1 core) and by pz3 with 2 up to
+// the maximum number of cores, each run in a process of its own with --stats. Times are wall times in
+// milliseconds, the median of the repetitions; a run which does not finish within the timeout is
+// killed, and its time is the timeout, as in data/coreN.csv.
+// Written to the output directory (bench/results by default):
+//   core<N>.csv: case,z3,pz3 for N cores, the schema of data/coreN.csv
+//   runs.csv: every run with its result, rounds, phase times and peak memory
+// With a baseline directory (results of an earlier run), cases slower than the baseline by more than
+// the threshold (10% by default) in core<N>.csv are listed, and so are cases whose result differs
+// between sequential Z3 and pz3. The driver exits with 1 if there is any.
+
+#include <boost/chrono.hpp>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+typedef boost::chrono::steady_clock boost_clock;
+
+// differences below this (in ms) are noise, not regressions
+#define BENCH_NOISE_MS 50
+
+// run_result: one run of pz3 on a case, times in ms
+struct run_result
+{
+    std::string result;
+    long wall_ms;
+    unsigned rounds;
+    double division_ms;
+    double subsolve_ms;
+    double conciliation_ms;
+    double peak_rss_mb;
+
+    run_result()
+    {
+        wall_ms = 0;
+        rounds = 0;
+        division_ms = 0;
+        subsolve_ms = 0;
+        conciliation_ms = 0;
+        peak_rss_mb = 0;
+    }
+};
+
+// append .smt2 files under path (a directory walked recursively, or a file with one path per line)
+static void find_cases(std::string const &path, std::vector<std::string> &cases)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return;
+    if (!S_ISDIR(st.st_mode))
+    {
+        std::ifstream list(path.c_str());
+        std::string line;
+        while (std::getline(list, line))
+        {
+            if (!line.empty() && line[0] != '#')
+                cases.push_back(line);
+        }
+        return;
+    }
+    DIR *dir = opendir(path.c_str());
+    if (dir == NULL)
+        return;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        std::string name = ent->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string sub = path + "/" + name;
+        if (stat(sub.c_str(), &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            find_cases(sub, cases);
+        else if (name.size() > 5 && name.compare(name.size() - 5, 5, ".smt2") == 0)
+            cases.push_back(sub);
+    }
+    closedir(dir);
+}
+
+// number after "key": in a line of --stats, 0 if it is not there
+static double json_number(std::string const &line, char const *key)
+{
+    std::string pattern = std::string("\"") + key + "\":";
+    std::string::size_type pos = line.find(pattern);
+    if (pos == std::string::npos)
+        return 0;
+    return strtod(line.c_str() + pos + pattern.size(), NULL);
+}
+
+static std::string json_string(std::string const &line, char const *key)
+{
+    std::string pattern = std::string("\"") + key + "\":\"";
+    std::string::size_type pos = line.find(pattern);
+    if (pos == std::string::npos)
+        return "";
+    pos += pattern.size();
+    return line.substr(pos, line.find('"', pos) - pos);
+}
+
+/*
+  Run the solver on a case with core_num cores in a process of its own, killing it after timeout_ms.
+  Its output is dropped, and its statistics are read from stats_path.
+*/
+static run_result run_case(std::string const &solver, std::string const &path, unsigned core_num,
+                           long timeout_ms, std::string const &stats_path)
+{
+    run_result run;
+    unlink(stats_path.c_str());
+    std::ostringstream cores;
+    cores << core_num;
+    std::string cores_arg = cores.str();
+    boost_clock::time_point start = boost_clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        run.result = "error";
+        return run;
+    }
+    if (pid == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, 1);
+        dup2(null_fd, 2);
+        char const *args[] = {solver.c_str(), "--stats", stats_path.c_str(), path.c_str(), cores_arg.c_str(), NULL};
+        execv(solver.c_str(), (char *const *) args);
+        _exit(127);
+    }
+    int status = 0;
+    bool timeout = false;
+    while (waitpid(pid, &status, WNOHANG) == 0)
+    {
+        long elapsed = boost::chrono::duration_cast<boost::chrono::milliseconds>(boost_clock::now() - start).count();
+        if (elapsed >= timeout_ms)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            timeout = true;
+            break;
+        }
+        struct timespec nap = {0, 1000000};
+        nanosleep(&nap, NULL);
+    }
+    run.wall_ms = boost::chrono::duration_cast<boost::chrono::milliseconds>(boost_clock::now() - start).count();
+    if (timeout)
+    {
+        run.result = "timeout";
+        run.wall_ms = timeout_ms;
+        return run;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        run.result = "error";
+        return run;
+    }
+    std::ifstream stats(stats_path.c_str());
+    std::string line;
+    if (!std::getline(stats, line))
+    {
+        run.result = "error";
+        return run;
+    }
+    run.result = json_string(line, "result");
+    run.rounds = (unsigned) json_number(line, "rounds");
+    run.division_ms = json_number(line, "division_ms");
+    run.subsolve_ms = json_number(line, "subsolve_ms");
+    run.conciliation_ms = json_number(line, "conciliation_ms");
+    run.peak_rss_mb = json_number(line, "peak_rss_mb");
+    return run;
+}
+
+// the run of median wall time among repetitions
+static run_result median_run(std::vector<run_result> &runs)
+{
+    std::vector<std::pair<long, unsigned> > order;
+    for (unsigned i = 0; i < runs.size(); i++)
+        order.push_back(std::make_pair(runs[i].wall_ms, i));
+    std::sort(order.begin(), order.end());
+    return runs.at(order.at(order.size() / 2).second);
+}
+
+// case -> (z3, pz3) of a core<N>.csv, false if it cannot be read
+static bool read_table(std::string const &path, std::map<std::string, std::pair<long, long> > &table)
+{
+    std::ifstream file(path.c_str());
+    std::string line;
+    if (!file || !std::getline(file, line))
+        return false;
+    while (std::getline(file, line))
+    {
+        std::string::size_type second = line.rfind(',');
+        std::string::size_type first = (second == std::string::npos || second == 0) ? std::string::npos : line.rfind(',', second - 1);
+        if (first == std::string::npos)
+            continue;
+        table[line.substr(0, first)] = std::make_pair(atol(line.c_str() + first + 1), atol(line.c_str() + second + 1));
+    }
+    return true;
+}
+
+// report a time slower than its baseline by more than threshold percent
+static bool slower(std::string const &what, long base, long now, double threshold)
+{
+    if (now - base < BENCH_NOISE_MS || now <= base * (1 + threshold / 100))
+        return false;
+    std::cout << "slower: " << what << ": " << base << " ms -> " << now << " ms (+"
+              << (long) std::floor((now - base) * 100.0 / std::max(base, 1L)) << "%)" << std::endl;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string solver = "./pz3";
+    std::string out_dir = "bench/results";
+    std::string baseline;
+    int reps = 1;
+    long timeout_ms = 600000;
+    double threshold = 10;
+    int arg = 1;
+    while (arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0)
+    {
+        std::string opt = argv[arg];
+        char const *value = argv[arg + 1];
+        if (opt == "--solver")
+            solver = value;
+        else if (opt == "--reps")
+            reps = std::max(atoi(value), 1);
+        else if (opt == "--timeout")
+            timeout_ms = atol(value) * 1000;
+        else if (opt == "--out")
+            out_dir = value;
+        else if (opt == "--baseline")
+            baseline = value;
+        else if (opt == "--threshold")
+            threshold = atof(value);
+        else
+            break;
+        arg += 2;
+    }
+    if (argc - arg != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--solver path] [--reps n] [--timeout s] [--out dir] "
+                  << "[--baseline dir] [--threshold %] [Maximum cores] [Corpus directory or file list]" << std::endl;
+        exit(1);
+    }
+    unsigned max_core = atoi(argv[arg]);
+    std::vector<std::string> cases;
+    find_cases(argv[arg + 1], cases);
+    std::sort(cases.begin(), cases.end());
+    if (max_core < 2 || cases.empty() || timeout_ms <= 0)
+    {
+        std::cerr << "Nothing to run: at least 2 cores and one .smt2 file are needed." << std::endl;
+        exit(1);
+    }
+    mkdir(out_dir.c_str(), 0755);
+    std::string stats_path = out_dir + "/stats.tmp";
+
+    // times[c][n]: median run of case c with n cores, n = 1 being sequential Z3
+    std::vector<std::vector<run_result> > times(cases.size(), std::vector<run_result>(max_core + 1));
+    std::ofstream runs_csv((out_dir + "/runs.csv").c_str());
+    runs_csv << "case,cores,rep,result,wall_ms,rounds,division_ms,subsolve_ms,conciliation_ms,peak_rss_mb" << std::endl;
+    for (unsigned c = 0; c < cases.size(); c++)
+    {
+        for (unsigned n = 1; n <= max_core; n++)
+        {
+            std::vector<run_result> runs;
+            for (int r = 0; r < reps; r++)
+            {
+                run_result run = run_case(solver, cases[c], n, timeout_ms, stats_path);
+                runs_csv << cases[c] << "," << n << "," << r << "," << run.result << "," << run.wall_ms << ","
+                         << run.rounds << "," << run.division_ms << "," << run.subsolve_ms << ","
+                         << run.conciliation_ms << "," << run.peak_rss_mb << std::endl;
+                runs.push_back(run);
+                // a case which times out is not run again
+                if (run.result == "timeout")
+                    break;
+            }
+            times[c][n] = median_run(runs);
+        }
+        std::cerr << cases[c] << std::endl;
+    }
+    unlink(stats_path.c_str());
+
+    bool flagged = false;
+    for (unsigned n = 2; n <= max_core; n++)
+    {
+        std::ostringstream name;
+        name << "/core" << n << ".csv";
+        std::ofstream table((out_dir + name.str()).c_str());
+        table << "case,z3,pz3" << std::endl;
+        for (unsigned c = 0; c < cases.size(); c++)
+            table << cases[c] << "," << times[c][1].wall_ms << "," << times[c][n].wall_ms << std::endl;
+        table.close();
+
+        for (unsigned c = 0; c < cases.size(); c++)
+        {
+            std::string const &seq = times[c][1].result;
+            std::string const &par = times[c][n].result;
+            if ((seq == "sat" && par == "unsat") || (seq == "unsat" && par == "sat"))
+            {
+                std::cout << "mismatch: " << cases[c] << " with " << n << " cores: z3 " << seq << ", pz3 " << par << std::endl;
+                flagged = true;
+            }
+        }
+        std::map<std::string, std::pair<long, long> > base;
+        if (baseline.empty() || !read_table(baseline + name.str(), base))
+            continue;
+        for (unsigned c = 0; c < cases.size(); c++)
+        {
+            std::map<std::string, std::pair<long, long> >::iterator it = base.find(cases[c]);
+            if (it == base.end())
+                continue;
+            std::ostringstream what;
+            what << cases[c] << " with " << n << " cores";
+            if (n == 2)
+                flagged |= slower(cases[c] + " with z3", it->second.first, times[c][1].wall_ms, threshold);
+            flagged |= slower(what.str(), it->second.second, times[c][n].wall_ms, threshold);
+        }
+    }
+    return flagged ? 1 : 0;
+}
@@ -2,11 +2,12 @@ CXX=g++
 CXXFLAGS=-g -Wall -O2
 CXX_OUT_FLAG=-c
 LINK_OUT_FLAG=-o
-LINK_EXTRA_FLAGS=-lz3 -lpthread -lboost_system -lboost_chrono
+LINK_EXTRA_FLAGS=-lz3 -lpthread -lboost_system -lboost_chrono -lz
+# zstd input: add -DPZ3_ZSTD to CXXFLAGS and -lzstd to LINK_EXTRA_FLAGS
+AR=ar
+AR_FLAGS=rcs
 MACRO_FLAG=-D
-PROFILE_MACRO=PZ3_PROFILING
 ONECORE_MACRO=PZ3_ONECORE
-FG_MACRO=PZ3_FINE_GRAINED_PROF
 CXX_EXT=.cpp
 HXX_EXT=.hpp
 EXE_EXT=
@@ -4,6 +4,7 @@ contextManager::contextManager()
 {
     s_ctx = NULL;
     q_ctx.clear();
+    s_mem = 0;
 }
 
 contextManager::~contextManager()
@@ -26,6 +27,7 @@ void contextManager::init_q_ctx(int length)
 	exit(1);
     }
     q_ctx = std::vector<context*>(length, NULL);
+    q_mem = std::vector<double>(length, 0);
 }
 
 void contextManager::mk_q_ctx(int index, config & c)
@@ -63,3 +65,31 @@ context & contextManager::get_s_ctx()
 {
     return *s_ctx;
 }
+
+void contextManager::free_q_ctx(int index)
+{
+    delete q_ctx.at(index);
+    q_ctx.at(index) = NULL;
+}
+
+void contextManager::note_memory(int index, double mem)
+{
+    if(index < 0)
+	s_mem = mem;
+    else
+	q_mem.at(index) = mem;
+}
+
+double contextManager::get_memory(int index)
+{
+    if(index < 0)
+	return s_mem;
+    return q_mem.at(index);
+}
+
+void contextManager::clear_memory()
+{
+    s_mem = 0;
+    for(unsigned i = 0; i < q_mem.size(); i++)
+	q_mem[i] = 0;
+}
@@ -8,6 +8,9 @@ class contextManager
 protected:
     context * s_ctx;
     std::vector<context*> q_ctx;
+    // memory of Z3 (in MB) reported by the last solver checked in every context, see note_memory()
+    std::vector<double> q_mem;
+    double s_mem;
 public:
     contextManager();
     ~contextManager();
@@ -16,6 +19,13 @@ public:
     void mk_s_ctx(config & c);
     context & get_q_ctx(int index);
     context & get_s_ctx();
+    /* Delete the context of a partition which is not used any more */
+    void free_q_ctx(int index);
+    /* Note the memory of Z3 (in MB) after a check in context index (-1 for the shared context) */
+    void note_memory(int index, double mem);
+    /* Memory noted for context index (-1 for the shared context), 0 if none */
+    double get_memory(int index);
+    void clear_memory();
 };
 
 #endif
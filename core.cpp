@@ -1,171 +1,438 @@
 #include "core.hpp"
 #include "contextManager.hpp"
+#include "fistTable.hpp"
+#include "flatMap.hpp"
+#include "symbolTable.hpp"
+#include "cpuTopology.hpp"
+#include "solverPortfolio.hpp"
+#include "pz3Solver.hpp"
 #include "dist/dist.hpp"
 
 #define MAX_STACK_SIZE_PER_THREAD 4000u * 1024u * 1024u
 
 typedef boost::chrono::high_resolution_clock boost_clock;
 
-std::string file_path;
-unsigned core_num;
-contextManager cm;
-
-closure true_clo;
-closure false_clo;
-
-// clause distribution, variable list, clauses per core, formula per core respectively
-std::vector<int> expr_dist;
-std::vector<std::map<unsigned, int> > expr_var;
-std::vector<std::map<unsigned, int> > expr_fun;
-
-// FIXME: use expr_vector instead of std::vector<expr>
-std::vector<std::vector<expr> > expr_table;
-// expr_list: sub-formulas for every core
-std::vector<expr> expr_list;
-
-// structures on shared variables
-// sv_set: set of shared variables
-// sf_set: set of shared functions
-std::set<unsigned> sv_set;
-std::set<unsigned> sf_set;
-// var_fs: set of variables for each sub-formula
-// fun_fs: set of functions for each sub-formula
-std::vector<std::set<unsigned> > var_fs;
-std::vector<std::set<unsigned> > fun_fs;
-
-// var_expr: list of shared variables in each sub-formula
-// fun_expr: list of shared function declarations in each formula
-std::vector<std::map<unsigned, expr> > var_expr;
-std::vector<std::map<unsigned, func_decl> > fun_expr;
-// svexpr: expressions corresponding to shared variables and classification number
-// sfist: shared function instances and corresponding classification number
-std::map<unsigned, closure> svexpr;
-std::map<func_inst, closure> sfist;
-
-// checklist indicates check result for every sub-formula
-std::vector<check_result> checklist;
-// interpo_list is a list for interpolants in every sub-formula
-std::vector<expr> interpo_list;
-// table_list: equivalence class conversion table of each sub-problem
-std::vector<std::map<closure, closure> > table_list;
-// model_list is a map of models for every sub-formula
-std::map<int, model> model_list;
-
-bool need_term = false;
-
-#ifdef PZ3_PROFILING
-boost::chrono::milliseconds subsolve_time = boost::chrono::milliseconds::zero();
-boost::chrono::milliseconds conciliate_time = boost::chrono::milliseconds::zero();
-#endif
+using pz3::Solver;
+
+// Interpolation of Z3 is not known to be safe from several threads at once,
+// so it is serialized over all solvers of the process
+static pthread_mutex_t interp_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// high-water mark of the resident memory of an instance in MB, 0 if it cannot be read
+static void peak_rss(peak_scope &scope, pz3::Statistics &st)
+{
+    memStats::end(scope);
+    mem_sample mem;
+    memStats::sample(mem);
+    st.peak_rss_mb = mem.peak_kb / 1024.0;
+    st.peak_process_wide = !scope.alone;
+}
 
-#ifdef PZ3_FINE_GRAINED_PROF
-boost::atomic<long long> decomp_time(0);
-boost::atomic<long long> solve_time(0);
-boost::atomic<long long> interp_time(0);
-boost::atomic<long long> formulate_time(0);
-boost::atomic<long long> ssr_time(0);
+Solver::Solver(pz3::Options const &opt)
+{
+    options = opt;
+    core_num = opt.core_num;
+    from_text = false;
+    incremental = false;
+    shared_solver = NULL;
+    seq_uses = 0;
+    mem_ratio = 0;
+    thread_args = std::vector<thread_arg>(core_num + 1);
+    for (unsigned i = 0; i <= core_num; i++)
+    {
+        thread_args[i].solver = this;
+        thread_args[i].rank = i;
+    }
+    if (options.race)
+        portfolio.set_default();
+#ifndef PZ3_ONECORE
+    if (options.bind_threads && core_num > 1)
+    {
+        topology.detect();
+        topology.place(core_num);
+    }
 #endif
+    cm.init_q_ctx(core_num);
+    cache.set_dir(options.cache_dir, options.cache_mb);
+    pthread_mutex_init(&err_mutex, NULL);
+    pthread_mutex_init(&ready_mutex, NULL);
+    pthread_mutex_init(&race_mutex, NULL);
+    pthread_cond_init(&ready_cond, NULL);
+    pthread_barrier_init(&crea_barrier, NULL, core_num);
+    pthread_barrier_init(&stat_barrier, NULL, core_num);
+    pthread_barrier_init(&dist_barrier, NULL, core_num);
+    if (!options.trace_path.empty())
+    {
+        trace.enable(core_num + 2);
+        for (unsigned i = 0; i < core_num; i++)
+        {
+            std::ostringstream name;
+            name << "partition " << i;
+            trace.set_name(i, name.str());
+        }
+        trace.set_name(core_num, "master");
+        trace.set_name(core_num + 1, "main");
+        phases.set_trace(&trace);
+    }
+    if (options.stats && options.counters)
+        perfCounters::probe();
+    reset_state();
+}
+
+Solver::~Solver()
+{
+    reset_script();
+    if (trace.enabled())
+    {
+        std::ofstream trace_file(options.trace_path.c_str());
+        if (trace_file)
+            trace.write(trace_file);
+        else
+            std::cerr << "Trace file cannot be written.\n";
+    }
+    pthread_barrier_destroy(&crea_barrier);
+    pthread_barrier_destroy(&stat_barrier);
+    pthread_barrier_destroy(&dist_barrier);
+    pthread_cond_destroy(&ready_cond);
+    pthread_mutex_destroy(&race_mutex);
+    pthread_mutex_destroy(&ready_mutex);
+    pthread_mutex_destroy(&err_mutex);
+}
+
+pz3::Options const &Solver::get_options()
+{
+    return options;
+}
 
-// for parallel control
-pthread_mutex_t err_mutex;
-pthread_barrier_t crea_barrier;
-pthread_barrier_t stat_barrier;
-pthread_barrier_t dist_barrier;
+cpuTopology &Solver::get_topology()
+{
+    return topology;
+}
+
+solverPortfolio &Solver::get_portfolio()
+{
+    return portfolio;
+}
 
-pthread_barrier_t barrier1;
-pthread_barrier_t barrier2;
+decompCache &Solver::get_cache()
+{
+    return cache;
+}
 
-int main(int argc, char *argv[])
+void Solver::write_stats(std::ostream &out, pz3::Result const &result)
 {
-    PZ3_Result fresult = PZ3_unknown;
+    char const *status = "unknown";
+    if (result.error)
+        status = "error";
+    else if (result.status == PZ3_sat)
+        status = "sat";
+    else if (result.status == PZ3_unsat)
+        status = "unsat";
+    pz3::Statistics const &st = result.stats;
+    std::streamsize precision = out.precision(6);
+    std::ios_base::fmtflags flags = out.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    out << "{\"file\":\"";
+    // the path is the only string which may need escaping
+    for (unsigned i = 0; i < file_path.size(); i++)
+    {
+        char ch = file_path[i];
+        if (ch == '"' || ch == '\\')
+            out << '\\';
+        if ((unsigned char) ch >= 0x20)
+            out << ch;
+    }
+    out << "\",\"result\":\"" << status << "\",\"cores\":" << core_num
+        << ",\"clauses\":" << st.clause_num << ",\"components\":" << st.component_num
+        << ",\"shared_vars\":" << st.shared_var_num << ",\"shared_funcs\":" << st.shared_func_num
+        << ",\"rounds\":" << st.round_num << ",\"cache_hit\":" << (st.cache_hit ? "true" : "false")
+        << ",\"division_ms\":" << st.division_ms << ",\"subsolve_ms\":" << st.subsolve_ms
+        << ",\"conciliation_ms\":" << st.conciliation_ms << ",\"total_ms\":" << st.total_ms
+        << ",\"peak_rss_mb\":" << st.peak_rss_mb
+        << ",\"peak_process_wide\":" << (st.peak_process_wide ? "true" : "false");
+    if (phases.enabled())
+    {
+        out << ",\"timers\":";
+        phases.write_json(out);
+        out << ",\"memory\":";
+        write_memory(out);
+    }
+    out << "}" << std::endl;
+    out.precision(precision);
+    out.flags(flags);
+}
 
-    if (argc != 3)
+// [1,2,...] of sizes of the containers in list
+template<typename T>
+static void write_sizes(std::ostream &out, std::vector<T> const &list)
+{
+    out << "[";
+    for (unsigned i = 0; i < list.size(); i++)
     {
-        usage(argv[0]);
+        if (i > 0)
+            out << ",";
+        out << list[i].size();
     }
-    get_args(argv);
+    out << "]";
+}
 
-    if (core_num <= 0)
+void Solver::write_memory(std::ostream &out)
+{
+    mem_sample mem;
+    memStats::sample(mem);
+    out << "{\"rss_mb\":" << mem.rss_kb / 1024.0 << ",\"peak_mb\":" << mem.peak_kb / 1024.0;
+    // Z3 reports one heap for all contexts, as seen by the last check in each of them
+    out << ",\"z3_mb\":{\"partitions\":[";
+    for (unsigned i = 0; i < core_num; i++)
     {
-        std::cerr << "Invalid core number!\n";
-        exit(1);
+        if (i > 0)
+            out << ",";
+        out << cm.get_memory(i);
     }
-    cm.init_q_ctx(core_num);
-    pthread_mutex_init(&err_mutex, NULL);
-    pthread_barrier_init(&crea_barrier, NULL, core_num);
-    pthread_barrier_init(&stat_barrier, NULL, core_num);
-    pthread_barrier_init(&dist_barrier, NULL, core_num);
-    expr_table = std::vector<std::vector<expr> >(core_num);
-	
-    fresult = solve_file();
+    out << "],\"master\":" << cm.get_memory(-1) << "}";
 
-    switch (fresult)
+    // numbers of elements, every partition keeping its own copy of the clauses
+    size_t clause_symbols = 0;
+    for (unsigned i = 0; i < expr_var.size(); i++)
     {
-    case PZ3_unsat:
-        std::cout << "unsat\n";
-        break;
-    case PZ3_sat:
-        std::cout << "sat\n";
-        break;
-    default:
-        std::cout << "unknown\n";
+        clause_symbols += expr_var[i].size() + expr_fun[i].size();
     }
-    return 0;
+    out << ",\"containers\":{\"clauses\":";
+    write_sizes(out, expr_table);
+    out << ",\"kept_clauses\":";
+    write_sizes(out, clause_table);
+    out << ",\"symbols\":" << symbols.size() << ",\"clause_symbols\":" << clause_symbols
+        << ",\"shared_vars\":" << sv_set.size() << ",\"shared_funcs\":" << sf_set.size()
+        << ",\"shared_terms\":[";
+    for (unsigned i = 0; i < term_max.size(); i++)
+    {
+        if (i > 0)
+            out << ",";
+        out << term_max[i];
+    }
+    out << "],\"model_entries\":";
+    write_sizes(out, entry_list);
+    out << "}}";
+}
+
+void Solver::set_timeout(unsigned timeout_ms)
+{
+    options.timeout_ms = timeout_ms;
+}
+
+void *Solver::division_entry(void *arg)
+{
+    thread_arg *ta = (thread_arg *) arg;
+    return ta->solver->division((void *) ta->rank);
 }
 
-void usage(char const *prog_name)
+void *Solver::subsolve_entry(void *arg)
 {
-    std::cerr << "Usage: " << prog_name << " ";
-    std::cerr << "[Path of smtlib file] [Number of cores]\n";
-    exit(1);
+    thread_arg *ta = (thread_arg *) arg;
+    return ta->solver->subsolve((void *) ta->rank);
 }
 
-void get_args(char *const argv[])
+void *Solver::shared_setup_entry(void *arg)
 {
-    file_path = std::string(argv[1]);
-    core_num = atoi(argv[2]);
+    thread_arg *ta = (thread_arg *) arg;
+    return ta->solver->shared_setup(NULL);
 }
 
-PZ3_Result solve_file()
+void *Solver::master_entry(void *arg)
 {
+    thread_arg *ta = (thread_arg *) arg;
+    return ta->solver->master_func(NULL);
+}
+
+void *Solver::slave_entry(void *arg)
+{
+    thread_arg *ta = (thread_arg *) arg;
+    return ta->solver->slave_func((void *) ta->rank);
+}
 
-#ifdef PZ3_PROFILING
-	boost_clock::time_point division_start = boost_clock::now();
+void *Solver::context_entry(void *arg)
+{
+    thread_arg *ta = (thread_arg *) arg;
+    return ta->solver->make_context((void *) ta->rank);
+}
+
+void Solver::run_parts(void *(*entry)(void *))
+{
+    pthread_t *thread_handles = (pthread_t *) malloc(core_num * sizeof(pthread_t));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    for (unsigned i = 0; i < core_num; i++)
+    {
+#ifndef PZ3_ONECORE
+        if (options.bind_threads && core_num > 1)
+            topology.bind(&attr, topology.get_slave_cpu(i));
 #endif
+        pthread_create(&thread_handles[i], &attr, entry, &thread_args[i]);
+    }
+    pthread_attr_destroy(&attr);
+    for (unsigned i = 0; i < core_num; i++)
+    {
+        pthread_join(thread_handles[i], NULL);
+    }
+    free(thread_handles);
+}
+
+pz3::Result Solver::solve_file(std::string const &path)
+{
+    boost_clock::time_point start = boost_clock::now();
+    peak_scope peak;
+    memStats::begin(peak);
+    if (incremental)
+        reset_script();
+    reset_state();
+    file_path = path;
+    from_text = false;
+    input_text.clear();
+    pz3::Result result;
+    result.status = solve();
+    result.error = file_error;
+    result.message = error_message;
+    stats.total_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - start).count();
+    peak_rss(peak, stats);
+    result.stats = stats;
+    return result;
+}
+
+pz3::Result Solver::solve_text(std::string const &text)
+{
+    boost_clock::time_point start = boost_clock::now();
+    peak_scope peak;
+    memStats::begin(peak);
+    if (incremental)
+        reset_script();
+    reset_state();
+    file_path = "<input>";
+    from_text = true;
+    input_text = text;
+    pz3::Result result;
+    result.status = solve();
+    result.error = file_error;
+    result.message = error_message;
+    // the text is not needed any more
+    input_text.clear();
+    stats.total_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - start).count();
+    peak_rss(peak, stats);
+    result.stats = stats;
+    return result;
+}
+
+PZ3_Result Solver::solve()
+{
+    // The input is read once here, and parsed from memory by every thread
+    PZ3_File_Result pfr = from_text ? input.set_text(input_text) : input.open(file_path);
+    if (pfr != PZ3_file_ok)
+    {
+        input_error(file_reason(pfr));
+        return PZ3_unknown;
+    }
+    if (options.max_memory_mb > 0)
+        fit_memory();
+    PZ3_Result result;
 
-    // Step 1: Preprocessing (Problem division)
     // If core_num is 1, it is just a sequential version of Z3
     if (core_num == 1)
     {
-        config cfg;
-        cfg.set("MODEL", true);
-        cfg.set("PROOF", true);
-        context c(cfg);
+        result = solve_one();
+    }
+    else
+    {
+        // Workers are started before any thread of this instance is created
+        if (options.processes)
+            start_workers();
+        result = solve_parallel();
+        stop_workers();
+    }
+    input.close();
+    return result;
+}
+
+/*
+  Every partition keeps a copy of the whole input parsed into its context, and these copies take
+  most of the memory of an instance, so a partition is taken to cost mem_ratio bytes per byte of input
+*/
+void Solver::fit_memory()
+{
+    double ratio = mem_ratio > 0 ? mem_ratio : PZ3_MEM_RATIO;
+    double part_mb = ratio * input.size() / (1024.0 * 1024.0);
+    unsigned num = options.core_num;
+    while (num > 1 && num * part_mb > options.max_memory_mb)
+        num--;
+    if (num == core_num)
+        return;
+    if (num < options.core_num)
+    {
+        std::cerr << file_path << ": about " << (unsigned) part_mb << " MB per partition, "
+                  << num << " of " << options.core_num << " partitions are used.\n";
+    }
+    set_parts(num);
+}
 
-        Z3_ast m_fs = Z3_parse_smtlib2_file(c, file_path.c_str(), 0, 0, 0, 0, 0,
-                                            0);
-        expr fs = to_expr(c, m_fs);
-        solver s(c);
-        s.add(fs);
-        switch (s.check())
+void Solver::set_parts(unsigned num)
+{
+    if (num == core_num)
+        return;
+    // contexts of partitions dropped now are freed; nothing lives in them between instances
+    for (unsigned i = num; i < core_num; i++)
+    {
+        cm.free_q_ctx(i);
+    }
+    // the context of sequential solving may have been taken by a division
+    seq_uses = 0;
+    core_num = num;
+    pthread_barrier_destroy(&crea_barrier);
+    pthread_barrier_destroy(&stat_barrier);
+    pthread_barrier_destroy(&dist_barrier);
+    pthread_barrier_init(&crea_barrier, NULL, core_num);
+    pthread_barrier_init(&stat_barrier, NULL, core_num);
+    pthread_barrier_init(&dist_barrier, NULL, core_num);
+    if (trace.enabled())
+    {
+        // threads of the master and the caller follow the partitions
+        for (unsigned i = 0; i < core_num; i++)
         {
-        case sat:
-            return PZ3_sat;
-        case unsat:
-            return PZ3_unsat;
-        default:
-            return PZ3_unknown;
+            std::ostringstream name;
+            name << "partition " << i;
+            trace.set_name(i, name.str());
         }
+        trace.set_name(core_num, "master");
+        trace.set_name(core_num + 1, "main");
     }
+    reset_rounds();
+}
+
+PZ3_Result Solver::solve_parallel()
+{
+    boost_clock::time_point division_start = boost_clock::now();
+    trace.begin(core_num + 1, "division");
+    mem_sample division_mem;
+    if (options.max_memory_mb > 0)
+        memStats::sample(division_mem);
+
+    // A decomposition of the same input cached before is taken instead of dividing it again
+    cache_hit = cache.enabled() && load_division();
+    stats.cache_hit = cache_hit;
 
-    // Otherwise, prepare for parallel processing
+    // Step 1: Preprocessing (Problem division)
     pthread_t *thread_handles = (pthread_t *)malloc(
                                     core_num * sizeof(pthread_t));
 
+    // Contexts are created by division threads, so they are bound to the CPU of their partition
+    // and the memory of each context is allocated on the local node
+    pthread_attr_t attr_division;
+    pthread_attr_init(&attr_division);
     for (unsigned i = 0; i < core_num; i++)
     {
-        pthread_create(&thread_handles[i], NULL, division, (void *) ((long) i));
+#ifndef PZ3_ONECORE
+        if (options.bind_threads)
+            topology.bind(&attr_division, topology.get_slave_cpu(i));
+#endif
+        pthread_create(&thread_handles[i], &attr_division, division_entry, &thread_args[i]);
     }
+    pthread_attr_destroy(&attr_division);
 
 #ifdef PZ3_PRINT_TRACE
     std::cout << "Thread creation complete" << std::endl;
@@ -176,103 +443,134 @@ PZ3_Result solve_file()
         pthread_join(thread_handles[i], NULL);
     }
     free(thread_handles);
-
-#ifdef PZ3_FINE_GRAINED_PROF
-    boost_clock::time_point division_start = boost_clock::now();
-#endif
-    // Combining clauses in each core into formula
-    for (unsigned i = 0; i < core_num; i++)
+    if (!cache_hit && !cache_doc.empty() && !file_error)
     {
-        int lenq = expr_table.at(i).size();
-        expr sprb(cm.get_q_ctx(i));
-        if (lenq > 0)
-        {
-            sprb = expr_table.at(i).at(0);
-            for (int j = 1; j < lenq; j++)
-            {
-                sprb = sprb && expr_table.at(i).at(j);
-            }
-        }
-        else
-        {
-            sprb = cm.get_q_ctx(i).bool_val(true);
-        }
-        expr_list.push_back(sprb);
+        cache.store(cache_key, cache_doc);
     }
-#ifdef PZ3_FINE_GRAINED_PROF
-    boost::chrono::milliseconds division_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - division_start);
-    decomp_time.fetch_add(division_time.count(), boost::memory_order_relaxed);
-    std::cout << "DECOMP: " << decomp_time << std::endl;
-#endif
+    cache_doc.clear();
+    if (options.max_memory_mb > 0 && input.size() >= PZ3_MEM_LEARN_SIZE)
+    {
+        // what the partitions took is learnt for the inputs to come
+        mem_sample mem;
+        memStats::sample(mem);
+        double ratio = (mem.rss_kb - division_mem.rss_kb) * 1024.0 / ((double) core_num * input.size());
+        if (ratio > mem_ratio)
+            mem_ratio = ratio;
+    }
+    trace.end(core_num + 1, "division");
+    stats.division_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - division_start).count();
+    stats.component_num = comp_clauses.size();
 
-#ifdef PZ3_DIST
-    for(unsigned i = 0; i < core_num; i++)
+    if (file_error)
+    {
+        return PZ3_unknown;
+    }
+    if (early_unsat)
     {
-        std::cout << "Sub-problem " << i << ":" << std::endl;
-        std::cout << expr_list.at(i) << std::endl;
+        return PZ3_unsat;
+    }
+    // Every clause belongs to a component solved on its own
+    if (dec_clause_num == 0)
+    {
+        return comp_result;
     }
-    std::cout << "Terminate early for test" << std::endl;
-    exit(0);
-#endif
 
-#ifdef PZ3_PROFILING
-	std::cout << "DECOMPOSITION: " << boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - division_start) << std::endl;
-#endif
+    return solve_partitions();
+}
 
-#ifdef PZ3_PROFILING
+/*
+  Prerequisite: expr_list, expr_dist, var_fs, fun_fs and the contexts of partitions
+  Solve the sub-formulas and conciliate them, for solve_parallel() and check()
+*/
+PZ3_Result Solver::solve_partitions()
+{
     boost_clock::time_point subsolve_start = boost_clock::now();
-#endif
+    trace.begin(core_num + 1, "subsolve");
 
     // Solve sub-formuals in parallel
-    thread_handles = (pthread_t *) malloc(core_num * sizeof(pthread_t));
+    pthread_barrier_init(&coll_barrier, NULL, core_num + 1);
+    core_ready = std::vector<bool>(core_num, false);
+    part_done = std::vector<bool>(core_num, false);
+    part_result = std::vector<check_result>(core_num, unknown);
+    part_winner = std::vector<unsigned>(core_num, 0);
+    part_racers = std::vector<unsigned>(core_num, 0);
+    helping = std::vector<int>(core_num, -1);
+    pthread_t *thread_handles = (pthread_t *) malloc(core_num * sizeof(pthread_t));
     pthread_attr_t attr_subsolve;
-#ifndef PZ3_ONECORE
-    cpu_set_t cpus;
-#endif
     pthread_attr_init(&attr_subsolve);
     for (unsigned i = 0; i < core_num; i++)
     {
 #ifndef PZ3_ONECORE
-        CPU_ZERO(&cpus);
-        CPU_SET(i, &cpus);
-        pthread_attr_setaffinity_np(&attr_subsolve, sizeof(cpu_set_t), &cpus);
+        if (options.bind_threads)
+            topology.bind(&attr_subsolve, topology.get_slave_cpu(i));
 #endif
-        pthread_create(&thread_handles[i], &attr_subsolve, subsolve, (void *) ((long) i));
+        pthread_create(&thread_handles[i], &attr_subsolve, subsolve_entry, &thread_args[i]);
     }
 
 #ifdef PZ3_PRINT_TRACE
     std::cout << "Thread creation complete" << std::endl;
 #endif
 
+    // Step 2: Reconciliation
+    // Symbols of each core were merged during division, so shared symbols are counted
+    // while sub-formulas are being solved (an incremental instance keeps them up to date).
+    // Sub-solving threads extract them afterwards.
+    if (!incremental)
+        shared_count();
+    var_expr = std::vector<std::map<unsigned, expr> >(core_num);
+    fun_expr = std::vector<std::map<unsigned, func_decl> >(core_num);
+    stats.shared_var_num = sv_set.size();
+    stats.shared_func_num = sf_set.size();
+#ifdef PZ3_PRINT_TRACE
+    std::cout << "shared_count complete!" << std::endl;
+#endif
+    // The shared context is set up as soon as sub-formulas are solved one by one
+    pthread_t setup_handle;
+    bool need_setup = (sv_set.size() > 0);
+    if (need_setup)
+    {
+        // the shared context is created by the set-up thread on the CPU of the master
+#ifndef PZ3_ONECORE
+        if (options.bind_threads)
+            topology.bind(&attr_subsolve, topology.get_master_cpu());
+#endif
+        pthread_create(&setup_handle, &attr_subsolve, shared_setup_entry, &thread_args[core_num]);
+    }
+    wait_at(coll_barrier, core_num + 1, "wait coll_barrier");
+
     for (unsigned i = 0; i < core_num; i++)
     {
         pthread_join(thread_handles[i], NULL);
     }
     free(thread_handles);
+    pthread_barrier_destroy(&coll_barrier);
+    if (need_setup)
+    {
+        pthread_join(setup_handle, NULL);
+    }
+    pthread_attr_destroy(&attr_subsolve);
+    trace.end(core_num + 1, "subsolve");
+    stats.subsolve_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - subsolve_start).count();
 
-#ifdef PZ3_PROFILING
-	subsolve_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - subsolve_start);
-#endif
-#ifdef PZ3_FINE_GRAINED_PROF
-    std::cout << "SOLVE: " << solve_time << std::endl;
-#endif
+    if (early_unsat)
+    {
+        return PZ3_unsat;
+    }
 
-    // Step 2: Reconciliation
-    // Collect variable information for formulas in each core
-    vars_merge();
-    funcs_merge();
-    // Since then we can invoke get_conn_factor() to evaluate connectivity of clause distribution
-#ifdef PZ3_PRINT_TRACE
-    std::cout << "merge complete!" << std::endl;
-#endif
     // Collect shared variables from different contexts(cores)
-    shared_collect();
+    if (!shared_collect())
+    {
+        // every sub-formula is separated, and all of them are sat
+        return comp_result;
+    }
 
 #ifdef PZ3_PRINT_TRACE
     std::cout << "shared_collect complete!" << std::endl;
 #endif
 
     // Some preparations
+    boost_clock::time_point conciliation_start = boost_clock::now();
+    trace_span conciliation_span(trace, core_num + 1, "conciliation");
     pthread_barrier_init(&barrier1, NULL, core_num + 1);
     pthread_barrier_init(&barrier2, NULL, core_num + 1);
     checklist = std::vector<check_result>(core_num);
@@ -281,8 +579,8 @@ PZ3_Result solve_file()
         expr empty_expr = expr(cm.get_q_ctx(i));
         interpo_list.push_back(empty_expr);
     }
-    table_list = std::vector<std::map<closure, closure> >(core_num); 
-    // We prepare model_list later for there is no way to create an empty model on the fly
+    table_list = std::vector<flat_map<closure, closure> >(core_num);
+    entry_list = std::vector<std::vector<model_entry> >(core_num);
 
 #ifdef PZ3_PRINT_TRACE
     std::cout << "Before creating threads" << std::endl;
@@ -295,19 +593,16 @@ PZ3_Result solve_file()
     for (unsigned i = 0; i < core_num; i++)
     {
 #ifndef PZ3_ONECORE
-        CPU_ZERO(&cpus);
-        CPU_SET(i, &cpus);
-        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
+        if (options.bind_threads)
+            topology.bind(&attr, topology.get_slave_cpu(i));
 #endif
-        pthread_create(&thread_handles[i], &attr, slave_func,
-                       (void *) ((long) i));
+        pthread_create(&thread_handles[i], &attr, slave_entry, &thread_args[i]);
     }
 #ifndef PZ3_ONECORE
-    CPU_ZERO(&cpus);
-    CPU_SET(PZ3_MASTER_THREAD, &cpus);
-    pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
-#endif    
-	pthread_create(&thread_handles[core_num], &attr, master_func, NULL);
+    if (options.bind_threads)
+        topology.bind(&attr, topology.get_master_cpu());
+#endif
+	pthread_create(&thread_handles[core_num], &attr, master_entry, &thread_args[core_num]);
 
     void *tret;
     pthread_join(thread_handles[core_num], &tret);
@@ -315,23 +610,17 @@ PZ3_Result solve_file()
     {
         pthread_join(thread_handles[i], NULL);
     }
-
-#ifdef PZ3_PROFILING
-    std::cout << "SUBSOLVE: " << subsolve_time << std::endl;
-    std::cout << "CONCILIATION: " << conciliate_time << std::endl;
-#endif
-
-#ifdef PZ3_FINE_GRAINED_PROF
-    std::cout << "INTERP: " << interp_time << std::endl;
-    std::cout << "FORM: " << formulate_time << std::endl;
-    std::cout << "SSR: " << ssr_time << std::endl;
-    std::cout << "GENSOLVE: " << solve_time << std::endl;
-#endif
+    free(thread_handles);
+    pthread_attr_destroy(&attr);
+    pthread_barrier_destroy(&barrier1);
+    pthread_barrier_destroy(&barrier2);
+    stats.conciliation_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - conciliation_start).count();
 
     switch ((long) tret)
     {
     case 0:
-        return PZ3_sat;
+        // sat unless a separately solved component is unknown
+        return comp_result;
     case 1:
         return PZ3_unsat;
     default:
@@ -341,179 +630,1232 @@ PZ3_Result solve_file()
 
 }
 
-void *division(void *rank)
+PZ3_Result solve_sequential(context &c, std::string const &path, solverPortfolio &portfolio, unsigned timeout_ms)
 {
-#ifdef PZ3_FINE_GRAINED_PROF
-    boost_clock::time_point div_start = boost_clock::now();
-    boost::chrono::milliseconds div_time = boost::chrono::milliseconds::zero();
-#endif
-    long my_rank_l = (long) rank;
-    int my_rank = (int) my_rank_l;
-    config cfg;
-    cfg.set("MODEL", true);
-    cfg.set("PROOF", true);
-    cm.mk_q_ctx(my_rank, cfg);
-    context &ctx = cm.get_q_ctx(my_rank);
-    expr fs(ctx);
-    PZ3_File_Result pfr;
-    expr_vector list(ctx);
-
-    pfr = parse_file(ctx, fs);
-    switch (pfr)
+    smtInput input;
+    expr fs(c);
+    if (input.open(path) != PZ3_file_ok || !input.parse(c, fs))
+        throw exception("cannot read the input");
+    solver s(c);
+    portfolio.apply(s, 0, timeout_ms);
+    s.add(fs);
+    switch (s.check())
     {
-    case PZ3_file_noexist:
-        pthread_mutex_lock(&err_mutex);
-        std::cerr << "From thread " << my_rank << "\n";
-        std::cerr << "SMTLIB file doesn't exist.\n";
-        exit(1);
-    case PZ3_file_nosmt:
-        pthread_mutex_lock(&err_mutex);
-        std::cerr << "From thread " << my_rank << "\n";
-        std::cerr << "Input file is not a valid SMTLIB file.\n";
-        exit(1);
-    case PZ3_file_corrupt:
-        pthread_mutex_lock(&err_mutex);
-        std::cerr << "From thread " << my_rank << "\n";
-        std::cerr << "Input SMTLIB file is corrupted.\n";
-        exit(1);
+    case sat:
+        return PZ3_sat;
+    case unsat:
+        return PZ3_unsat;
     default:
-        break;
+        return PZ3_unknown;
     }
+}
 
-    // Convert arbitrary formula into CNF
-    // Attention: Z3 uses tseitin method to convert a formula into CNF form in order to avoid exponential increase of problem size
-    // Therefore there are some auxiliary variables(All of them are boolean form). We don't need to care them.
-    fs_to_cnf(my_rank, fs, list);
-    int num_clause = list.size();
-
-    // Distribute clauses in preparing for several cores
-    if (my_rank == PZ3_MASTER_THREAD)
+PZ3_Result Solver::solve_one()
+{
+    // the context is kept for following instances, and renewed now and then to bound its memory
+    if (seq_uses == 0 || seq_uses >= PZ3_SEQ_CTX_REUSE)
     {
-        assert(expr_var.size() == 0);
-        assert(expr_fun.size() == 0);
-        expr_var = std::vector<std::map<unsigned, int> >(num_clause);
-        expr_fun = std::vector<std::map<unsigned, int> >(num_clause);
+        config cfg;
+        cfg.set("MODEL", true);
+        cfg.set("PROOF", true);
+        cm.mk_q_ctx(0, cfg);
+        seq_uses = 0;
+    }
+    seq_uses++;
+    context &c = cm.get_q_ctx(0);
+    expr fs(c);
+    phase_timer div_timer(phases, 0, 0, PZ3_phase_division);
+    PZ3_File_Result pfr = parse_file(c, fs);
+    div_timer.stop();
+    if (pfr != PZ3_file_ok)
+    {
+        // the error code stays in the context, so the next instance gets a fresh one
+        seq_uses = 0;
+        input_error(file_reason(pfr));
+        return PZ3_unknown;
     }
-#ifdef PZ3_FINE_GRAINED_PROF
-    div_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - div_start);
-#endif
-    pthread_barrier_wait(&crea_barrier);
-#ifdef PZ3_FINE_GRAINED_PROF
-    div_start = boost_clock::now();
-#endif
-    for (int i = my_rank; i < num_clause; i += core_num)
+    solver s(c);
+    portfolio.apply(s, 0, options.timeout_ms);
+    s.add(fs);
+    phase_timer solve_timer(phases, 0, 0, PZ3_phase_subsolve);
+    check_result result = s.check();
+    solve_timer.stop();
+    note_solver(0, 0, 0, PZ3_phase_subsolve, s);
+    switch (result)
     {
-        assert(expr_var.at(i).size() == 0);
-        assert(expr_fun.at(i).size() == 0);
-        get_vars(list[i], expr_var.at(i), expr_fun.at(i));
+    case sat:
+        return PZ3_sat;
+    case unsat:
+        return PZ3_unsat;
+    default:
+        return PZ3_unknown;
     }
-#ifdef PZ3_FINE_GRAINED_PROF
-    div_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - div_start);
-#endif
-    pthread_barrier_wait(&stat_barrier);
+}
 
-    if (my_rank == PZ3_MASTER_THREAD)
-    {
-#ifdef PZ3_FINE_GRAINED_PROF
-        div_start = boost_clock::now();
-#endif
-        // merge all symbols in each clause and calculate weight of each clause
-        std::set<unsigned> symbol_set;
-        std::vector<int> clause_weight = std::vector<int>(num_clause, 0);
-        std::vector<std::set<unsigned> > symbol_sub = std::vector<std::set<unsigned> >(num_clause);
-        for(int i = 0; i < num_clause; i++)
-        {
-            std::map<unsigned, int>::iterator vit = expr_var.at(i).begin();
-            std::map<unsigned, int>::iterator vit_end = expr_var.at(i).end();
-            std::set<unsigned>& my_sub = symbol_sub.at(i);
-            while(vit != vit_end)
-            {
-                symbol_set.insert(vit->first);
-                my_sub.insert(vit->first);
-                clause_weight.at(i) += (vit->second);
-                ++vit;   
-            }
-            std::map<unsigned, int>::iterator fit = expr_fun.at(i).begin();
-            std::map<unsigned, int>::iterator fit_end = expr_fun.at(i).end();
-            while(fit != fit_end)
-            {
-                symbol_set.insert(fit->first);
-                my_sub.insert(fit->first);
-                clause_weight.at(i) += (fit->second);
-                ++fit;
-            }
-        }
+void Solver::start_script()
+{
+    if (incremental)
+        return;
+    reset_state();
+    // an incremental instance has all partitions, whatever the memory limit made of the last one
+    set_parts(options.core_num);
+    file_path = "<input>";
+    from_text = true;
+    incremental = true;
+}
 
-        dist_clause(symbol_set, symbol_sub, clause_weight);
-#ifdef PZ3_FINE_GRAINED_PROF
-        div_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - div_start);
-#endif
-    }
-    pthread_barrier_wait(&dist_barrier);
+void Solver::declare(std::string const &command)
+{
+    start_script();
+    inc_prelude += command;
+    inc_prelude += "\n";
+}
 
-#ifdef PZ3_FINE_GRAINED_PROF
-    div_start = boost_clock::now();
-#endif
-    // Generate expression for corresponding core
-    assert(expr_dist.size() == list.size());
-    for (int i = 0; i < num_clause; i++)
-    {
-        // The clause belongs to this core
-        if (expr_dist.at(i) == my_rank)
+void Solver::add(std::string const &command)
+{
+    start_script();
+    inc_pending += command;
+    inc_pending += "\n";
+}
+
+bool Solver::push(unsigned num)
+{
+    start_script();
+    // assertions given so far belong to the scope outside the new ones
+    bool ok = absorb();
+    for (unsigned n = 0; n < num; n++)
+    {
+        inc_scope scope;
+        scope.prelude_len = inc_prelude.size();
+        scope.clause_num = expr_dist.size();
+        inc_scopes.push_back(scope);
+        for (unsigned i = 0; i < part_solvers.size(); i++)
         {
-            expr_table.at(my_rank).push_back(list[i]);
+            part_solvers[i]->push();
         }
+        if (shared_solver != NULL)
+            shared_solver->push();
     }
-#ifdef PZ3_FINE_GRAINED_PROF
-    div_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - div_start);
-    decomp_time.fetch_add(div_time.count(), boost::memory_order_relaxed);
-#endif
+    return ok;
+}
 
-    return NULL;
+void Solver::pop(unsigned num)
+{
+    if (num > inc_scopes.size())
+        num = inc_scopes.size();
+    if (num == 0)
+        return;
+    inc_scope scope = inc_scopes.at(inc_scopes.size() - num);
+    inc_scopes.resize(inc_scopes.size() - num);
+    // assertions not parsed yet were given after the last push
+    inc_pending.clear();
+    inc_prelude.resize(scope.prelude_len);
+    if (!part_solvers.empty())
+        inc_drop(scope.clause_num);
+    for (unsigned i = 0; i < part_solvers.size(); i++)
+    {
+        part_solvers[i]->pop(num);
+        Z3_ast_vector_resize(cm.get_q_ctx(i), clause_table.at(i), scope.clause_num);
+    }
+    // interpolants learnt from the clauses dropped now go with them
+    if (shared_solver != NULL)
+        shared_solver->pop(num);
+    expr_dist.resize(scope.clause_num);
+    expr_var.resize(scope.clause_num);
+    expr_fun.resize(scope.clause_num);
+    inc_sub.resize(scope.clause_num);
+    inc_weight.resize(scope.clause_num);
 }
 
-PZ3_File_Result parse_file(context &ctx, expr &fs)
+pz3::Result Solver::check()
 {
-    std::ifstream file;
-    PZ3_File_Type ftype = PZ3_smt_unknown;
+    boost_clock::time_point start = boost_clock::now();
+    peak_scope peak;
+    memStats::begin(peak);
+    start_script();
+    reset_rounds();
+    pz3::Result result;
+    result.status = check_incremental();
+    result.error = file_error;
+    result.message = error_message;
+    stats.total_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - start).count();
+    peak_rss(peak, stats);
+    result.stats = stats;
+    return result;
+}
 
-    file.open(file_path.c_str(), std::ifstream::in);
-    if (!file)
-        return PZ3_file_noexist;
-    file.close();
-    ftype = check_filetype();
-    if (ftype == PZ3_smt_unknown)
-        return PZ3_file_nosmt;
-    else if (ftype == PZ3_smt2)
+pz3::Result Solver::check_assuming(std::string const &literals)
+{
+    // assumptions are asserted in a scope of their own, which is closed after the check
+    pz3::Result result;
+    if (push(1))
     {
-        Z3_ast m_fs = Z3_parse_smtlib2_file(ctx, file_path.c_str(), 0, 0, 0, 0,
-                                            0, 0);
-        expr im_fs = expr(ctx, m_fs);
-        fs = im_fs;
-        return PZ3_file_ok;
+        add("(assert (and true " + literals + "))");
+        result = check();
     }
     else
     {
-        // Prepare for SMTLIB format benchmark
-        return PZ3_file_ok;
+        result.error = true;
+        result.message = error_message;
+    }
+    pop(1);
+    return result;
+}
+
+void Solver::reset_script()
+{
+    // solvers go before the contexts they live in
+    for (unsigned i = 0; i < part_solvers.size(); i++)
+    {
+        delete part_solvers[i];
+    }
+    part_solvers.clear();
+    part_totals.clear();
+    delete shared_solver;
+    shared_solver = NULL;
+    shared_totals.clear();
+    inc_prelude.clear();
+    inc_pending.clear();
+    inc_scopes.clear();
+    incremental = false;
+    // the contexts are replaced, including the one of sequential solving
+    seq_uses = 0;
+    reset_state();
+}
+
+PZ3_Result Solver::check_incremental()
+{
+    boost_clock::time_point division_start = boost_clock::now();
+    if (!absorb())
+        return PZ3_unknown;
+    unsigned num_clause = expr_dist.size();
+    stats.clause_num = num_clause;
+    if (num_clause == 0)
+        return PZ3_sat;
+    if (core_num == 1)
+    {
+        stats.division_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - division_start).count();
+        phase_timer solve_timer(phases, 0, 0, PZ3_phase_subsolve);
+        check_result result = part_solvers.at(0)->check();
+        solve_timer.stop();
+        note_solver(0, 0, 0, PZ3_phase_subsolve, *part_solvers.at(0), &part_totals.at(0));
+        switch (result)
+        {
+        case sat:
+            return PZ3_sat;
+        case unsat:
+            return PZ3_unsat;
+        default:
+            return PZ3_unknown;
+        }
+    }
+
+    // symbols of partitions are up to date, and only changed sub-formulas are joined again
+    for (unsigned i = 0; i < core_num; i++)
+    {
+        if (!inc_changed.at(i))
+            continue;
+        join_part(i);
+        inc_changed.at(i) = false;
+    }
+    dec_clause_num = num_clause;
+    stats.division_ms = boost::chrono::duration<double, boost::milli>(boost_clock::now() - division_start).count();
+    PZ3_Result result = solve_partitions();
+    // an interrupt which came after the check of a partition returned stays pending in its context
+    // until a check starts, and would cancel the next push of the solver of the partition
+    if (early_unsat || portfolio.size() > 1)
+    {
+        for (unsigned i = 0; i < core_num; i++)
+        {
+            solver s(cm.get_q_ctx(i));
+            s.check();
+        }
+    }
+    return result;
+}
+
+/*
+  Contexts and solvers of partitions are made by the first call. Then the pending assertions are
+  parsed and converted into CNF once, in the context of partition 0, and the new clauses are
+  translated into the contexts of the other partitions, so auxiliary constants of the Tseitin
+  conversion have the same names in every context. The new clauses are given partitions by
+  dist_extend() (or dist_clause() if they are the first ones), and added to their solvers.
+*/
+bool Solver::absorb()
+{
+    if (part_solvers.empty())
+    {
+        // contexts are made by threads on the CPUs of their partitions, as in division()
+        run_parts(context_entry);
+        for (unsigned i = 0; i < core_num; i++)
+        {
+            context &ctx = cm.get_q_ctx(i);
+            clause_table.push_back(expr_vector(ctx));
+            solver *s = new solver(ctx);
+            portfolio.apply(*s, 0, options.timeout_ms);
+            for (unsigned j = 0; j < inc_scopes.size(); j++)
+            {
+                s->push();
+            }
+            part_solvers.push_back(s);
+            expr_table.push_back(expr_vector(ctx));
+            expr_list.push_back(ctx.bool_val(true));
+        }
+        part_totals = std::vector<solver_counts>(core_num);
+        core_clauses = std::vector<std::vector<int> >(core_num);
+        var_fs = std::vector<symbol_list>(core_num);
+        fun_fs = std::vector<symbol_list>(core_num);
+        inc_uses = std::vector<std::vector<unsigned> >(core_num);
+        inc_changed = std::vector<bool>(core_num, false);
+    }
+    if (inc_pending.empty())
+        return true;
+
+    inc_text = inc_prelude + inc_pending;
+    inc_pending.clear();
+    PZ3_File_Result pfr = input.set_text(inc_text);
+    if (pfr != PZ3_file_ok)
+    {
+        inc_text.clear();
+        input_error(file_reason(pfr));
+        return false;
+    }
+    unsigned first = expr_dist.size();
+    expr_vector &base = clause_table.at(0);
+    std::vector<symbol_list> new_vars;
+    std::vector<symbol_list> new_funs;
+    bool ok = read_input(0, 1, base, new_vars, new_funs);
+    input.close();
+    inc_text.clear();
+    if (!ok)
+    {
+        // clauses of the assertions parsed before the error are dropped
+        Z3_ast_vector_resize(cm.get_q_ctx(0), base, first);
+        return false;
+    }
+
+    unsigned num_clause = base.size();
+    expr_var.resize(num_clause);
+    expr_fun.resize(num_clause);
+    for (unsigned i = first; i < num_clause; i++)
+    {
+        expr_var.at(i).swap(new_vars.at(i - first));
+        expr_fun.at(i).swap(new_funs.at(i - first));
+    }
+    // no thread runs in any context here, so the clauses of context 0 are translated one by one
+    context &base_ctx = cm.get_q_ctx(0);
+    for (unsigned p = 1; p < core_num; p++)
+    {
+        context &ctx = cm.get_q_ctx(p);
+        expr_vector &list = clause_table.at(p);
+        for (unsigned i = first; i < num_clause; i++)
+        {
+            list.push_back(to_expr(ctx, Z3_translate(base_ctx, base[i], ctx)));
+        }
+    }
+
+    // clauses distributed before stay in their partitions, and keep their symbols and weights
+    std::vector<int> clauses(num_clause - first);
+    for (unsigned i = first; i < num_clause; i++)
+    {
+        clauses[i - first] = i;
+    }
+    std::vector<int> clause_weight;
+    std::vector<symbol_list> symbol_sub;
+    clause_symbols(clauses, symbol_sub, clause_weight);
+    inc_sub.resize(num_clause);
+    for (unsigned i = first; i < num_clause; i++)
+    {
+        inc_sub[i].swap(symbol_sub[i - first]);
+    }
+    inc_weight.insert(inc_weight.end(), clause_weight.begin(), clause_weight.end());
+    phase_timer dist_timer(phases, 0, 0, PZ3_phase_distribution);
+    if (first == 0)
+        dist_clause(core_num, symbols.size(), inc_sub, inc_weight, expr_dist);
+    else
+        dist_extend(core_num, symbols.size(), inc_sub, inc_weight, expr_dist);
+    dist_timer.stop();
+    for (unsigned i = first; i < num_clause; i++)
+    {
+        int part = expr_dist.at(i);
+        part_solvers.at(part)->add(clause_table.at(part)[i]);
+    }
+    inc_place(first);
+    return true;
+}
+
+/*
+  Prerequisite: expr_dist, expr_var, expr_fun
+  A symbol is added to the symbols of a partition by the first clause of the partition using it,
+  and to the shared symbols when a second partition uses it, so only new clauses are looked at.
+*/
+void Solver::inc_place(unsigned first)
+{
+    unsigned symbol_num = symbols.size();
+    inc_parts.resize(symbol_num, 0);
+    std::vector<symbol_list> new_vars(core_num);
+    std::vector<symbol_list> new_funs(core_num);
+    symbol_list shared_vars;
+    symbol_list shared_funs;
+    for (unsigned i = 0; i < core_num; i++)
+    {
+        inc_uses.at(i).resize(symbol_num, 0);
+    }
+    unsigned num_clause = expr_dist.size();
+    for (unsigned i = first; i < num_clause; i++)
+    {
+        int part = expr_dist.at(i);
+        core_clauses.at(part).push_back(i);
+        expr_table.at(part).push_back(clause_table.at(part)[i]);
+        inc_changed.at(part) = true;
+        inc_count(part, expr_var.at(i), 1, new_vars.at(part), shared_vars);
+        inc_count(part, expr_fun.at(i), 1, new_funs.at(part), shared_funs);
+    }
+    for (unsigned i = 0; i < core_num; i++)
+    {
+        merge_symbols(var_fs.at(i), new_vars.at(i), true);
+        merge_symbols(fun_fs.at(i), new_funs.at(i), true);
+    }
+    merge_symbols(sv_set, shared_vars, true);
+    merge_symbols(sf_set, shared_funs, true);
+}
+
+/*
+  Prerequisite: expr_dist, expr_var, expr_fun, and the tables of partitions of inc_place()
+  Clauses are taken out from the last one, so every partition keeps a prefix of its clauses.
+*/
+void Solver::inc_drop(unsigned clause_num)
+{
+    std::vector<symbol_list> old_vars(core_num);
+    std::vector<symbol_list> old_funs(core_num);
+    symbol_list shared_vars;
+    symbol_list shared_funs;
+    for (unsigned i = expr_dist.size(); i-- > clause_num; )
+    {
+        int part = expr_dist.at(i);
+        core_clauses.at(part).pop_back();
+        inc_changed.at(part) = true;
+        inc_count(part, expr_var.at(i), -1, old_vars.at(part), shared_vars);
+        inc_count(part, expr_fun.at(i), -1, old_funs.at(part), shared_funs);
+    }
+    for (unsigned i = 0; i < core_num; i++)
+    {
+        if (inc_changed.at(i))
+            Z3_ast_vector_resize(cm.get_q_ctx(i), expr_table.at(i), core_clauses.at(i).size());
+        merge_symbols(var_fs.at(i), old_vars.at(i), false);
+        merge_symbols(fun_fs.at(i), old_funs.at(i), false);
+    }
+    merge_symbols(sv_set, shared_vars, false);
+    merge_symbols(sf_set, shared_funs, false);
+}
+
+void Solver::inc_count(int part, symbol_list &syms, int count, symbol_list &part_syms, symbol_list &shared)
+{
+    std::vector<unsigned> &uses = inc_uses.at(part);
+    unsigned len = syms.size();
+    for (unsigned j = 0; j < len; j++)
+    {
+        unsigned id = syms[j];
+        if (count > 0 && uses[id]++ == 0)
+        {
+            part_syms.push_back(id);
+            if (++inc_parts[id] == 2)
+                shared.push_back(id);
+        }
+        else if (count < 0 && --uses[id] == 0)
+        {
+            part_syms.push_back(id);
+            if (inc_parts[id]-- == 2)
+                shared.push_back(id);
+        }
+    }
+}
+
+void *Solver::make_context(void *rank)
+{
+    long my_rank = (long) rank;
+    config cfg;
+    cfg.set("MODEL", true);
+    cfg.set("PROOF", true);
+    cm.mk_q_ctx(my_rank, cfg);
+    return NULL;
+}
+
+void Solver::input_error(std::string const &reason)
+{
+    pthread_mutex_lock(&err_mutex);
+    if (!file_error)
+        error_message = file_path + ": " + reason;
+    file_error = true;
+    pthread_mutex_unlock(&err_mutex);
+}
+
+void Solver::reset_state()
+{
+    // objects of Z3 go first, before their contexts are replaced by the next instance
+    reset_rounds();
+    clause_table.clear();
+
+    symbols.clear();
+    expr_dist.clear();
+    core_clauses.clear();
+    expr_var.clear();
+    expr_fun.clear();
+    svexpr.clear();
+    inc_sub.clear();
+    inc_weight.clear();
+    inc_uses.clear();
+    inc_parts.clear();
+    inc_changed.clear();
+
+    comp_clauses.clear();
+    comp_core.clear();
+    cache_key.clear();
+    cache_doc.clear();
+    cache_hit = false;
+    dec_clause_num = 0;
+}
+
+void Solver::note_solver(int ctx_index, unsigned thread, unsigned round, PZ3_Phase phase, solver &s,
+                         solver_counts *totals)
+{
+    if (!phases.enabled())
+        return;
+    z3::stats st = s.statistics();
+    solver_counts counts;
+    for (unsigned i = 0; i < st.size(); i++)
+    {
+        std::string key = st.key(i);
+        double value = st.is_uint(i) ? st.uint_value(i) : st.double_value(i);
+        // Z3 allocates for all contexts from one heap, and these are about the heap, not the check
+        if (key == "max memory")
+            cm.note_memory(ctx_index, value);
+        if (key == "memory" || key == "max memory" || key == "num allocs")
+            continue;
+        if (totals != NULL)
+        {
+            // Z3 may start the statistics of a solver again (when it changes its inner solver)
+            double &total = (*totals)[key];
+            counts[key] = value >= total ? value - total : value;
+            total = value;
+        }
+        else
+            counts[key] = value;
+    }
+    phases.add_solver(thread, round, phase, counts);
+}
+
+void Solver::wait_at(pthread_barrier_t &barrier, unsigned thread, char const *name, unsigned round)
+{
+    trace_span span(trace, thread, name, round);
+    pthread_barrier_wait(&barrier);
+}
+
+void Solver::reset_rounds()
+{
+    // sub-formulas and symbols of partitions of an incremental instance are kept by absorb() and pop()
+    if (!incremental)
+    {
+        expr_table.clear();
+        expr_list.clear();
+        sv_set.clear();
+        sf_set.clear();
+        var_fs.clear();
+        fun_fs.clear();
+    }
+    var_expr.clear();
+    fun_expr.clear();
+    sv_map.clear();
+    interpo_list.clear();
+    checklist.clear();
+    table_list.clear();
+    entry_list.clear();
+    sfist.clear();
+
+    comp_result = PZ3_sat;
+    need_term = false;
+    early_unsat = false;
+    file_error = false;
+    error_message.clear();
+    setup_cancel = false;
+    stats = pz3::Statistics();
+    phases.reset(core_num + 1, options.stats, options.counters);
+    term_max = std::vector<unsigned>(core_num, 0);
+    cm.clear_memory();
+}
+
+void *Solver::division(void *rank)
+{
+    long my_rank_l = (long) rank;
+    int my_rank = (int) my_rank_l;
+    // waiting at barriers is not a part of division
+    phase_timer div_timer(phases, my_rank, 0, PZ3_phase_division);
+    config cfg;
+    cfg.set("MODEL", true);
+    cfg.set("PROOF", true);
+    cm.mk_q_ctx(my_rank, cfg);
+    context &ctx = cm.get_q_ctx(my_rank);
+    expr_vector list(ctx);
+    // symbols of clauses my_rank, my_rank + core_num, ... until they have a place in expr_var and expr_fun
+    std::vector<symbol_list> my_vars;
+    std::vector<symbol_list> my_funs;
+
+    if (cache_hit)
+    {
+        // clauses in CNF come from the cache, with their symbols and distribution
+        if (!read_clauses(ctx, list))
+        {
+            input_error("Cached decomposition cannot be read.");
+            return NULL;
+        }
+    }
+    else if (!read_input(my_rank, core_num, list, my_vars, my_funs))
+    {
+        // every thread parses the same input, so all of them stop here
+        return NULL;
+    }
+    int num_clause = list.size();
+
+    // Distribute clauses in preparing for several cores
+    if (my_rank == PZ3_MASTER_THREAD && !cache_hit)
+    {
+        assert(expr_var.size() == 0);
+        assert(expr_fun.size() == 0);
+        expr_var = std::vector<symbol_list>(num_clause);
+        expr_fun = std::vector<symbol_list>(num_clause);
+    }
+    div_timer.pause();
+    wait_at(crea_barrier, my_rank, "wait crea_barrier");
+    div_timer.resume();
+    for (unsigned k = 0; k < my_vars.size(); k++)
+    {
+        int i = my_rank + k * core_num;
+        expr_var.at(i).swap(my_vars[k]);
+        expr_fun.at(i).swap(my_funs[k]);
+    }
+    div_timer.pause();
+    wait_at(stat_barrier, my_rank, "wait stat_barrier");
+    div_timer.resume();
+
+    if (my_rank == PZ3_MASTER_THREAD)
+    {
+        // Other threads are waiting now, so objects in their contexts can be created here
+        expr_table.clear();
+        expr_list.clear();
+        expr_table.reserve(core_num);
+        expr_list.reserve(core_num);
+        clause_table.clear();
+        clause_table.reserve(core_num);
+        for (unsigned i = 0; i < core_num; i++)
+        {
+            expr_table.push_back(expr_vector(cm.get_q_ctx(i)));
+            expr_list.push_back(cm.get_q_ctx(i).bool_val(true));
+            clause_table.push_back(expr_vector(cm.get_q_ctx(i)));
+        }
+        var_fs = std::vector<symbol_list>(core_num);
+        fun_fs = std::vector<symbol_list>(core_num);
+        stats.clause_num = num_clause;
+
+        // A cached decomposition has its components and distribution already
+        if (!cache_hit)
+        {
+            phase_timer dist_timer(phases, my_rank, 0, PZ3_phase_distribution);
+            distribute(num_clause);
+        }
+        index_clauses();
+    }
+    div_timer.pause();
+    wait_at(dist_barrier, my_rank, "wait dist_barrier");
+    div_timer.resume();
+
+    // Generate expression for corresponding core
+    build_part(my_rank, list);
+    // Keep all clauses for racing on sub-formulas of other cores
+    if (portfolio.size() > 1)
+    {
+        clause_table.at(my_rank) = list;
+    }
+    // Collect variable information for the formula of this core
+    vars_merge(my_rank);
+    funcs_merge(my_rank);
+    // The decomposition is kept for following runs on the same input
+    if (my_rank == PZ3_MASTER_THREAD && !cache_hit && !cache_key.empty())
+    {
+        save_division(list);
+    }
+    div_timer.stop();
+
+    solve_components(my_rank, list);
+
+    return NULL;
+}
+
+/*
+  Parse the input into clauses in CNF appended to list. Symbols of clause i are collected if
+  i % step == my_rank, appended to vars and funs in the order of clauses.
+*/
+bool Solver::read_input(int my_rank, unsigned step, expr_vector &list, std::vector<symbol_list> &vars,
+                        std::vector<symbol_list> &funs)
+{
+    context &ctx = cm.get_q_ctx(my_rank);
+    expr fs(ctx);
+    // Assertions are parsed a chunk at a time, and symbols of the clauses of this core are
+    // collected from each chunk while the rest of the input is still to be parsed
+    smt_reader reader(input, ctx);
+    symbol_cache sym_cache(symbols);
+    while (reader.next(fs))
+    {
+        unsigned first = list.size();
+        // Convert arbitrary formula into CNF
+        // Attention: Z3 uses tseitin method to convert a formula into CNF form in order to avoid exponential increase of problem size
+        // Therefore there are some auxiliary variables(All of them are boolean form). We don't need to care them.
+        phase_timer cnf_timer(phases, my_rank, 0, PZ3_phase_cnf);
+        if (!fs_to_cnf(my_rank, fs, list))
+        {
+            input_error("Unexpected subgoal number.");
+            return false;
+        }
+        cnf_timer.stop();
+        for (unsigned i = first; i < list.size(); i++)
+        {
+            if (i % step != (unsigned) my_rank)
+                continue;
+            vars.push_back(symbol_list());
+            funs.push_back(symbol_list());
+            get_vars(sym_cache, list[i], vars.back(), funs.back());
+            sort_symbols(vars.back());
+            sort_symbols(funs.back());
+        }
+    }
+    if (reader.failed())
+    {
+        input_error(file_reason(PZ3_file_corrupt));
+        return false;
+    }
+    return true;
+}
+
+/*
+  Prerequisite: expr_dist
+  One pass over the distribution, so a core walks only its own clauses afterwards.
+*/
+void Solver::index_clauses()
+{
+    core_clauses = std::vector<std::vector<int> >(core_num);
+    int num_clause = expr_dist.size();
+    for (int i = 0; i < num_clause; i++)
+    {
+        // clauses of components solved on their own have no core
+        int part = expr_dist.at(i);
+        if (part >= 0)
+            core_clauses.at(part).push_back(i);
+    }
+}
+
+/*
+  Prerequisite: core_clauses, expr_table, expr_list
+  Collect the clauses of a core from all clauses in its context, and conjunct them into its sub-formula.
+*/
+void Solver::build_part(int my_rank, expr_vector &list)
+{
+    assert(expr_dist.size() == list.size());
+    expr_vector &my_table = expr_table.at(my_rank);
+    std::vector<int> &my_clauses = core_clauses.at(my_rank);
+    unsigned clause_num = my_clauses.size();
+    for (unsigned i = 0; i < clause_num; i++)
+    {
+        my_table.push_back(list[my_clauses[i]]);
+    }
+    join_part(my_rank);
+}
+
+/*
+  Prerequisite: expr_table, expr_list
+  Conjunct clauses into one flat formula (an empty sub-formula is true)
+*/
+void Solver::join_part(int my_rank)
+{
+    context &ctx = cm.get_q_ctx(my_rank);
+    expr_vector &my_table = expr_table.at(my_rank);
+    unsigned lenq = my_table.size();
+    if (lenq == 0)
+    {
+        expr_list.at(my_rank) = ctx.bool_val(true);
+    }
+    else if (lenq == 1)
+    {
+        expr_list.at(my_rank) = my_table[0];
+    }
+    else if (lenq > 1)
+    {
+        array<Z3_ast> _table(my_table);
+        Z3_ast and_fs = Z3_mk_and(ctx, lenq, _table.ptr());
+        expr_list.at(my_rank) = to_expr(ctx, and_fs);
+    }
+}
+
+/*
+  Prerequisite: expr_var, expr_fun
+  Symbols of both kinds and the weight of every clause in clauses, as taken by dist_clause()
+*/
+void Solver::clause_symbols(std::vector<int> &clauses, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight)
+{
+    unsigned num = clauses.size();
+    clause_weight = std::vector<int>(num, 0);
+    symbol_sub = std::vector<symbol_list>(num);
+    std::vector<int> weights;
+    symbols.get_weights(weights);
+    for(unsigned i = 0; i < num; i++)
+    {
+        symbol_list & my_var = expr_var.at(clauses[i]);
+        symbol_list & my_fun = expr_fun.at(clauses[i]);
+        symbol_list & my_sub = symbol_sub.at(i);
+        // ids of variables and functions are disjoint, so merging keeps the list sorted
+        my_sub.resize(my_var.size() + my_fun.size());
+        std::merge(my_var.begin(), my_var.end(), my_fun.begin(), my_fun.end(), my_sub.begin());
+        unsigned sub_len = my_sub.size();
+        for(unsigned j = 0; j < sub_len; j++)
+        {
+            clause_weight.at(i) += weights.at(my_sub[j]);
+        }
+    }
+}
+
+/*
+  Prerequisite: expr_var, expr_fun
+  Fill comp_clauses, comp_core, dec_clause_num and expr_dist.
+  Large components share no symbol with each other, so each one is distributed on its own to a
+  share of the cores in proportion to its size, and no partition mixes clauses of two of them.
+*/
+void Solver::distribute(int num_clause)
+{
+    // Independent components which are small enough are solved on their own
+    std::vector<std::vector<int> > dec_comps;
+    split_components(num_clause, dec_comps);
+    unsigned dec_num = dec_comps.size();
+    dec_clause_num = 0;
+    for (unsigned c = 0; c < dec_num; c++)
+    {
+        dec_clause_num += dec_comps[c].size();
+    }
+
+    // cores of every large component: its share rounded down (at least 1, as a large component has
+    // at least one core's share of clauses), then the cores left to the largest remainders
+    std::vector<unsigned> comp_cores(dec_num, 0);
+    std::vector<std::pair<unsigned, unsigned> > remainders;
+    unsigned given = 0;
+    for (unsigned c = 0; c < dec_num; c++)
+    {
+        unsigned share = dec_comps[c].size() * core_num;
+        comp_cores[c] = std::max(share / dec_clause_num, 1u);
+        given += comp_cores[c];
+        remainders.push_back(std::make_pair(share % dec_clause_num, c));
+    }
+    std::sort(remainders.rbegin(), remainders.rend());
+    for (unsigned k = 0; given < core_num && k < dec_num; k++, given++)
+    {
+        comp_cores[remainders[k].second]++;
+    }
+
+    // merge all symbols in each clause and calculate weight of each clause
+    unsigned symbol_num = symbols.size();
+    expr_dist = std::vector<int>(num_clause, -1);
+    unsigned first_core = 0;
+    for (unsigned c = 0; c < dec_num; c++)
+    {
+        std::vector<int> &dec_clause = dec_comps[c];
+        std::vector<int> clause_weight;
+        std::vector<symbol_list> symbol_sub;
+        clause_symbols(dec_clause, symbol_sub, clause_weight);
+        std::vector<int> sub_dist(dec_clause.size(), 0);
+        if (comp_cores[c] > 1)
+        {
+            dist_clause(comp_cores[c], symbol_num, symbol_sub, clause_weight, sub_dist);
+        }
+        // map the distribution back to all clauses, -1 marks clauses of components solved on their own
+        for (unsigned i = 0; i < dec_clause.size(); i++)
+        {
+            expr_dist.at(dec_clause[i]) = first_core + sub_dist.at(i);
+        }
+        first_core += comp_cores[c];
+    }
+#ifdef PZ3_PRINT_TRACE
+    if (dec_num > 1)
+        std::cout << "Components decomposed: " << dec_num << std::endl;
+#endif
+}
+
+unsigned find_root(std::vector<unsigned> &parent, unsigned id)
+{
+    while (parent[id] != id)
+    {
+        // path halving
+        parent[id] = parent[parent[id]];
+        id = parent[id];
+    }
+    return id;
+}
+
+/*
+  Prerequisite: expr_var, expr_fun
+  Clauses sharing no symbol (directly or transitively) form independent components, which can be
+  solved separately. A component with fewer clauses than one core's share is put into comp_clauses
+  and solved sequentially, while the others are left to decomposition, each in dec_comps.
+*/
+void Solver::split_components(int num_clause, std::vector<std::vector<int> > &dec_comps)
+{
+    // union-find on symbols: all symbols of a clause belong to the same component
+    unsigned symbol_num = symbols.size();
+    std::vector<unsigned> parent(symbol_num);
+    for (unsigned id = 0; id < symbol_num; id++)
+    {
+        parent[id] = id;
+    }
+    std::vector<int> clause_root(num_clause, -1);
+    for (int i = 0; i < num_clause; i++)
+    {
+        int first = -1;
+        for (int k = 0; k < 2; k++)
+        {
+            symbol_list &syms = (k == 0) ? expr_var.at(i) : expr_fun.at(i);
+            unsigned len = syms.size();
+            for (unsigned j = 0; j < len; j++)
+            {
+                int root = find_root(parent, syms[j]);
+                if (first < 0)
+                    first = root;
+                else if (root != first)
+                    parent[root] = first;
+            }
+        }
+        clause_root.at(i) = first;
+    }
+
+    // group clauses by component; a clause without symbols is a component by itself
+    std::vector<std::vector<int> > comps;
+    std::vector<int> root_comp(symbol_num, -1);
+    for (int i = 0; i < num_clause; i++)
+    {
+        int comp;
+        if (clause_root.at(i) < 0)
+        {
+            comp = comps.size();
+            comps.push_back(std::vector<int>());
+        }
+        else
+        {
+            unsigned root = find_root(parent, clause_root.at(i));
+            if (root_comp[root] < 0)
+            {
+                root_comp[root] = comps.size();
+                comps.push_back(std::vector<int>());
+            }
+            comp = root_comp[root];
+        }
+        comps.at(comp).push_back(i);
+    }
+
+    dec_comps.clear();
+    comp_clauses.clear();
+    comp_core.clear();
+    if (comps.size() <= 1)
+    {
+        if (num_clause == 0)
+            return;
+        dec_comps.push_back(std::vector<int>());
+        for (int i = 0; i < num_clause; i++)
+        {
+            dec_comps.back().push_back(i);
+        }
+        return;
+    }
+
+    // small components go to the core with the fewest clauses so far
+    std::vector<unsigned> core_load(core_num, 0);
+    unsigned comp_num = comps.size();
+    for (unsigned c = 0; c < comp_num; c++)
+    {
+        std::vector<int> &cls = comps.at(c);
+        if (cls.size() * core_num >= (unsigned) num_clause)
+        {
+            // clauses of a component are in their original order
+            dec_comps.push_back(std::vector<int>());
+            dec_comps.back().swap(cls);
+            continue;
+        }
+        unsigned best = 0;
+        for (unsigned i = 1; i < core_num; i++)
+        {
+            if (core_load.at(i) < core_load.at(best))
+                best = i;
+        }
+        core_load.at(best) += cls.size();
+        comp_clauses.push_back(std::vector<int>());
+        comp_clauses.back().swap(cls);
+        comp_core.push_back(best);
+    }
+#ifdef PZ3_PRINT_TRACE
+    std::cout << "Components: " << comp_num << ", solved separately: " << comp_clauses.size() << std::endl;
+#endif
+}
+
+/*
+  Prerequisite: comp_clauses, comp_core
+  If any component is unsat, so is the whole formula and the other cores stop.
+*/
+void Solver::solve_components(int my_rank, expr_vector &list)
+{
+    context &ctx = cm.get_q_ctx(my_rank);
+    unsigned comp_num = comp_clauses.size();
+    for (unsigned c = 0; c < comp_num; c++)
+    {
+        if (comp_core.at(c) != my_rank)
+            continue;
+        if (early_unsat)
+            return;
+        solver s(ctx);
+        portfolio.apply(s, 0, options.timeout_ms);
+        std::vector<int> &cls = comp_clauses.at(c);
+        unsigned len = cls.size();
+        for (unsigned j = 0; j < len; j++)
+        {
+            s.add(list[cls[j]]);
+        }
+        check_result result = s.check();
+        note_solver(my_rank, my_rank, 0, PZ3_phase_subsolve, s);
+        switch (result)
+        {
+        case unsat:
+#ifdef PZ3_PRINT_TRACE
+            pthread_mutex_lock(&err_mutex);
+            std::cout << "From thread " << my_rank << ": component " << c << " unsat\n";
+            pthread_mutex_unlock(&err_mutex);
+#endif
+            stop_unsat(my_rank);
+            return;
+        case sat:
+            break;
+        default:
+            pthread_mutex_lock(&err_mutex);
+            comp_result = PZ3_unknown;
+            pthread_mutex_unlock(&err_mutex);
+        }
     }
 }
 
-PZ3_File_Type check_filetype()
+bool Solver::load_division()
 {
-    std::string smt1str(".smt");
-    std::string smt2str(".smt2");
-    int len = file_path.length();
-    if (len < 5)
-        return PZ3_smt_unknown;
-    if (file_path.compare(len - 5, 5, smt2str) == 0)
-        return PZ3_smt2;
-    if (file_path.compare(len - 4, 4, smt1str) == 0)
-        return PZ3_smt1;
-    return PZ3_smt_unknown;
+    std::ostringstream params;
+    // entries of another version of the format have symbols under other keys
+    params << "v" << PZ3_FORMAT_VERSION << "-" << core_num << "-" << dist_name;
+    cache_key = decompCache::key(input.c_str(), input.size(), params.str());
+    if (!cache.load(cache_key, cache_doc))
+        return false;
+    if (read_division())
+        return true;
+    // a partly read entry leaves nothing behind
+    symbols.clear();
+    expr_var.clear();
+    expr_fun.clear();
+    expr_dist.clear();
+    core_clauses.clear();
+    comp_clauses.clear();
+    comp_core.clear();
+    dec_clause_num = 0;
+    cache_doc.clear();
+    cache.drop(cache_key);
+    return false;
 }
 
-void fs_to_cnf(int const my_rank, expr &fs, expr_vector &list)
+/*
+  Sections of cache_doc (see PZ3_Section) give symbols, expr_var, expr_fun, expr_dist and the
+  components. Clauses are read later by every division thread into its own context.
+*/
+bool Solver::read_division()
+{
+    binReader in(cache_doc);
+    binReader section(NULL, 0);
+    unsigned tag, num, symbol_num = 0;
+    int num_clause = -1;
+    bool has_symbols = false, has_dist = false, has_comps = false;
+    while (!in.at_end())
+    {
+        if (!in.get_section(tag, section))
+            return false;
+        if (tag == PZ3_sec_symbols)
+        {
+            if (!section.get(symbol_num))
+                return false;
+            for (unsigned i = 0; i < symbol_num; i++)
+            {
+                std::string key;
+                unsigned is_func, arity, weight;
+                if (!section.get(key) || !section.get(is_func) || !section.get(arity) || !section.get(weight))
+                    return false;
+                // keys are distinct, so ids come out as they were
+                if (symbols.intern(key, is_func != 0, arity, (int) weight) != i)
+                    return false;
+            }
+            has_symbols = true;
+        }
+        else if (tag == PZ3_sec_clause_symbols)
+        {
+            if (!section.get(num))
+                return false;
+            expr_var = std::vector<symbol_list>(num);
+            expr_fun = std::vector<symbol_list>(num);
+            for (unsigned i = 0; i < num; i++)
+            {
+                if (!section.get(expr_var.at(i)) || !section.get(expr_fun.at(i)))
+                    return false;
+            }
+            if (num_clause >= 0 && num_clause != (int) num)
+                return false;
+            num_clause = num;
+        }
+        else if (tag == PZ3_sec_dist)
+        {
+            if (!section.get(num))
+                return false;
+            expr_dist = std::vector<int>(num, -1);
+            dec_clause_num = 0;
+            for (unsigned i = 0; i < num; i++)
+            {
+                unsigned part;
+                if (!section.get(part) || part > core_num)
+                    return false;
+                expr_dist.at(i) = (int) part - 1;
+                if (part > 0)
+                    dec_clause_num++;
+            }
+            if (num_clause >= 0 && num_clause != (int) num)
+                return false;
+            num_clause = num;
+            has_dist = true;
+        }
+        else if (tag == PZ3_sec_components)
+        {
+            if (!section.get(num))
+                return false;
+            for (unsigned c = 0; c < num; c++)
+            {
+                unsigned core, len;
+                symbol_list clauses;
+                if (!section.get(core) || core >= core_num || !section.get(clauses))
+                    return false;
+                comp_core.push_back(core);
+                comp_clauses.push_back(std::vector<int>(clauses.begin(), clauses.end()));
+                len = clauses.size();
+                if (len > 0 && (int) clauses[len - 1] >= num_clause)
+                    return false;
+            }
+            has_comps = true;
+        }
+    }
+    if (!has_symbols || !has_dist || !has_comps || (unsigned) num_clause != expr_var.size())
+        return false;
+    // every symbol of a clause is known
+    for (int i = 0; i < num_clause; i++)
+    {
+        symbol_list &vars = expr_var.at(i);
+        symbol_list &funs = expr_fun.at(i);
+        if ((!vars.empty() && vars.back() >= symbol_num) || (!funs.empty() && funs.back() >= symbol_num))
+            return false;
+    }
+    return true;
+}
+
+bool Solver::read_clauses(context &ctx, expr_vector &list)
+{
+    binReader in(cache_doc);
+    binReader section(NULL, 0);
+    unsigned tag, num;
+    do
+    {
+        if (!in.get_section(tag, section))
+            return false;
+    }
+    while (tag != PZ3_sec_exprs);
+    exprDecoder table(ctx);
+    if (!table.read(section) || !section.get(num) || num != expr_dist.size())
+        return false;
+    for (unsigned i = 0; i < num; i++)
+    {
+        expr clause(ctx);
+        if (!table.get(section, clause))
+            return false;
+        list.push_back(clause);
+    }
+    return true;
+}
+
+void Solver::save_division(expr_vector &list)
+{
+    binWriter doc;
+    binWriter section;
+    unsigned num_clause = list.size();
+
+    // clauses in CNF; inputs beyond QF_UF are not cached
+    exprEncoder table;
+    std::vector<unsigned> roots(num_clause);
+    for (unsigned i = 0; i < num_clause; i++)
+    {
+        if (!table.add(list[i], roots[i]))
+            return;
+    }
+    table.write(section);
+    section.put(num_clause);
+    for (unsigned i = 0; i < num_clause; i++)
+        section.put(roots[i]);
+    doc.put_section(PZ3_sec_exprs, section);
+
+    std::vector<std::string> keys;
+    symbols.get_keys(keys);
+    section.clear();
+    section.put((unsigned) keys.size());
+    for (unsigned i = 0; i < keys.size(); i++)
+    {
+        section.put(keys[i]);
+        section.put(symbols.is_func(i) ? 1u : 0u);
+        section.put(symbols.get_arity(i));
+        section.put((unsigned) symbols.get_weight(i));
+    }
+    doc.put_section(PZ3_sec_symbols, section);
+
+    section.clear();
+    section.put(num_clause);
+    for (unsigned i = 0; i < num_clause; i++)
+    {
+        section.put(expr_var.at(i));
+        section.put(expr_fun.at(i));
+    }
+    doc.put_section(PZ3_sec_clause_symbols, section);
+
+    section.clear();
+    section.put(num_clause);
+    for (unsigned i = 0; i < num_clause; i++)
+        section.put((unsigned) (expr_dist.at(i) + 1));
+    doc.put_section(PZ3_sec_dist, section);
+
+    section.clear();
+    section.put((unsigned) comp_clauses.size());
+    for (unsigned c = 0; c < comp_clauses.size(); c++)
+    {
+        section.put((unsigned) comp_core.at(c));
+        section.put(symbol_list(comp_clauses.at(c).begin(), comp_clauses.at(c).end()));
+    }
+    doc.put_section(PZ3_sec_components, section);
+    cache_doc = doc.data();
+}
+
+PZ3_File_Result Solver::parse_file(context &ctx, expr &fs)
+{
+    if (!input.parse(ctx, fs))
+        return PZ3_file_corrupt;
+    return PZ3_file_ok;
+}
+
+bool Solver::fs_to_cnf(int const my_rank, expr &fs, expr_vector &list)
 {
     context &ctx = cm.get_q_ctx(my_rank);
     goal g(ctx);
@@ -527,8 +1869,7 @@ void fs_to_cnf(int const my_rank, expr &fs, expr_vector &list)
 
     if (aresult.size() != 1)
     {
-        std::cerr << "Unexpected subgoal number.\n" << std::endl;
-        exit(1);
+        return false;
     }
     goal sg = aresult[0];
     unsigned expr_num = sg.size();
@@ -536,56 +1877,59 @@ void fs_to_cnf(int const my_rank, expr &fs, expr_vector &list)
     {
         list.push_back(sg[i]);
     }
+    return true;
 }
 
-void *subsolve(void *rank)
+void *Solver::subsolve(void *rank)
 {
-#ifdef PZ3_FINE_GRAINED_PROF
-    boost_clock::time_point solve_start = boost_clock::now();
-    boost::chrono::milliseconds subsolve_time;
-#endif
-#ifdef PZ3_PROFILING
-    boost_clock::time_point subsolve_start = boost_clock::now();
-#endif
     long my_rank_l = (long) rank;
     int my_rank = (int) my_rank_l;
-    context &ctx = cm.get_q_ctx(my_rank);
-    solver s(ctx);
-    s.add(expr_list.at(my_rank));
-    switch (s.check())
+    phase_timer solve_timer(phases, my_rank, 0, PZ3_phase_subsolve);
+    check_result result;
+    if (incremental)
+    {
+        // the solver of the partition has its clauses, and keeps what it learnt in earlier checks
+        result = part_solvers.at(my_rank)->check();
+        note_solver(my_rank, my_rank, 0, PZ3_phase_subsolve, *part_solvers.at(my_rank), &part_totals.at(my_rank));
+    }
+    else if (workers.empty())
+    {
+        context &ctx = cm.get_q_ctx(my_rank);
+        solver s(ctx);
+        portfolio.apply(s, 0, options.timeout_ms);
+        s.add(expr_list.at(my_rank));
+        result = s.check();
+        note_solver(my_rank, my_rank, 0, PZ3_phase_subsolve, s);
+    }
+    else
+    {
+        // the worker keeps the sub-formula for conciliation
+        result = worker_load(my_rank);
+    }
+    // another core may have solved this sub-formula first and interrupted us
+    result = finish_race(my_rank, my_rank, 0, result);
+    // workers have no copy of sub-formulas of other partitions to race on
+    if (result != unsat && !early_unsat && workers.empty())
+    {
+        // help sub-formulas still being solved
+        help_race(my_rank);
+    }
+    solve_timer.stop();
+    switch (result)
     {
     case unsat:
-        pthread_mutex_lock(&err_mutex);
 #ifdef PZ3_PRINT_TRACE
+        pthread_mutex_lock(&err_mutex);
         std::cout << "From thread " << my_rank << ": unsat\n";
+        pthread_mutex_unlock(&err_mutex);
 #endif
-#ifdef PZ3_PROFILING
-        // before exit, we should output the subsolve time
-        subsolve_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - subsolve_start);
-        std::cout << "SUBSOLVE: " << subsolve_time << std::endl;
-        std::cout << "CONCILIATION: " << conciliate_time << std::endl;
-#endif
-        std::cout << "unsat" << std::endl;
-#ifdef PZ3_FINE_GRAINED_PROF
-            // before exit, we should output time metrics
-        subsolve_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - solve_start);
-        solve_time.fetch_add(subsolve_time.count(), boost::memory_order_relaxed);
-        std::cout << "SOLVE: " << solve_time << std::endl;
-        std::cout << "INTERP: " << 0 << std::endl;
-        std::cout << "SSR: " << 0 << std::endl;
-        std::cout << "FORM: " << 0 << std::endl;
-        std::cout << "GENSOLVE: " << solve_time << std::endl;
-#endif
-        exit(0);
+        stop_unsat(my_rank);
+        break;
     case sat:
 #ifdef PZ3_PRINT_TRACE
         pthread_mutex_lock(&err_mutex);
         std::cout << "From thread " << my_rank << ": sat\n";
         pthread_mutex_unlock(&err_mutex);
-#endif
-#ifdef PZ3_FINE_GRAINED_PROF
-        subsolve_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - solve_start);
-        solve_time.fetch_add(subsolve_time.count(), boost::memory_order_relaxed);
 #endif
         break;
     default:
@@ -594,17 +1938,141 @@ void *subsolve(void *rank)
         std::cout << "From thread " << my_rank << ": unknown\n";
         pthread_mutex_unlock(&err_mutex);
 #endif
-#ifdef PZ3_FINE_GRAINED_PROF
-        subsolve_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - solve_start);
-        solve_time.fetch_add(subsolve_time.count(), boost::memory_order_relaxed);
-#endif
-        return NULL;
+        break;
+    }
+
+    // Extract shared symbols of this sub-formula once shared_count() is done
+    wait_at(coll_barrier, my_rank, "wait coll_barrier");
+    if (!early_unsat)
+    {
+        trace_span span(trace, my_rank, "extract_vars");
+        extract_vars(rank);
     }
 
+    // From now on the context of this core is not used until conciliation
+    pthread_mutex_lock(&ready_mutex);
+    core_ready.at(my_rank) = true;
+    pthread_cond_broadcast(&ready_cond);
+    pthread_mutex_unlock(&ready_mutex);
+
     return NULL;
 }
 
-void get_vars(expr fs, std::map<unsigned, int> &vl, std::map<unsigned, int> &fl)
+/*
+  The formula is unsat: cancel the set-up of shared context and interrupt solvers of other cores
+*/
+void Solver::stop_unsat(int my_rank)
+{
+    pthread_mutex_lock(&ready_mutex);
+    setup_cancel = true;
+    pthread_cond_broadcast(&ready_cond);
+    pthread_mutex_unlock(&ready_mutex);
+    pthread_mutex_lock(&race_mutex);
+    early_unsat = true;
+    for (unsigned i = 0; i < core_num; i++)
+    {
+        if ((int) i == my_rank)
+            continue;
+        if (workers.empty())
+            Z3_interrupt(cm.get_q_ctx(i));
+        else
+            workers.at(i)->interrupt();
+    }
+    pthread_mutex_unlock(&race_mutex);
+}
+
+/*
+  Prerequisite: part_done, part_racers, helping
+  Called by every core racing on sub-formula part once its solver returns. The first known result
+  wins and the other racers are interrupted. Returns the result of the sub-formula.
+  A racer interrupted just before its check starts keeps solving, which is harmless.
+*/
+check_result Solver::finish_race(int part, int my_rank, unsigned config, check_result result)
+{
+    pthread_mutex_lock(&race_mutex);
+    if (my_rank != part)
+        helping.at(my_rank) = -1;
+    if (!part_done.at(part) && (result != unknown || my_rank == part))
+    {
+        part_done.at(part) = true;
+        part_result.at(part) = result;
+        part_winner.at(part) = config;
+        if (part_racers.at(part) > 0)
+        {
+            portfolio.record_win(config);
+            if (my_rank != part)
+                Z3_interrupt(cm.get_q_ctx(part));
+            for (unsigned i = 0; i < core_num; i++)
+            {
+                if ((int) i != my_rank && helping.at(i) == part)
+                    Z3_interrupt(cm.get_q_ctx(i));
+            }
+        }
+    }
+    if (part_done.at(part))
+        result = part_result.at(part);
+    pthread_mutex_unlock(&race_mutex);
+    return result;
+}
+
+/*
+  Prerequisite: clause_table, core_clauses
+  A core done with its own sub-formula runs other configurations of the portfolio on unfinished
+  sub-formulas, taking the one with fewest racers. Clauses are taken from the copy of the formula
+  in the context of this core, so the context of the owner is never touched.
+*/
+void Solver::help_race(int my_rank)
+{
+    if (portfolio.size() < 2)
+        return;
+    context &ctx = cm.get_q_ctx(my_rank);
+    expr_vector &my_clauses = clause_table.at(my_rank);
+    while (true)
+    {
+        pthread_mutex_lock(&race_mutex);
+        int part = -1;
+        for (unsigned i = 0; i < core_num; i++)
+        {
+            if (part_done.at(i) || part_racers.at(i) + 1 >= portfolio.size())
+                continue;
+            if (part < 0 || part_racers.at(i) < part_racers.at(part))
+                part = i;
+        }
+        if (part < 0 || early_unsat)
+        {
+            pthread_mutex_unlock(&race_mutex);
+            return;
+        }
+        if (part_racers.at(part) == 0)
+            portfolio.record_race(0);
+        part_racers.at(part)++;
+        unsigned config = part_racers.at(part);
+        portfolio.record_race(config);
+        helping.at(my_rank) = part;
+        pthread_mutex_unlock(&race_mutex);
+
+#ifdef PZ3_PRINT_TRACE
+        pthread_mutex_lock(&err_mutex);
+        std::cout << "Thread " << my_rank << " races on sub-formula " << part << " with " << portfolio.get_name(config) << std::endl;
+        pthread_mutex_unlock(&err_mutex);
+#endif
+        solver s(ctx);
+        portfolio.apply(s, config, options.timeout_ms);
+        std::vector<int> &part_clauses = core_clauses.at(part);
+        for (unsigned i = 0; i < part_clauses.size(); i++)
+        {
+            s.add(my_clauses[part_clauses[i]]);
+        }
+        check_result result = s.check();
+        note_solver(my_rank, my_rank, 0, PZ3_phase_subsolve, s);
+        finish_race(part, my_rank, config, result);
+    }
+}
+
+/*
+  Symbols are appended to vl and fl as they are met; callers sort the lists with sort_symbols()
+*/
+void get_vars(symbol_cache &cache, expr fs, symbol_list &vl, symbol_list &fl)
 {
     if (!fs.is_app())
         return;
@@ -614,143 +2082,110 @@ void get_vars(expr fs, std::map<unsigned, int> &vl, std::map<unsigned, int> &fl)
             return;
         else
         {
-            unsigned hashid = fs.hash();
-            std::map<unsigned, int>::iterator it = vl.find(hashid);
-            if (it == vl.end())
-            {
-                // FIXME: weight of variable
-                vl.insert(std::pair<unsigned, int>(hashid, PZ3_VAR_WEIGHT));
-            }
             // We don't care if this symbol appears for several times
+            vl.push_back(cache.var_id(fs));
             return;
         }
     }
     else if (fs.decl().decl_kind() == Z3_OP_UNINTERPRETED)
     {
         // deal with uninterpreted function
-        unsigned hashid = fs.decl().hash();
-        unsigned arity = fs.decl().arity();
-        std::map<unsigned, int>::iterator it = fl.find(hashid);
-        if (it == fl.end())
-        {
-            // FIXME: weight of function (arity considered)
-            int fun_weight = arity * PZ3_FUNC_WEIGHT;
-            fl.insert(std::pair<unsigned, int>(hashid, fun_weight));
-        }
+        fl.push_back(cache.fun_id(fs.decl()));
     }
     int narg = fs.num_args();
     for (int i = 0; i < narg; i++)
     {
-        get_vars(fs.arg(i), vl, fl);
+        get_vars(cache, fs.arg(i), vl, fl);
     }
 }
 
-void map_merge(std::set<unsigned> &result,
-               std::map<unsigned, int> input)
+/*
+  Prerequisite: core_clauses
+  Marks symbols of the clauses of one core in a flag array indexed by symbol id, then reads the flags
+  back in id order. Every core runs this on its own clauses, writing only its own list, which is its
+  part of the counts of shared_count().
+*/
+void Solver::symbols_merge(int my_rank, std::vector<symbol_list> &clause_syms, symbol_list &core_syms)
 {
-    std::map<unsigned, int>::iterator it = input.begin();
-    std::map<unsigned, int>::iterator it_end = input.end();
-    while (it != it_end)
+    unsigned symbol_num = symbols.size();
+    std::vector<char> mark(symbol_num, 0);
+    std::vector<int> &my_clauses = core_clauses.at(my_rank);
+    unsigned clause_num = my_clauses.size();
+    for (unsigned i = 0; i < clause_num; i++)
+    {
+        symbol_list &syms = clause_syms.at(my_clauses[i]);
+        unsigned len = syms.size();
+        for (unsigned j = 0; j < len; j++)
+        {
+            mark[syms[j]] = 1;
+        }
+    }
+    core_syms.clear();
+    for (unsigned id = 0; id < symbol_num; id++)
     {
-        std::set<unsigned>::iterator ite = result.find(it->first);
-        if (ite == result.end())
-            result.insert(it->first);
-        it++;
+        if (mark[id])
+            core_syms.push_back(id);
     }
 }
 
 /*
-  Prerequisite: expr_dist, expr_var
+  Prerequisite: core_clauses, expr_var
 */
-void vars_merge()
+void Solver::vars_merge(int my_rank)
 {
-    var_fs = std::vector<std::set<unsigned> >(core_num);
-    int dist_len = expr_dist.size();
-    for (int i = 0; i < dist_len; i++)
-    {
-        int core_index = expr_dist.at(i);
-        map_merge(var_fs.at(core_index), expr_var.at(i));
-    }
+    symbols_merge(my_rank, expr_var, var_fs.at(my_rank));
 }
 /*
-  Prerequisite: expr_dist, expr_fun
+  Prerequisite: core_clauses, expr_fun
  */
-void funcs_merge()
+void Solver::funcs_merge(int my_rank)
 {
-    fun_fs = std::vector<std::set<unsigned> >(core_num);
-    int dist_len = expr_dist.size();
-    for (int i = 0; i < dist_len; i++)
-    {
-        int core_index = expr_dist.at(i);
-        map_merge(fun_fs.at(core_index), expr_fun.at(i));
-    }
+    symbols_merge(my_rank, expr_fun, fun_fs.at(my_rank));
 }
 
 /*
-  Prerequisite: var_fs, fun_fs,  expr_list
+  Prerequisite: var_fs, fun_fs
+  Only the symbol lists of cores are read, so this runs while sub-formulas are solved. The lists are
+  the counts of the cores, so they are summed in one pass over them, and a symbol is taken as shared
+  when its count reaches 2.
 */
-void shared_collect()
+void Solver::shared_count()
 {
-    // Extract shared variables first
-    std::map<unsigned, int> var_map;
-    for (unsigned i = 0; i < core_num; i++)
-    {
-        std::set<unsigned> fsv = var_fs.at(i);
-        std::set<unsigned>::iterator it_begin = fsv.begin();
-        std::set<unsigned>::iterator it_end = fsv.end();
-        for (std::set<unsigned>::iterator it = it_begin; it != it_end;
-                ++it)
-        {
-            std::map<unsigned, int>::iterator vm_it = var_map.find(
-                        *it);
-            if (vm_it == var_map.end())
-                var_map.insert(std::pair<unsigned, int>(*it, 1));
-            else
-                (vm_it->second)++;
-        }
-    }
-    // Extract shared functions
-    std::map<unsigned, int> fun_map;
+    // Variables and functions have disjoint ids, so one counter array serves both
+    unsigned symbol_num = symbols.size();
+    std::vector<char> sym_count(symbol_num, 0);
     for (unsigned i = 0; i < core_num; i++)
     {
-        std::set<unsigned> fsf = fun_fs.at(i);
-        std::set<unsigned>::iterator it_begin = fsf.begin();
-        std::set<unsigned>::iterator it_end = fsf.end();
-        for (std::set<unsigned>::iterator itr = it_begin; itr != it_end; ++itr)
-        {
-            std::map<unsigned, int>::iterator fm_it = fun_map.find(*itr);
-            if (fm_it == fun_map.end())
-                fun_map.insert(std::pair<unsigned, int>(*itr, 1));
-            else
-                (fm_it->second)++;
-        }
-    }
-
-    // Extract variables appeared for more than 1 time
-    std::map<unsigned, int>::iterator vm_begin = var_map.begin();
-    std::map<unsigned, int>::iterator vm_end = var_map.end();
-    for (std::map<unsigned, int>::iterator it = vm_begin; it != vm_end;
-            ++it)
-    {
-        if (it->second > 1)
+        symbol_list &fsv = var_fs.at(i);
+        unsigned len = fsv.size();
+        for (unsigned j = 0; j < len; j++)
         {
             // This is a shared variable
-            sv_set.insert(it->first);
+            char &count = sym_count[fsv[j]];
+            if (count < 2 && ++count == 2)
+                sv_set.push_back(fsv[j]);
         }
-    }
-
-    // Extract functions appeared for more than 1 time
-    std::map<unsigned, int>::iterator fm_begin = fun_map.begin();
-    std::map<unsigned, int>::iterator fm_end = fun_map.end();
-    for (std::map<unsigned, int>::iterator it = fm_begin; it != fm_end; ++it)
-    {
-        if (it->second > 1)
+        symbol_list &fsf = fun_fs.at(i);
+        len = fsf.size();
+        for (unsigned j = 0; j < len; j++)
         {
             // This is a shared function
-            sf_set.insert(it->first);
+            char &count = sym_count[fsf[j]];
+            if (count < 2 && ++count == 2)
+                sf_set.push_back(fsf[j]);
         }
     }
+    // in id order, as the lists of cores are
+    std::sort(sv_set.begin(), sv_set.end());
+    std::sort(sf_set.begin(), sf_set.end());
+}
 
+/*
+  Prerequisite: shared_count(), extract_vars() on every core and shared_setup()
+  Returns false if there is nothing to conciliate
+*/
+bool Solver::shared_collect()
+{
     // If sv_set is empty, then every sub-formula is separated
     // Then result of instance is SAT
     if (sv_set.size() == 0)
@@ -758,52 +2193,27 @@ void shared_collect()
 #ifdef PZ3_PRINT_TRACE
         std::cout << "Separated problem" << std::endl;
 #endif
-        std::cout << "sat" << std::endl;
-        exit(0);
+        return false;
     }
 #ifdef PZ3_PRINT_TRACE
     std::cout << "Shared variables: " << sv_set.size() << std::endl;
     std::cout << "Shared functions: " << sf_set.size() << std::endl;
 #endif
 
-    // Extract shared variables and function declarations by cores on parallel
-    var_expr = std::vector<std::map<unsigned, expr> >(core_num);
-    fun_expr = std::vector<std::map<unsigned, func_decl> >(core_num);
-    pthread_t *thread_handles = (pthread_t *) malloc(
-                                    core_num * sizeof(pthread_t));
-    for (unsigned i = 0; i < core_num; i++)
-    {
-        pthread_create(&thread_handles[i], NULL, extract_vars,
-                       (void *) ((long) i));
-    }
-    for (unsigned i = 0; i < core_num; i++)
-    {
-        pthread_join(thread_handles[i], NULL);
-    }
-
-#ifdef PZ3_PRINT_TRACE
-    std::cout << "SV and SF Extraction Complete!" << std::endl;
-#endif
-
-    // Create a context for shared variables
-    config cfg;
-    cfg.set("MODEL", true);
-    cfg.set("PROOF", true);
-    cm.mk_s_ctx(cfg);
-
     // Succeeded if reaching there.
+    return true;
 }
 
-void *extract_vars(void *arg)
+void *Solver::extract_vars(void *arg)
 {
     long my_rank_l = (long) arg;
     int my_rank = (int) my_rank_l;
 
     std::set<unsigned> my_sv;
-    std::set<unsigned>::iterator it1 = var_fs.at(my_rank).begin();
-    std::set<unsigned>::iterator it1_end = var_fs.at(my_rank).end();
-    std::set<unsigned>::iterator it2 = sv_set.begin();
-    std::set<unsigned>::iterator it2_end = sv_set.end();
+    symbol_list::iterator it1 = var_fs.at(my_rank).begin();
+    symbol_list::iterator it1_end = var_fs.at(my_rank).end();
+    symbol_list::iterator it2 = sv_set.begin();
+    symbol_list::iterator it2_end = sv_set.end();
     while (it1 != it1_end && it2 != it2_end)
     {
         if (*it1 == *it2)
@@ -819,10 +2229,10 @@ void *extract_vars(void *arg)
     }
 
     std::set<unsigned> my_sf;
-    std::set<unsigned>::iterator it3 = fun_fs.at(my_rank).begin();
-    std::set<unsigned>::iterator it3_end = fun_fs.at(my_rank).end();
-    std::set<unsigned>::iterator it4 = sf_set.begin();
-    std::set<unsigned>::iterator it4_end = sf_set.end();
+    symbol_list::iterator it3 = fun_fs.at(my_rank).begin();
+    symbol_list::iterator it3_end = fun_fs.at(my_rank).end();
+    symbol_list::iterator it4 = sf_set.begin();
+    symbol_list::iterator it4_end = sf_set.end();
     while (it3 != it3_end && it4 != it4_end)
     {
         if (*it3 == *it4)
@@ -838,16 +2248,17 @@ void *extract_vars(void *arg)
     }
 
     // my_sv and my_sf extracted
+    symbol_cache cache(symbols);
     // extract variables from sub-formula
-    assoc_vars(expr_list.at(my_rank), my_sv, var_expr.at(my_rank));
+    assoc_vars(cache, expr_list.at(my_rank), my_sv, var_expr.at(my_rank));
 
     // extract function declarations from sub-formula
-    assoc_funs(expr_list.at(my_rank), my_sf, fun_expr.at(my_rank));
+    assoc_funs(cache, expr_list.at(my_rank), my_sf, fun_expr.at(my_rank));
 
     return NULL;
 }
 
-void assoc_vars(expr in_fs, std::set<unsigned> &vars,
+void assoc_vars(symbol_cache &cache, expr in_fs, std::set<unsigned> &vars,
                 std::map<unsigned, expr> &var_map)
 {
     // if vars is reduced to empty list, return from this function
@@ -861,7 +2272,7 @@ void assoc_vars(expr in_fs, std::set<unsigned> &vars,
             return;
         else
         {
-            unsigned hashid = in_fs.hash();
+            unsigned hashid = cache.var_id(in_fs);
             std::set<unsigned>::iterator it = vars.find(hashid);
             if (it == vars.end())
             {
@@ -880,11 +2291,11 @@ void assoc_vars(expr in_fs, std::set<unsigned> &vars,
     int narg = in_fs.num_args();
     for (int i = 0; i < narg; i++)
     {
-        assoc_vars(in_fs.arg(i), vars, var_map);
+        assoc_vars(cache, in_fs.arg(i), vars, var_map);
     }
 }
 
-void assoc_funs(expr in_fs, std::set<unsigned> &funs, std::map<unsigned, func_decl> &fun_map)
+void assoc_funs(symbol_cache &cache, expr in_fs, std::set<unsigned> &funs, std::map<unsigned, func_decl> &fun_map)
 {
     if (funs.size() == 0)
         return;
@@ -898,7 +2309,7 @@ void assoc_funs(expr in_fs, std::set<unsigned> &funs, std::map<unsigned, func_de
     else if (in_fs.decl().decl_kind() == Z3_OP_UNINTERPRETED)
     {
         // deal with uninterpreted function
-        unsigned hashid = in_fs.decl().hash();
+        unsigned hashid = cache.fun_id(in_fs.decl());
         std::set<unsigned>::iterator it = funs.find(hashid);
         if (it == funs.end())
         {
@@ -916,32 +2327,34 @@ void assoc_funs(expr in_fs, std::set<unsigned> &funs, std::map<unsigned, func_de
     int narg = in_fs.num_args();
     for (int i = 0; i < narg; i++)
     {
-        assoc_funs(in_fs.arg(i), funs, fun_map);
+        assoc_funs(cache, in_fs.arg(i), funs, fun_map);
     }
 }
 
-void *master_func(void *arg)
+/*
+  Prerequisite: shared context, shared_count()
+  Runs while sub-formulas are solved. Shared symbols of a core are translated as soon as the core
+  has solved its sub-formula and extracted them, since its context cannot be read before.
+*/
+void *Solver::shared_setup(void *arg)
 {
-#ifdef PZ3_PROFILING
-    boost_clock::time_point subsolve_start;
-    boost_clock::time_point conciliate_start;
-
-    conciliate_start = boost_clock::now();
-#endif
-#ifdef PZ3_FINE_GRAINED_PROF
-    boost_clock::time_point master_start;
-    boost::chrono::milliseconds master_time;
-#endif
-    long return_val = 2;
+    // Create a context for shared variables, kept with the solver of the master by incremental instances
+    if (!incremental || shared_solver == NULL)
+    {
+        config cfg;
+        cfg.set("MODEL", true);
+        cfg.set("PROOF", true);
+        cm.mk_s_ctx(cfg);
+    }
     context &m_ctx = cm.get_s_ctx();
-    // fi_vec: used to store function instances in shared context
-    expr_vector fi_vec(m_ctx);
-    solver sv_solve(m_ctx);
-    bool pure_literal = false;
+    if (incremental && shared_solver == NULL)
+    {
+        shared_solver = new solver(m_ctx);
+        // it goes into the scopes opened before
+        for (unsigned i = 0; i < inc_scopes.size(); i++)
+            shared_solver->push();
+    }
 
-#ifdef PZ3_FINE_GRAINED_PROF
-    master_start = boost_clock::now();
-#endif
     // get hash value of TRUE and FALSE
     unsigned bool_id = m_ctx.bool_sort().hash();
     unsigned true_id = m_ctx.bool_val(true).hash();
@@ -949,76 +2362,123 @@ void *master_func(void *arg)
     true_clo = closure(bool_id, true_id);
     false_clo = closure(bool_id, false_id);
 
-    // First we need to extract variables for shared context
-    std::map<unsigned, expr> sv_map;
-    for (unsigned i = 0; i < core_num; i++)
-    {
+    std::map<unsigned, func_decl> sf_map;
+    std::vector<bool> core_done(core_num, false);
+    for (unsigned done_num = 0; done_num < core_num; done_num++)
+    {
+        // wait for a core to finish its sub-formula
+        int i = -1;
+        trace.begin(core_num, "wait core");
+        pthread_mutex_lock(&ready_mutex);
+        while (!setup_cancel)
+        {
+            for (unsigned j = 0; j < core_num; j++)
+            {
+                if (core_ready.at(j) && !core_done.at(j))
+                {
+                    i = j;
+                    break;
+                }
+            }
+            if (i >= 0)
+                break;
+            pthread_cond_wait(&ready_cond, &ready_mutex);
+        }
+        pthread_mutex_unlock(&ready_mutex);
+        trace.end(core_num, "wait core");
+        if (i < 0)
+            return NULL;
+        core_done.at(i) = true;
+        phase_timer trans_timer(phases, core_num, 0, PZ3_phase_translation);
+
+        // First we need to extract variables for shared context
         std::map<unsigned, expr>::iterator vesub = var_expr.at(i).begin();
         std::map<unsigned, expr>::iterator vesub_end = var_expr.at(i).end();
-        while (vesub != vesub_end && sv_set.size() != 0)
+        while (vesub != vesub_end && sv_map.size() != sv_set.size())
         {
-            unsigned hashid = vesub->first;
-            std::set<unsigned>::iterator findit = sv_set.find(hashid);
-            if (findit != sv_set.end())
+            unsigned sym_id = vesub->first;
+            if (sv_map.find(sym_id) == sv_map.end())
             {
                 // we found an element
-                sv_set.erase(findit);
                 expr correex = vesub->second;
                 expr localex = to_expr(m_ctx, Z3_translate(cm.get_q_ctx(i), correex, m_ctx));
-                sv_map.insert(std::pair<unsigned, expr>(hashid, localex));
+                sv_map.insert(std::pair<unsigned, expr>(sym_id, localex));
             }
             ++vesub;
         }
-    }
-
-    if (sf_set.size() == 0)
-    {
-        pure_literal = true;
-    }
 
-    // Then we extract function declarations for shared context
-    std::map<unsigned, func_decl> sf_map;
-    for (unsigned i = 0; i < core_num; i++)
-    {
+        // Then we extract function declarations for shared context
         std::map<unsigned, func_decl>::iterator fdsub = fun_expr.at(i).begin();
         std::map<unsigned, func_decl>::iterator fdsub_end = fun_expr.at(i).end();
-        while (fdsub != fdsub_end && sf_set.size() != 0)
+        while (fdsub != fdsub_end && sf_map.size() != sf_set.size())
         {
-            unsigned hashid = fdsub->first;
-            std::set<unsigned>::iterator findit = sf_set.find(hashid);
-            if (findit != sf_set.end())
+            unsigned sym_id = fdsub->first;
+            if (sf_map.find(sym_id) == sf_map.end())
             {
                 // we found an element
-                sf_set.erase(findit);
                 func_decl correfd = fdsub->second;
                 func_decl localfd = PZ3_translate_func_decl(cm.get_q_ctx(i), correfd, m_ctx);
-                sf_map.insert(std::pair<unsigned, func_decl>(hashid, localfd));
+                sf_map.insert(std::pair<unsigned, func_decl>(sym_id, localfd));
             }
             ++fdsub;
         }
     }
 
     // Initialize congruence closure for shared variables (ignore functions temporarily)
-    assert(svexpr.size() == 0);
-    // sv_solve is empty, but check() is necessary for getting an empty model
-    sv_solve.check();
-    model pre_model = sv_solve.get_model();
+    // An incremental instance starts from the classes of the last check, which are in the same context
+    flat_map<unsigned, closure> last_svexpr = svexpr;
+    svexpr.clear();
+    // the solver is empty, but check() is necessary for getting an empty model
+    solver empty_solve(m_ctx);
+    empty_solve.check();
+    model pre_model = empty_solve.get_model();
     for (std::map<unsigned, expr>::iterator svit = sv_map.begin(); svit != sv_map.end(); ++svit)
     {
+        flat_map<unsigned, closure>::iterator last = last_svexpr.find(svit->first);
+        if (last != last_svexpr.end())
+        {
+            svexpr.insert(*last);
+            continue;
+        }
         expr evalresult = pre_model.eval(svit->second, true);
         closure myclo;
         myclo.set(evalresult);
         svexpr.insert(std::pair<unsigned, closure>(svit->first, myclo));
     }
-    // initially there is no shared function instance
-#ifdef PZ3_FINE_GRAINED_PROF
-    master_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - master_start);
-    ssr_time.fetch_add(master_time.count(), boost::memory_order_relaxed);
+#ifdef PZ3_PRINT_TRACE
+    pthread_mutex_lock(&err_mutex);
+    std::cout << "Shared context set-up completed" << std::endl;
+    pthread_mutex_unlock(&err_mutex);
 #endif
+    return NULL;
+}
 
-#ifdef PZ3_PROFILING
-    conciliate_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - conciliate_start);
-#endif
+void *Solver::master_func(void *arg)
+{
+    long return_val = 2;
+    context &m_ctx = cm.get_s_ctx();
+    // fi_vec: used to store function instances in shared context
+    expr_vector fi_vec(m_ctx);
+    // interpolants are consequences of sub-formulas, so an incremental instance keeps them in its
+    // scopes for later checks
+    solver sv_solve = incremental ? *shared_solver : solver(m_ctx);
+    // statistics of sv_solve add up over rounds, and over checks of an incremental instance
+    solver_counts round_totals;
+    solver_counts &sv_totals = incremental ? shared_totals : round_totals;
+    bool pure_literal = false;
+    // fist: scratch key, fist_count: function instances read from models of sub-problems
+    // both are reused in every round to avoid reallocation
+    fist_key fist;
+    fist_map<std::vector<closure> > fist_count;
+    // cache: symbol ids of function declarations in shared context
+    symbol_cache cache(symbols);
+    unsigned round = 0;
+
+    // Shared variables were translated and svexpr initialized by shared_setup()
+    if (sf_set.size() == 0)
+    {
+        pure_literal = true;
+    }
 
 #ifdef PZ3_PRINT_TRACE
     pthread_mutex_lock(&err_mutex);
@@ -1028,16 +2488,13 @@ void *master_func(void *arg)
 
     while (true)
     {
-#ifdef PZ3_PROFILING
-        subsolve_start = boost_clock::now();
-#endif
-        pthread_barrier_wait(&barrier1);
+        // slaves work on round + 1 between the barriers
+        wait_at(barrier1, core_num, "wait barrier1", round + 1);
         if (need_term)
             break;
-        pthread_barrier_wait(&barrier2);
-#ifdef PZ3_PROFILING
-        subsolve_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - subsolve_start);
-#endif
+        wait_at(barrier2, core_num, "wait barrier2", round + 1);
+        round++;
+        phase_timer ssr_timer(phases, core_num, round, PZ3_phase_ssr);
         // check "check_result" of sub-formulas
 #ifdef PZ3_PRINT_TRACE
         pthread_mutex_lock(&err_mutex);
@@ -1045,14 +2502,23 @@ void *master_func(void *arg)
         pthread_mutex_unlock(&err_mutex);
 #endif
 
-#ifdef PZ3_PROFILING
-        conciliate_start = boost_clock::now();
-#endif
-#ifdef PZ3_FINE_GRAINED_PROF
-        master_start = boost_clock::now();
-#endif
-
+        stats.round_num++;
         bool allsat = true;
+        bool some_unknown = false;
+        for (unsigned i = 0; i < core_num; i++)
+        {
+            if (checklist.at(i) == unknown)
+                some_unknown = true;
+        }
+        if (some_unknown)
+        {
+            // a sub-problem cannot be decided, so neither can the formula
+            need_term = true;
+            return_val = 2;
+            continue;
+        }
+        ssr_timer.pause();
+        phase_timer trans_timer(phases, core_num, round, PZ3_phase_translation);
         for (unsigned i = 0; i < core_num; i++)
         {
             if (checklist.at(i) == unsat)
@@ -1063,6 +2529,8 @@ void *master_func(void *arg)
                 sv_solve.add(interpconstr);
             }
         }
+        trans_timer.stop();
+        ssr_timer.resume();
 
         if (allsat)
         {
@@ -1076,92 +2544,74 @@ void *master_func(void *arg)
                 return_val = 0;
             }
 
-            // Step 1: read model to count function instances
-            std::map<func_inst, std::vector<closure> > fist_count;
-            for(std::map<int, model>::iterator it = model_list.begin(); it != model_list.end(); ++it)
+            // Step 1: read entries of models to count function instances
+            fist_count.clear();
+            for(unsigned this_rank = 0; this_rank < core_num; this_rank++)
             {
-                int this_rank = it->first;
-                model & this_model = it->second;
-                std::map<closure, closure> & this_table = table_list.at(this_rank);
-                std::map<unsigned, func_decl> & this_fun = fun_expr.at(this_rank);
-                for(std::map<unsigned, func_decl>::iterator fun_it = this_fun.begin(); fun_it != this_fun.end(); fun_it++)
+                flat_map<closure, closure> & this_table = table_list.at(this_rank);
+                std::vector<model_entry> & this_entries = entry_list.at(this_rank);
+                unsigned entry_num = this_entries.size();
+                for(unsigned i = 0; i < entry_num; i++)
                 {
-                    unsigned fun_id = fun_it->first;
-                    func_decl fun = fun_it->second;
-                    func_interp fun_itp = this_model.get_func_interp(fun);
-                    unsigned entry_num = fun_itp.num_entries();
-                    for(unsigned i = 0; i < entry_num; i++)
+                    model_entry & this_entry = this_entries.at(i);
+                    unsigned arg_num = this_entry.args.size();
+                    // we only consider function instances whose arguments are all shared
+                    // otherwise, it is impossible to appear multiple times in different sub-problems
+                    bool all_shared = true;
+                    fist.reset(this_entry.fun_id);
+                    for(unsigned j = 0; j < arg_num; j++)
                     {
-                        func_entry this_entry = fun_itp.entry(i);
-                        unsigned arg_num = this_entry.num_args();
-                        // we only consider function instances whose arguments are all shared
-                        // otherwise, it is impossible to appear multiple times in different sub-problems
-                        bool all_shared = true;
-                        func_inst fist(fun_id, arg_num);
-                        for(unsigned j = 0; j < arg_num; j++)
+                        flat_map<closure, closure>::iterator findit = this_table.find(this_entry.args.at(j));
+                        if(findit == this_table.end())
                         {
-                            closure dom_clo;
-                            dom_clo.set(this_entry.arg(j));
-                            std::map<closure, closure>::iterator findit = this_table.find(dom_clo);
-                            if(findit == this_table.end())
-                            {
-                                // this closure is not shared
-                                all_shared = false;
-                                break;
-                            }
-                            fist.push(findit->second);
+                            // this closure is not shared
+                            all_shared = false;
+                            break;
                         }
-                        if(!all_shared)
-                            continue;
-                        // get value of this entry
-                        closure range_clo;
-                        range_clo.set(this_entry.value());
+                        fist.push(findit->second);
+                    }
+                    if(!all_shared)
+                        continue;
+                    // get value of this entry
+                    closure range_clo;
+                    range_clo.set(this_entry.value);
+                    {
+                        flat_map<closure, closure>::iterator range_it = this_table.find(range_clo);
+                        if(range_it == this_table.end())
                         {
-                            std::map<closure, closure>::iterator range_it = this_table.find(range_clo);
-                            if(range_it == this_table.end())
-                            {
-                                // if its range is not shared, set it as a special zero closure
-                                // FIXME: sort information should be ratained
-                                // FIXME: if its range is of boolean type, set it as true or false instead of zero closure
-                                if(range_clo.get_sort() == true_clo.get_sort())
-                                    range_clo.set(true_clo);
-                                else
-                                    range_clo.set_zero();
-                            }
+                            // if its range is not shared, set it as a special zero closure
+                            // FIXME: sort information should be ratained
+                            // FIXME: if its range is of boolean type, set it as true or false instead of zero closure
+                            if(range_clo.get_sort() == true_clo.get_sort())
+                                range_clo.set(true_clo);
                             else
-                                range_clo.set(range_it->second);
-                        }
-
-                        std::map<func_inst, std::vector<closure> >::iterator fist_it = fist_count.find(fist);
-                        if(fist_it == fist_count.end())
-                        {
-                            std::vector<closure> value_vec;
-                            // insert value of this function instance
-                            value_vec.push_back(range_clo);
-                            fist_count.insert(std::pair<func_inst, std::vector<closure> >(fist, value_vec));
+                                range_clo.set_zero();
                         }
                         else
-                        {
-                            (fist_it->second).push_back(range_clo);
-                        }
+                            range_clo.set(range_it->second);
                     }
+
+                    // insert value of this function instance
+                    unsigned fist_id = fist_count.insert(fist, std::vector<closure>()).first;
+                    fist_count.value(fist_id).push_back(range_clo);
                 }
             }
 
             // Step 2: extract shared function instances
             bool is_all_shared_inst = true;
-            for(std::map<func_inst, std::vector<closure> >::iterator it = fist_count.begin(); it != fist_count.end(); ++it)
+            unsigned count_num = fist_count.size();
+            for(unsigned fist_id = 0; fist_id < count_num; fist_id++)
             {
-                func_inst this_fist = it->first;
-                std::vector<closure> & clo_vec = it->second;
+                func_inst this_fist = fist_count.get(fist_id);
+                std::vector<closure> & clo_vec = fist_count.value(fist_id);
                 unsigned times = clo_vec.size();
                 if(times > 1)
                 {
                     // this instance is shared
-                    std::map<func_inst, closure>::iterator findit;
+                    unsigned found_id;
                     // congruence closure stays unchanged, so we can directly search in sfist
-                    findit = sfist.find(this_fist);
-                    if(findit == sfist.end())
+                    fist.set(this_fist);
+                    if(!sfist.find(fist, found_id))
                     {
                         // this is a new function instance
                         is_all_shared_inst = false;
@@ -1179,7 +2629,7 @@ void *master_func(void *arg)
                             most_freq = this_fist[rand_pos];
                         }
 #endif
-                        sfist.insert(std::pair<func_inst, closure>(this_fist, most_freq));                        
+                        sfist.insert(fist, most_freq);
                     }
                 }
             }
@@ -1197,7 +2647,9 @@ void *master_func(void *arg)
 #ifdef PZ3_PRINT_TRACE
             std::cout << "SOME_UNSAT" << std::endl;
 #endif
-            switch (sv_solve.check())
+            check_result sv_result = sv_solve.check();
+            note_solver(-1, core_num, round, PZ3_phase_ssr, sv_solve, &sv_totals);
+            switch (sv_result)
             {
             case sat:
             {
@@ -1221,14 +2673,14 @@ void *master_func(void *arg)
                 for(unsigned i = 0; i < num_func_decl; i++)
                 {
                     func_decl this_func = sv_model.get_func_decl(i);
-                    unsigned this_id = this_func.hash();
+                    unsigned this_id = cache.fun_id(this_func);
                     func_interp this_itp = sv_model.get_func_interp(this_func);
                     unsigned entry_num = this_itp.num_entries();
                     for(unsigned j = 0; j < entry_num; j++)
                     {
                         func_entry this_entry = this_itp.entry(j);
                         unsigned arg_num = this_entry.num_args();
-                        func_inst fist(this_id, arg_num);
+                        fist.reset(this_id);
                         for(unsigned k = 0; k < arg_num; k++)
                         {
                             closure this_clo;
@@ -1237,7 +2689,7 @@ void *master_func(void *arg)
                         }
                         closure range_clo;
                         range_clo.set(this_entry.value());
-                        sfist.insert(std::pair<func_inst, closure>(fist, range_clo));
+                        sfist.insert(fist, range_clo);
                     }
                 }
             }
@@ -1253,42 +2705,19 @@ void *master_func(void *arg)
             }
         }
 
-#ifdef PZ3_PROFILING
-        conciliate_time += boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - conciliate_start);
-#endif
-#ifdef PZ3_FINE_GRAINED_PROF
-        master_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - master_start);
-        ssr_time.fetch_add(master_time.count(), boost::memory_order_relaxed);
-#endif
-
     }
 
     return (void *) return_val;
 }
 
-void *slave_func(void *arg)
+void *Solver::slave_func(void *arg)
 {
-#ifdef PZ3_FINE_GRAINED_PROF
-    boost_clock::time_point slave_start;
-    boost::chrono::milliseconds slave_time;
-#endif
     long my_rank_l = (long) arg;
     int my_rank = (int) my_rank_l;
     std::map<unsigned, expr> &my_var = var_expr.at(my_rank);
     std::map<unsigned, func_decl> &my_fun = fun_expr.at(my_rank);
     context &my_ctx = cm.get_q_ctx(my_rank);
-
-    {
-        // create an empty model for location
-        // therefore, we don't need to reconstruct model list again and again, just by using =
-        // it reduces many unnecessary locks and accelerate the execution
-        solver empty_solve(my_ctx);
-        empty_solve.check();
-        model empty_model = empty_solve.get_model();
-        pthread_mutex_lock(&err_mutex);
-        model_list.insert(std::pair<int, model>(my_rank, empty_model));
-        pthread_mutex_unlock(&err_mutex);
-    }
+    unsigned round = 0;
 
 #ifdef PZ3_PRINT_TRACE
     pthread_mutex_lock(&err_mutex);
@@ -1306,7 +2735,7 @@ void *slave_func(void *arg)
 
     while (true)
     {
-        pthread_barrier_wait(&barrier1);
+        wait_at(barrier1, my_rank, "wait barrier1", round + 1);
         if (need_term)
             break;
 #ifdef PZ3_PRINT_TRACE
@@ -1315,14 +2744,14 @@ void *slave_func(void *arg)
         pthread_mutex_unlock(&err_mutex);
 #endif
 
-#ifdef PZ3_FINE_GRAINED_PROF
-        slave_start = boost_clock::now();
-#endif
+        round++;
         // Step 1: localization
+        phase_timer local_timer(phases, my_rank, round, PZ3_phase_localization);
         std::vector<local_func_inst> result;
         // extract non-empty closure for following works
         std::set<closure> valid_closure;
         localization(my_ctx, my_var, my_fun, result, valid_closure);
+        local_timer.stop();
 
 #ifdef PZ3_PRINT_TRACE
         pthread_mutex_lock(&err_mutex);
@@ -1331,6 +2760,7 @@ void *slave_func(void *arg)
 #endif
 
         // Step 2: make statistics for terms
+        phase_timer form_timer(phases, my_rank, round, PZ3_phase_form);
         std::map<closure, expr_vector> term_stat;
         // initialize this map
         for(std::set<closure>::iterator it = valid_closure.begin(); it != valid_closure.end(); ++it)
@@ -1451,10 +2881,7 @@ void *slave_func(void *arg)
             Z3_ast and_fs = Z3_mk_and(my_ctx, cnsts_len, _cnsts_list.ptr());
             constr_expr = to_expr(my_ctx, and_fs);
         }
-#ifdef PZ3_FINE_GRAINED_PROF
-        slave_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - slave_start);
-        formulate_time.fetch_add(slave_time.count(), boost::memory_order_relaxed);
-#endif
+        form_timer.stop();
 
         // Step 4: two contraint expressions are constructed
         // (1) expr_list.at(my_rank)
@@ -1475,56 +2902,56 @@ void *slave_func(void *arg)
         pthread_mutex_unlock(&err_mutex);
         #endif
 
-#ifdef PZ3_FINE_GRAINED_PROF
-        slave_start = boost_clock::now();
-#endif
+        if (term_stat.size() > term_max.at(my_rank))
+            term_max.at(my_rank) = term_stat.size();
+        phase_timer solve_timer(phases, my_rank, round, PZ3_phase_solve);
+        if (!workers.empty())
+        {
+            checklist.at(my_rank) = worker_check(my_rank, constr_expr, term_stat);
+            solve_timer.stop();
+            wait_at(barrier2, my_rank, "wait barrier2", round);
+            continue;
+        }
         solver solve(my_ctx);
+        // the configuration which solved this sub-formula first
+        portfolio.apply(solve, part_winner.at(my_rank), options.timeout_ms);
         solve.add(expr_list.at(my_rank));
         solve.add(constr_expr);
-        switch(solve.check())
+        check_result solve_result = solve.check();
+        solve_timer.stop();
+        note_solver(my_rank, my_rank, round, PZ3_phase_solve, solve);
+        switch(solve_result)
         {
             case unsat:
             {
-#ifdef PZ3_FINE_GRAINED_PROF
-                slave_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - slave_start);
-                solve_time.fetch_add(slave_time.count(), boost::memory_order_relaxed);
-                slave_start = boost_clock::now();
-#endif
+                // waiting for other slaves to interpolate is a part of interpolation
+                phase_timer interp_timer(phases, my_rank, round, PZ3_phase_interpolation);
                 expr proof = solve.proof();
                 array<Z3_ast> _sts(2);
                 _sts[0] = expr_list.at(my_rank);
                 _sts[1] = constr_expr;
                 Z3_ast _interp;
 
-                pthread_mutex_lock(&err_mutex);
+                pthread_mutex_lock(&interp_mutex);
                 Z3_interpolate_proof(my_ctx, proof, 2, _sts.ptr(), 0, 0, &_interp, 0, 0);
-                pthread_mutex_unlock(&err_mutex);
+                pthread_mutex_unlock(&interp_mutex);
                 
                 expr interp = to_expr(my_ctx, _interp);
                 checklist.at(my_rank) = unsat;
                 interpo_list.at(my_rank) = interp;
-#ifdef PZ3_FINE_GRAINED_PROF
-                slave_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - slave_start);
-                interp_time.fetch_add(slave_time.count(), boost::memory_order_relaxed);
-#endif
             }
             break;
             case sat:
             {
-#ifdef PZ3_FINE_GRAINED_PROF
-                slave_time = boost::chrono::duration_cast<boost::chrono::milliseconds> (boost_clock::now() - slave_start);
-                solve_time.fetch_add(slave_time.count(), boost::memory_order_relaxed);
-#endif
                 model sat_model = solve.get_model();
                 checklist.at(my_rank) = sat;
-                // Push a model to model_list
-                // It is safe to concurrently access data from different locations
-                model_list.find(my_rank)->second = sat_model;
+                // Entries of shared functions are read here, so the master does not touch the model
+                read_entries(sat_model, my_fun, entry_list.at(my_rank));
 
                 // Construct conversion table for master thread to interprete this model
                 // localized closure -> global shared closure
                 table_list.at(my_rank).clear();
-                std::map<closure, closure> & this_table = table_list.at(my_rank);
+                flat_map<closure, closure> & this_table = table_list.at(my_rank);
                 for(std::map<closure, expr_vector>::iterator it = term_stat.begin(); it != term_stat.end(); ++it)
                 {
                     closure global_clo = it->first;
@@ -1539,13 +2966,12 @@ void *slave_func(void *arg)
             break;
             default:
             {
-                // unknown: just mark it as illegal case
-                std::cerr << "Unknown reason" << std::endl;
-                exit(1);
+                // unknown: the master gives up with an unknown result
+                checklist.at(my_rank) = unknown;
             }
         }
 
-        pthread_barrier_wait(&barrier2);
+        wait_at(barrier2, my_rank, "wait barrier2", round);
     }
 
 #if 0
@@ -1579,14 +3005,12 @@ void *slave_func(void *arg)
             //std::cout << sat_model << std::endl;
             pthread_mutex_unlock(&err_mutex);
 #endif
-            // Push a model to model_list
-            // It is safe to concurrently access data from different locations
-            model_list.find(my_rank)->second = sat_model;
+            read_entries(sat_model, my_fun, entry_list.at(my_rank));
 
             // Construct conversion table for master thread to interprete this model
             // localized closure -> global shared closure
             table_list.at(my_rank).clear();
-            std::map<closure, closure> & this_table = table_list.at(my_rank);
+            flat_map<closure, closure> & this_table = table_list.at(my_rank);
             for(std::map<closure, expr_vector>::iterator it = term_stat.begin(); it != term_stat.end(); ++it)
             {
                 closure global_clo = it->first;
@@ -1611,6 +3035,196 @@ void *slave_func(void *arg)
     return NULL;
 }
 
+void Solver::start_workers()
+{
+    for (unsigned i = 0; i < core_num; i++)
+    {
+        int cpu = -1;
+#ifndef PZ3_ONECORE
+        if (options.bind_threads)
+            cpu = topology.get_slave_cpu(i);
+#endif
+        workerProcess *worker = new workerProcess;
+        if (!worker->start(options.worker_path, cpu))
+        {
+            delete worker;
+            stop_workers();
+            std::cerr << "Cannot start worker processes, partitions are solved by threads.\n";
+            return;
+        }
+        workers.push_back(worker);
+    }
+    decoders.assign(workers.size(), NULL);
+}
+
+void Solver::stop_workers()
+{
+    for (unsigned i = 0; i < workers.size(); i++)
+    {
+        workers[i]->stop();
+        delete workers[i];
+    }
+    workers.clear();
+    for (unsigned i = 0; i < decoders.size(); i++)
+        delete decoders[i];
+    decoders.clear();
+}
+
+/*
+  Result of a worker in doc: the answer to a message, with its result section read. False after
+  worker_error, with the result in result.
+*/
+static bool worker_answer(workerProcess *worker, std::string &doc, binReader &in, check_result &result,
+                          std::string &reason)
+{
+    unsigned type, value;
+    binReader section(NULL, 0);
+    if (!worker->recv(type, doc))
+        return false;
+    in = binReader(doc);
+    if (!in.get_header())
+    {
+        reason = "sent a message of another version";
+        return false;
+    }
+    if (type == PZ3_msg_error && in.find_section(PZ3_sec_error, section) && section.get(reason))
+        return false;
+    if (type != PZ3_msg_result || !in.find_section(PZ3_sec_result, section) || !section.get(value) || value > unknown)
+    {
+        reason = "sent a malformed message";
+        return false;
+    }
+    result = (check_result) value;
+    return true;
+}
+
+check_result Solver::worker_load(int my_rank)
+{
+    workerProcess *worker = workers.at(my_rank);
+    delete decoders.at(my_rank);
+    decoders.at(my_rank) = new exprDecoder(cm.get_q_ctx(my_rank));
+    decoders.at(my_rank)->know(expr_list.at(my_rank));
+    exprEncoder table;
+    unsigned root;
+    if (!table.add(expr_list.at(my_rank), root))
+        return worker_error(my_rank, "cannot be given a sub-formula beyond QF_UF");
+    binWriter doc, section;
+    doc.put_header();
+    // the configuration the in-process slave would check this sub-formula with
+    section.put(portfolio.get_line(part_winner.at(my_rank)));
+    section.put(options.timeout_ms);
+    doc.put_section(PZ3_sec_config, section);
+    section.clear();
+    table.write(section);
+    section.put(1u);
+    section.put(root);
+    doc.put_section(PZ3_sec_exprs, section);
+    if (!worker->send(PZ3_msg_load, doc.data()))
+        return worker_error(my_rank, "");
+    std::string body, reason;
+    binReader in(NULL, 0);
+    check_result result;
+    if (!worker_answer(worker, body, in, result, reason))
+        return worker_error(my_rank, reason);
+    return result;
+}
+
+/*
+  The worker gets the constraint built by slave_func and the first term of every closure in
+  term_stat. It answers the interpolant if the sub-formula is unsat with the constraint, or the
+  values of these terms and entries of shared functions in its model, so table_list and entry_list
+  are filled as slave_func does.
+*/
+check_result Solver::worker_check(int my_rank, expr &constr_expr, std::map<closure, expr_vector> &term_stat)
+{
+    workerProcess *worker = workers.at(my_rank);
+    context &my_ctx = cm.get_q_ctx(my_rank);
+    std::map<unsigned, func_decl> &my_fun = fun_expr.at(my_rank);
+    exprEncoder table;
+    std::vector<unsigned> roots;
+    unsigned root;
+    bool ok = table.add(constr_expr, root);
+    roots.push_back(root);
+    for (std::map<closure, expr_vector>::iterator it = term_stat.begin(); ok && it != term_stat.end(); ++it)
+    {
+        ok = table.add((it->second)[0], root);
+        roots.push_back(root);
+    }
+    if (!ok)
+        return worker_error(my_rank, "cannot be given a constraint beyond QF_UF");
+    binWriter doc, section;
+    doc.put_header();
+    // the configuration which solved this sub-formula first, as slave_func applies it
+    section.put(portfolio.get_line(part_winner.at(my_rank)));
+    section.put(options.timeout_ms);
+    doc.put_section(PZ3_sec_config, section);
+    section.clear();
+    table.write(section);
+    section.put((unsigned) roots.size());
+    for (unsigned i = 0; i < roots.size(); i++)
+        section.put(roots[i]);
+    doc.put_section(PZ3_sec_exprs, section);
+    section.clear();
+    section.put((unsigned) my_fun.size());
+    for (std::map<unsigned, func_decl>::iterator it = my_fun.begin(); it != my_fun.end(); ++it)
+    {
+        section.put(it->first);
+        section.put(symbolTable::symbol_key(it->second));
+    }
+    doc.put_section(PZ3_sec_shared_funcs, section);
+    if (!worker->send(PZ3_msg_check, doc.data()))
+        return worker_error(my_rank, "");
+    std::string body, reason;
+    binReader in(NULL, 0), answer(NULL, 0);
+    check_result result;
+    if (!worker_answer(worker, body, in, result, reason))
+        return worker_error(my_rank, reason);
+    if (result == unsat)
+    {
+        exprDecoder *interp_table = decoders.at(my_rank);
+        expr interp(my_ctx);
+        unsigned interp_num;
+        if (!in.find_section(PZ3_sec_interpolants, answer) || !interp_table->read(answer) ||
+            !answer.get(interp_num) || interp_num != 1 || !interp_table->get(answer, interp))
+            return worker_error(my_rank, "sent an interpolant which cannot be read");
+        interpo_list.at(my_rank) = interp;
+    }
+    else if (result == sat)
+    {
+        closure_list values;
+        if (!in.find_section(PZ3_sec_svexpr, answer) || !answer.get(values) || values.size() != term_stat.size())
+            return worker_error(my_rank, "sent a malformed message");
+        flat_map<closure, closure> &this_table = table_list.at(my_rank);
+        this_table.clear();
+        unsigned i = 0;
+        for (std::map<closure, expr_vector>::iterator it = term_stat.begin(); it != term_stat.end(); ++it, i++)
+        {
+            if (values[i].first != i)
+                return worker_error(my_rank, "sent a malformed message");
+            this_table.insert(std::pair<closure, closure>(values[i].second, it->first));
+        }
+        std::vector<model_entry> &entries = entry_list.at(my_rank);
+        entries.clear();
+        if (!in.find_section(PZ3_sec_sfist, answer) || !answer.get(entries))
+            return worker_error(my_rank, "sent a malformed message");
+    }
+    return result;
+}
+
+check_result Solver::worker_error(int my_rank, std::string const &reason)
+{
+    // workers of other partitions are cut off once the formula is unsat
+    if (early_unsat)
+        return unknown;
+    std::string message = reason.empty() ? workers.at(my_rank)->failure() : reason;
+    if (message.empty())
+        return unknown;
+    pthread_mutex_lock(&err_mutex);
+    std::cerr << "Worker of partition " << my_rank << " " << message << ", its result is unknown.\n";
+    pthread_mutex_unlock(&err_mutex);
+    return unknown;
+}
+
 Z3_lbool PZ3_interpolate(context &c, expr fs1, expr fs2, expr &interp, Z3_model *md)
 {
     expr pattern = expr(c, Z3_mk_interpolant(c, fs1));
@@ -1633,41 +3247,64 @@ func_decl PZ3_translate_func_decl(context &source_c, func_decl fd, context &targ
     return func_decl(target_c, _fd);
 }
 
-void localization(context & c, std::map<unsigned, expr> & my_var, std::map<unsigned, func_decl> & my_fun, std::vector<local_func_inst> & result, std::set<closure> & valid_closure)
+void read_entries(model &m, std::map<unsigned, func_decl> &funs, std::vector<model_entry> &entries)
+{
+    entries.clear();
+    for (std::map<unsigned, func_decl>::iterator it = funs.begin(); it != funs.end(); ++it)
+    {
+        func_interp fun_itp = m.get_func_interp(it->second);
+        unsigned entry_num = fun_itp.num_entries();
+        for (unsigned i = 0; i < entry_num; i++)
+        {
+            func_entry this_entry = fun_itp.entry(i);
+            unsigned arg_num = this_entry.num_args();
+            model_entry entry;
+            entry.fun_id = it->first;
+            entry.args.resize(arg_num);
+            for (unsigned j = 0; j < arg_num; j++)
+                entry.args[j].set(this_entry.arg(j));
+            entry.value.set(this_entry.value());
+            entries.push_back(entry);
+        }
+    }
+}
+
+void Solver::localization(context & c, std::map<unsigned, expr> & my_var, std::map<unsigned, func_decl> & my_fun, std::vector<local_func_inst> & result, std::set<closure> & valid_closure)
 {
     eqclass * eq_list;
     mutate_func_inst * fist_list; // linked list
     
     // Step 1: count equivalence classes
-    std::map<closure, unsigned> closure_set;
+    flat_map<closure, unsigned> closure_set;
     unsigned idx = 0;
-    for(std::map<unsigned, closure>::iterator it = svexpr.begin(); it != svexpr.end(); ++it)
+    for(flat_map<unsigned, closure>::iterator it = svexpr.begin(); it != svexpr.end(); ++it)
     {
         closure var_clo = it->second;
-        std::pair<std::map<closure, unsigned>::iterator, bool> ret;
+        std::pair<flat_map<closure, unsigned>::iterator, bool> ret;
         ret = closure_set.insert(std::pair<closure, unsigned>(var_clo, idx));
         if(ret.second == true) idx++;
     }
-    for(std::map<func_inst, closure>::iterator it = sfist.begin(); it != sfist.end(); ++it)
+    unsigned sfist_num = sfist.size();
+    for(unsigned fist_id = 0; fist_id < sfist_num; fist_id++)
     {
-        func_inst this_fist = it->first;
-        closure this_range = it->second;
+        func_inst this_fist = sfist.get(fist_id);
+        closure this_range = sfist.value(fist_id);
         unsigned dom_len = this_fist.get_domain_length();
         for(unsigned i = 0; i < dom_len; i++)
         {
             closure dom_clo = this_fist[i];
-            std::pair<std::map<closure, unsigned>::iterator, bool> ret;
+            std::pair<flat_map<closure, unsigned>::iterator, bool> ret;
             ret = closure_set.insert(std::pair<closure, unsigned>(dom_clo, idx));
             if(ret.second == true) idx++;
         }
-        std::pair<std::map<closure, unsigned>::iterator, bool> ret;
+        std::pair<flat_map<closure, unsigned>::iterator, bool> ret;
         ret = closure_set.insert(std::pair<closure, unsigned>(this_range, idx));
         if(ret.second == true) idx++;
     }
     unsigned eq_list_len = closure_set.size();
     assert(eq_list_len == idx);
     eq_list = new eqclass[eq_list_len];
-    for(std::map<closure, unsigned>::iterator it = closure_set.begin(); it != closure_set.end(); ++it)
+    for(flat_map<closure, unsigned>::iterator it = closure_set.begin(); it != closure_set.end(); ++it)
     {
         closure this_clo = it->first;
         unsigned index = it->second;
@@ -1684,10 +3321,10 @@ void localization(context & c, std::map<unsigned, expr> & my_var, std::map<unsig
     mutate_func_inst *ptr = fist_list;
     //unsigned counter = 0;
     mutate_func_inst *prv = NULL;
-    for(std::map<func_inst, closure>::iterator it = sfist.begin(); it != sfist.end(); ++it)
+    for(unsigned fist_id = 0; fist_id < sfist_num; fist_id++)
     {
-        func_inst this_fist = it->first;
-        closure this_range = it->second;
+        func_inst this_fist = sfist.get(fist_id);
+        closure this_range = sfist.value(fist_id);
         unsigned func_id = this_fist.get_func();
         if(my_fun.find(func_id) == my_fun.end())
         {
@@ -1741,7 +3378,7 @@ void localization(context & c, std::map<unsigned, expr> & my_var, std::map<unsig
         unsigned var_id = it->first;
         expr ex = it->second;
         closure var_clo = svexpr[var_id];
-        std::map<closure, unsigned>::iterator findit = closure_set.find(var_clo);
+        flat_map<closure, unsigned>::iterator findit = closure_set.find(var_clo);
         unsigned index = (closure_set.find(var_clo))->second;
         // FIXME: if there are 2 variables in one closure, then set_expr() is invoked twice
         // although the second set_expr() fails, it still decreases counter
@@ -1759,7 +3396,7 @@ void localization(context & c, std::map<unsigned, expr> & my_var, std::map<unsig
 
     // FIXME: not all the shared variables!
 #if 0
-    for(std::map<unsigned, closure>::iterator it = svexpr.begin(); it != svexpr.end(); ++it)
+    for(flat_map<unsigned, closure>::iterator it = svexpr.begin(); it != svexpr.end(); ++it)
     {
         unsigned var_id = it->first;
         closure var_clo = it->second;
@@ -7,6 +7,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <boost/atomic.hpp>
@@ -14,7 +15,6 @@
 #include <boost/chrono.hpp>
 
 //#define PZ3_PRINT_TRACE
-//#define PZ3_DIST
 //#define PZ3_WEIRD_BUG_1
 
 #define PZ3_MASTER_THREAD 0
@@ -38,18 +38,15 @@ typedef enum
     PZ3_file_corrupt
 } PZ3_File_Result;
 
-typedef enum
-{
-    PZ3_smt1,
-    PZ3_smt2,
-    PZ3_smt_unknown
-} PZ3_File_Type;
-
 class closure;
-class func_inst;
 class eqclass;
 class mutate_func_inst;
 class local_func_inst;
+class symbol_cache;
+class solverPortfolio;
+
+// symbol_list: sorted list of dense symbol ids (see symbolTable.hpp)
+typedef std::vector<unsigned> symbol_list;
 
 // closure brings information of sort
 class closure
@@ -97,6 +94,10 @@ public:
     		return true;
     	return false;
     }
+    unsigned hash() const
+    {
+        return sortid * 0x9e3779b1u ^ value;
+    }
 
     friend bool operator<(const closure &lhs, const closure &rhs)
     {
@@ -133,109 +134,6 @@ public:
     }
 };
 
-// FIXME: reference counter is not thread-safe
-// data race in reference counter causes problems in localization function
-class func_inst
-{
-protected:
-    unsigned func;
-    unsigned domain_len;
-    boost::shared_ptr<closure[]> domain;
-    unsigned local_ptr;
-
-public:
-    func_inst(unsigned fun_id, unsigned dom_len)
-    {
-        func = fun_id;
-        domain_len = dom_len;
-        domain = boost::shared_ptr<closure[]>(new closure[domain_len]);
-        local_ptr = 0;
-    }
-    bool push(closure clo)
-    {
-        if (local_ptr < domain_len)
-        {
-            domain[local_ptr].set(clo);
-            local_ptr++;
-            return true;
-        }
-        else
-        {
-            return false;
-        }
-    }
-
-    unsigned get_func()
-    {
-        return func;
-    }
-    closure operator[](unsigned i)
-    {
-        if (i < domain_len)
-        {
-            return domain[i];
-        }
-        // unexpected case below
-        closure zero_clo;
-        return zero_clo;
-    }
-    unsigned get_domain_length()
-    {
-        return domain_len;
-    }
-
-    friend bool operator<(const func_inst &lhs, const func_inst &rhs)
-    {
-        if (lhs.func < rhs.func) return true;
-        if (lhs.func > rhs.func) return false;
-        for (unsigned i = 0; i < lhs.domain_len; ++i)
-        {
-            if (lhs.domain[i] < rhs.domain[i]) return true;
-            if (lhs.domain[i] > rhs.domain[i]) return false;
-        }
-        return false; // If they are all the same
-    }
-
-    friend bool operator==(const func_inst &lhs, const func_inst &rhs)
-    {
-        if (lhs.func == rhs.func)
-        {
-            for (unsigned i = 0; i < lhs.domain_len; i++)
-            {
-                if (lhs.domain[i] != rhs.domain[i])
-                    return false;
-            }
-            return true;
-        }
-        else
-        {
-            return false;
-        }
-    }
-
-    friend bool operator>(const func_inst &lhs, const func_inst &rhs)
-    {
-        if (lhs < rhs || lhs == rhs)
-            return false;
-        return true;
-    }
-
-    friend std::ostream &operator<<(std::ostream &out, const func_inst &rhs)
-    {
-        out << rhs.func << "(";
-        for (unsigned i = 0; i < rhs.domain_len - 1; i++)
-        {
-            out << rhs.domain[i] << ",";
-        }
-        if (rhs.domain_len > 0)
-        {
-            out << rhs.domain[rhs.domain_len - 1];
-        }
-        out << ")";
-        return out;
-    }
-};
-
 class eqclass
 {
 protected:
@@ -603,59 +501,35 @@ public:
 	}
 };
 
+// model_entry: an entry in the interpretation of a shared function in a model of a sub-problem,
+// as closures of its arguments and its value
+struct model_entry
+{
+    unsigned fun_id;
+    std::vector<closure> args;
+    closure value;
+};
+
 /* Print proper usage of program */
 void usage(char const *prog_name);
 
 /* Get parameters from command prompt */
-void get_args(char *const argv[]);
-
-/* Check the satisfiability of a benchmark file */
-PZ3_Result solve_file();
-
-/* Problem division */
-void *division(void *rank);
+void get_args(int argc, char *const argv[]);
 
-/* Parse smtlib file */
-PZ3_File_Result parse_file(context &ctx, expr &fs);
+/* Check the satisfiability of a benchmark file with sequential Z3, in the first configuration of a portfolio */
+PZ3_Result solve_sequential(context &c, std::string const &path, solverPortfolio &portfolio, unsigned timeout_ms);
 
-/* Check file type for following process */
-PZ3_File_Type check_filetype();
-
-/* Convert parsed formula into CNF */
-void fs_to_cnf(int const my_rank, expr &fs, expr_vector &list);
-
-/* Solve sub-problems in parallel */
-void *subsolve(void *rank);
+/* Find the representative of a symbol in union-find */
+unsigned find_root(std::vector<unsigned> &parent, unsigned id);
 
 /* Output the variable list of a formula */
-void get_vars(expr fs, std::map<unsigned, int> &vl, std::map<unsigned, int> &fl);
-
-/* Merge two variable maps together */
-void map_merge(std::map<unsigned, int> &result, std::map<unsigned, int> input);
-
-/* Merge variable maps of clauses in the same core */
-void vars_merge();
-
-/* Merge function maps of clauses in the same core */
-void funcs_merge();
-
-/* Collect shared variables from different contexts(cores) */
-void shared_collect();
-
-/* Extract expression objects of shared variables on parallel */
-void *extract_vars(void *arg);
+void get_vars(symbol_cache &cache, expr fs, symbol_list &vl, symbol_list &fl);
 
 /* Extract variable expressions in specified list from a specified formula */
-void assoc_vars(expr in_fs, std::set<unsigned> &vars, std::map<unsigned, expr> &var_map);
+void assoc_vars(symbol_cache &cache, expr in_fs, std::set<unsigned> &vars, std::map<unsigned, expr> &var_map);
 
 /* Extract function declarations in specified list from a specified formula */
-void assoc_funs(expr in_fs, std::set<unsigned> &funs, std::map<unsigned, func_decl> &fun_map);
-
-/* Function for master thread -- calculating the model for shared variables */
-void *master_func(void *arg);
-
-/* Function for slave thread -- calculating interpolation for sub-formulas */
-void *slave_func(void *arg);
+void assoc_funs(symbol_cache &cache, expr in_fs, std::set<unsigned> &funs, std::map<unsigned, func_decl> &fun_map);
 
 /* Function for interpolation between 2 constraints */
 Z3_lbool PZ3_interpolate(context &c, expr fs1, expr fs2, expr &interp, Z3_model *md);
@@ -663,8 +537,8 @@ Z3_lbool PZ3_interpolate(context &c, expr fs1, expr fs2, expr &interp, Z3_model
 /* Translate an object of function declaration into other context */
 func_decl PZ3_translate_func_decl(context &source_c, func_decl fd, context &target_c);
 
-/* Localize terms for a sub-problem based on global shared terms */
-void localization(context & c, std::map<unsigned, expr> & my_var, std::map<unsigned, func_decl> & my_fun, std::vector<local_func_inst> & result, std::set<closure> & valid_closure);
+/* Read entries of interpretations of shared functions from a model of a sub-problem */
+void read_entries(model &m, std::map<unsigned, func_decl> &funs, std::vector<model_entry> &entries);
 
 /* Choose a default closure for new function instance by voting method */
 closure get_most_freq(std::vector<closure> & vec);
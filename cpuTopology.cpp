@@ -0,0 +1,239 @@
+#include "cpuTopology.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <cstdlib>
+#include <unistd.h>
+
+#define PZ3_SYSFS_CPU "/sys/devices/system/cpu/cpu"
+#define PZ3_SYSFS_NODE "/sys/devices/system/node/"
+
+// cpu_users: threads placed on every CPU by all cpuTopology objects of the process
+static std::map<int, unsigned> cpu_users;
+static pthread_mutex_t cpu_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// order of placement: physical cores first, then nodes one by one
+struct cpu_order
+{
+    bool operator()(cpu_info const &a, cpu_info const &b) const
+    {
+        if (a.sibling != b.sibling)
+            return a.sibling < b.sibling;
+        if (a.node != b.node)
+            return a.node < b.node;
+        if (a.package != b.package)
+            return a.package < b.package;
+        if (a.core != b.core)
+            return a.core < b.core;
+        return a.cpu < b.cpu;
+    }
+};
+
+cpuTopology::cpuTopology()
+{
+    master_cpu = -1;
+    master_alone = false;
+}
+
+cpuTopology::~cpuTopology()
+{
+    release();
+}
+
+unsigned cpuTopology::take_cpu(int node, unsigned &users)
+{
+    unsigned best = 0;
+    for (unsigned j = 1; j < cpus.size(); j++)
+    {
+        unsigned load = cpu_users[cpus[j].cpu], best_load = cpu_users[cpus[best].cpu];
+        if (load < best_load || (load == best_load && node >= 0 && cpus[j].node == node && cpus[best].node != node))
+            best = j;
+    }
+    users = cpu_users[cpus[best].cpu]++;
+    held.push_back(cpus[best].cpu);
+    return best;
+}
+
+void cpuTopology::release()
+{
+    pthread_mutex_lock(&cpu_mutex);
+    for (unsigned i = 0; i < held.size(); i++)
+    {
+        cpu_users[held[i]]--;
+    }
+    pthread_mutex_unlock(&cpu_mutex);
+    held.clear();
+}
+
+bool cpuTopology::read_int(std::string const &path, int &value)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+        return false;
+    file >> value;
+    return !file.fail();
+}
+
+// parse a list such as "0-3,8,10-11"
+bool cpuTopology::read_cpulist(std::string const &path, std::vector<int> &list)
+{
+    std::ifstream file(path.c_str());
+    std::string text;
+    if (!file || !(file >> text))
+        return false;
+    std::stringstream in(text);
+    std::string range;
+    while (std::getline(in, range, ','))
+    {
+        int first = 0, last = 0;
+        std::string::size_type dash = range.find('-');
+        first = atoi(range.substr(0, dash).c_str());
+        last = (dash == std::string::npos) ? first : atoi(range.substr(dash + 1).c_str());
+        for (int c = first; c <= last; c++)
+            list.push_back(c);
+    }
+    return true;
+}
+
+void cpuTopology::detect()
+{
+    cpus.clear();
+    std::vector<int> allowed;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &mask) == 0)
+    {
+        for (int c = 0; c < CPU_SETSIZE; c++)
+        {
+            if (CPU_ISSET(c, &mask))
+                allowed.push_back(c);
+        }
+    }
+    if (allowed.empty())
+    {
+        long num = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int c = 0; c < num; c++)
+            allowed.push_back(c);
+    }
+
+    // NUMA node of every CPU; without sysfs everything is on node 0
+    std::vector<int> node_of(CPU_SETSIZE, 0);
+    std::vector<int> nodes;
+    if (read_cpulist(PZ3_SYSFS_NODE "online", nodes))
+    {
+        for (unsigned i = 0; i < nodes.size(); i++)
+        {
+            std::ostringstream path;
+            path << PZ3_SYSFS_NODE "node" << nodes[i] << "/cpulist";
+            std::vector<int> node_cpus;
+            read_cpulist(path.str(), node_cpus);
+            for (unsigned j = 0; j < node_cpus.size(); j++)
+            {
+                if (node_cpus[j] >= 0 && node_cpus[j] < CPU_SETSIZE)
+                    node_of[node_cpus[j]] = nodes[i];
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < allowed.size(); i++)
+    {
+        cpu_info info;
+        info.cpu = allowed[i];
+        info.node = node_of[info.cpu];
+        std::ostringstream path;
+        path << PZ3_SYSFS_CPU << info.cpu << "/topology/";
+        if (!read_int(path.str() + "physical_package_id", info.package))
+            info.package = 0;
+        if (!read_int(path.str() + "core_id", info.core))
+            info.core = info.cpu;
+        // hardware threads of the same physical core seen before this one
+        info.sibling = 0;
+        for (unsigned j = 0; j < cpus.size(); j++)
+        {
+            if (cpus[j].package == info.package && cpus[j].core == info.core)
+                info.sibling++;
+        }
+        cpus.push_back(info);
+    }
+    std::sort(cpus.begin(), cpus.end(), cpu_order());
+}
+
+void cpuTopology::place(unsigned slave_num)
+{
+    release();
+    if (cpus.empty())
+        return;
+    pthread_mutex_lock(&cpu_mutex);
+    slave_cpu.assign(slave_num, 0);
+    unsigned users;
+    int first_node = -1;
+    for (unsigned i = 0; i < slave_num; i++)
+    {
+        // more partitions than free CPUs: the ones used least are shared
+        unsigned pos = take_cpu(-1, users);
+        slave_cpu[i] = cpus[pos].cpu;
+        if (i == 0)
+            first_node = cpus[pos].node;
+    }
+    // the master gets a CPU of its own if one is left, preferably on the node of partition 0
+    unsigned pos = take_cpu(first_node, users);
+    master_alone = (users == 0);
+    if (master_alone)
+        master_cpu = cpus[pos].cpu;
+    else
+    {
+        cpu_users[held.back()]--;
+        held.pop_back();
+        master_cpu = slave_num > 0 ? slave_cpu[0] : cpus[pos].cpu;
+    }
+    pthread_mutex_unlock(&cpu_mutex);
+}
+
+int cpuTopology::get_slave_cpu(int rank)
+{
+    // no CPU before place(), and for ranks beyond its partitions
+    if (rank < 0 || (unsigned) rank >= slave_cpu.size())
+        return -1;
+    return slave_cpu[rank];
+}
+
+int cpuTopology::get_master_cpu()
+{
+    return master_cpu;
+}
+
+void cpuTopology::bind(pthread_attr_t *attr, int cpu)
+{
+    if (cpu < 0)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &set);
+}
+
+void cpuTopology::report(std::ostream &out)
+{
+    std::vector<int> node_list;
+    std::vector<int> cpu_node(CPU_SETSIZE, 0);
+    for (unsigned j = 0; j < cpus.size(); j++)
+    {
+        node_list.push_back(cpus[j].node);
+        cpu_node[cpus[j].cpu] = cpus[j].node;
+    }
+    std::sort(node_list.begin(), node_list.end());
+    node_list.erase(std::unique(node_list.begin(), node_list.end()), node_list.end());
+
+    out << "Placement: " << cpus.size() << " CPUs allowed on " << node_list.size() << " NUMA node(s)" << std::endl;
+    for (unsigned i = 0; i < slave_cpu.size(); i++)
+    {
+        out << "  partition " << i << ": cpu " << slave_cpu[i] << " (node " << cpu_node[slave_cpu[i]] << ")" << std::endl;
+    }
+    if (master_cpu < 0)
+        return;
+    out << "  master: cpu " << master_cpu << " (node " << cpu_node[master_cpu] << ")";
+    if (!master_alone)
+        out << ", shared with partition 0";
+    out << std::endl;
+}
@@ -0,0 +1,65 @@
+#ifndef _CPU_TOPOLOGY_H_
+#define _CPU_TOPOLOGY_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+// cpu_info: position of a logical CPU in the machine, read from sysfs
+struct cpu_info
+{
+    int cpu;
+    int node;
+    int package;
+    int core;
+    // 0 for the first hardware thread of a physical core, 1 for its sibling, ...
+    int sibling;
+};
+
+/*
+  cpuTopology: placement of threads on CPUs
+  Only CPUs in the affinity mask of the process (taskset, cgroups) are used. They are ordered so that
+  every physical core is used once before hyper-thread siblings, and NUMA nodes are filled one by one.
+  All threads working on partition i (division, subsolve, slave) run on the same CPU, so the context
+  of the partition is allocated on the node of that CPU by first touch.
+  CPUs are handed out by one allocator for the whole process, so solvers running at once get CPUs no
+  other solver uses while there are some left, and then the ones used least. A placement holds its
+  CPUs until the next place() or the destruction of the object.
+*/
+class cpuTopology
+{
+protected:
+    // allowed CPUs in placement order
+    std::vector<cpu_info> cpus;
+    std::vector<int> slave_cpu;
+    int master_cpu;
+    bool master_alone;
+    // CPUs held in the allocator of the process, once for every thread placed on them
+    std::vector<int> held;
+
+    static bool read_int(std::string const &path, int &value);
+    static bool read_cpulist(std::string const &path, std::vector<int> &list);
+    /* Position in cpus of the CPU used least by the process, the first one in placement order among
+       equals, preferring node if it is not negative; held for this object */
+    unsigned take_cpu(int node, unsigned &users);
+    /* Give the CPUs of the last placement back to the allocator */
+    void release();
+
+public:
+    cpuTopology();
+    ~cpuTopology();
+    /* Read allowed CPUs and the topology of the machine */
+    void detect();
+    /* Choose CPUs for slave_num partitions and the master thread */
+    void place(unsigned slave_num);
+    /* CPU of a partition or the master thread, -1 if none was placed */
+    int get_slave_cpu(int rank);
+    int get_master_cpu();
+    /* Bind threads created with attr to a CPU, unless it is -1 */
+    void bind(pthread_attr_t *attr, int cpu);
+    void report(std::ostream &out);
+};
+
+#endif
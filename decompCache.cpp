@@ -0,0 +1,194 @@
+#include "decompCache.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#define PZ3_CACHE_EXT ".pz3c"
+
+// FNV-1a, 64 bits
+static unsigned long long fnv_add(unsigned long long h, char const *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static unsigned long long fnv_hash(std::string const &data)
+{
+    return fnv_add(14695981039346656037ull, data.data(), data.size());
+}
+
+static std::string make_key(unsigned long long hash, unsigned long long size, std::string const &params)
+{
+    std::ostringstream out;
+    out << std::hex << hash << std::dec << "-" << size << "-" << params;
+    return out.str();
+}
+
+// an entry found in the directory
+struct cache_entry
+{
+    std::string path;
+    unsigned long long size;
+    time_t used;
+
+    bool operator<(cache_entry const &other) const
+    {
+        return used < other.used;
+    }
+};
+
+decompCache::decompCache()
+{
+    max_bytes = (unsigned long long) PZ3_CACHE_DEFAULT_MB << 20;
+    lookups = 0;
+    hits = 0;
+    stores = 0;
+    evictions = 0;
+    drops = 0;
+}
+
+void decompCache::set_dir(std::string const &path, unsigned max_mb)
+{
+    dir = path;
+    max_bytes = (unsigned long long) max_mb << 20;
+    if (!dir.empty())
+        mkdir(dir.c_str(), 0755);
+}
+
+bool decompCache::enabled()
+{
+    return !dir.empty();
+}
+
+std::string decompCache::key(char const *data, size_t len, std::string const &params)
+{
+    return make_key(fnv_add(14695981039346656037ull, data, len), len, params);
+}
+
+std::string decompCache::entry_path(std::string const &key)
+{
+    std::ostringstream out;
+    out << dir << "/" << std::hex << fnv_hash(key) << PZ3_CACHE_EXT;
+    return out.str();
+}
+
+bool decompCache::load(std::string const &key, std::string &body)
+{
+    lookups++;
+    std::string path = entry_path(key);
+    std::ifstream file(path.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!file)
+        return false;
+    std::stringstream buf;
+    buf << file.rdbuf();
+    std::string doc = buf.str();
+
+    binReader in(doc);
+    binReader section(NULL, 0);
+    unsigned tag, checksum_low, checksum_high;
+    std::string entry_key;
+    if (!in.get_header() || !in.get_section(tag, section) || tag != PZ3_sec_key)
+        return false;
+    if (!section.get(entry_key) || !section.get(checksum_low) || !section.get(checksum_high) || entry_key != key)
+        return false;
+    body.assign(doc, doc.size() - in.remaining(), std::string::npos);
+    unsigned long long checksum = fnv_hash(body);
+    if ((unsigned) checksum != checksum_low || (unsigned) (checksum >> 32) != checksum_high)
+        return false;
+    // used now, so it is the last one to be evicted
+    utime(path.c_str(), NULL);
+    hits++;
+    return true;
+}
+
+void decompCache::store(std::string const &key, std::string const &body)
+{
+    binWriter out;
+    binWriter section;
+    unsigned long long checksum = fnv_hash(body);
+    section.put(key);
+    section.put((unsigned) checksum);
+    section.put((unsigned) (checksum >> 32));
+    out.put_header();
+    out.put_section(PZ3_sec_key, section);
+    unsigned long long size = out.data().size() + body.size();
+    if (size > max_bytes)
+        return;
+    make_room(size);
+
+    std::string path = entry_path(key);
+    std::ostringstream tmp;
+    tmp << path << ".tmp" << getpid();
+    std::ofstream file(tmp.str().c_str(), std::ofstream::out | std::ofstream::binary);
+    file << out.data() << body;
+    file.close();
+    if (!file || rename(tmp.str().c_str(), path.c_str()) != 0)
+    {
+        unlink(tmp.str().c_str());
+        return;
+    }
+    stores++;
+}
+
+void decompCache::drop(std::string const &key)
+{
+    unlink(entry_path(key).c_str());
+    hits--;
+    drops++;
+}
+
+void decompCache::make_room(unsigned long long incoming)
+{
+    DIR *d = opendir(dir.c_str());
+    if (d == NULL)
+        return;
+    std::vector<cache_entry> entries;
+    unsigned long long total = 0;
+    std::string ext(PZ3_CACHE_EXT);
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        std::string name(ent->d_name);
+        if (name.size() <= ext.size() || name.compare(name.size() - ext.size(), ext.size(), ext) != 0)
+            continue;
+        cache_entry e;
+        e.path = dir + "/" + name;
+        struct stat st;
+        if (stat(e.path.c_str(), &st) != 0)
+            continue;
+        e.size = st.st_size;
+        e.used = st.st_mtime;
+        total += e.size;
+        entries.push_back(e);
+    }
+    closedir(d);
+    if (total + incoming <= max_bytes)
+        return;
+    std::sort(entries.begin(), entries.end());
+    for (unsigned i = 0; i < entries.size() && total + incoming > max_bytes; i++)
+    {
+        if (unlink(entries[i].path.c_str()) == 0)
+            evictions++;
+        total -= entries[i].size;
+    }
+}
+
+void decompCache::report(std::ostream &out)
+{
+    if (lookups == 0)
+        return;
+    out << "Decomposition cache: " << hits << " hits, " << lookups - hits << " misses, " << stores << " stored, "
+        << evictions << " evicted";
+    if (drops > 0)
+        out << ", " << drops << " unusable";
+    out << std::endl;
+}
@@ -0,0 +1,56 @@
+#ifndef _DECOMP_CACHE_H_
+#define _DECOMP_CACHE_H_
+
+#include "exprCodec.hpp"
+#include <string>
+#include <iostream>
+
+// default limit of the total size of a cache directory
+#define PZ3_CACHE_DEFAULT_MB 256
+
+/*
+  decompCache: decompositions of inputs solved before, kept as files in a directory so following runs
+  on the same input skip parsing, CNF conversion and distribution. An entry is named by the hash of
+  its key, which is made of the content of the input and the options the distribution depends on.
+  An entry is a document of the binary format (see exprCodec.hpp):
+      header, PZ3_sec_key (key, checksum of the rest), sections of the decomposition
+  so a reader takes an entry only if its key is the one asked for and it was written completely.
+  Entries are written to a temporary file and renamed, so processes can share a directory. When the
+  total size is beyond the limit, entries used least recently are removed.
+*/
+class decompCache
+{
+protected:
+    std::string dir;
+    unsigned long long max_bytes;
+    // lookups: entries asked for, hits: entries found, stores: entries written,
+    // evictions: entries removed for room, drops: entries found but unusable
+    unsigned lookups;
+    unsigned hits;
+    unsigned stores;
+    unsigned evictions;
+    unsigned drops;
+
+    std::string entry_path(std::string const &key);
+    /* Remove entries used least recently until incoming bytes fit */
+    void make_room(unsigned long long incoming);
+
+public:
+    decompCache();
+    /* Keep entries in dir, up to max_mb megabytes; an empty dir turns the cache off */
+    void set_dir(std::string const &path, unsigned max_mb);
+    bool enabled();
+
+    /* Key of an input text, with options the decomposition depends on */
+    static std::string key(char const *data, size_t len, std::string const &params);
+
+    /* Body of the entry of key, false if there is none */
+    bool load(std::string const &key, std::string &body);
+    /* Write the entry of key */
+    void store(std::string const &key, std::string const &body);
+    /* Remove an entry found by load which turned out to be unusable */
+    void drop(std::string const &key);
+    void report(std::ostream &out);
+};
+
+#endif
@@ -1,3 +1,4 @@
 include ../config.mk
 
+# distribution method: heur1 (poset heuristic), seq (sequential) or stream (one-pass streaming)
 DIST_METHOD=heur1
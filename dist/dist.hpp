@@ -6,62 +6,67 @@
 class simple_node;
 class node;
 
-void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned> > &symbol_sub, std::vector<int> &clause_weight);
+// symbol ids are dense in [0, symbol_num); every element of symbol_sub is a sorted list of ids
+// dist receives the partition in [0, part_num) of every clause
+void dist_clause(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist);
+
+// the first dist.size() clauses keep their partitions, and partitions of the rest are appended to dist
+void dist_extend(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist);
+
+// name of the method, so cached distributions of one method are not taken by another
+extern char const dist_name[];
+
+// symbol membership is stored as a bitset of 64-bit words
+typedef unsigned long long bit_word;
+#define PZ3_WORD_BITS 64
 
 class simple_node
 {
 protected:
-	boost::shared_ptr<std::vector<bool> > symbol_status;
+	boost::shared_ptr<std::vector<bit_word> > symbol_status;
+	unsigned symbol_len;
 	unsigned symbol_num;
+	// hash of the bitset is cached, it is reset when a bit is pushed
+	mutable unsigned hash_value;
+	mutable bool hash_valid;
+
+	static unsigned word_num(unsigned len)
+	{
+		return (len + PZ3_WORD_BITS - 1) / PZ3_WORD_BITS;
+	}
 
 public:
 	simple_node()
 	{
-		symbol_status = boost::shared_ptr<std::vector<bool> >(new std::vector<bool>);
+		symbol_status = boost::shared_ptr<std::vector<bit_word> >(new std::vector<bit_word>);
+		symbol_len = 0;
 		symbol_num = 0;
+		hash_value = 0;
+		hash_valid = false;
 	}
 
-	void set_symbol(std::set<unsigned> & total_set, std::set<unsigned> & sub_set)
+	void set_symbol(unsigned total_num, symbol_list & sub_set)
 	{
-		std::set<unsigned>::iterator it1 = total_set.begin();
-		std::set<unsigned>::iterator it1_end = total_set.end();
-		std::set<unsigned>::iterator it2 = sub_set.begin();
-		std::set<unsigned>::iterator it2_end = sub_set.end();
-
-		while(it2 != it2_end)
+		symbol_status->assign(word_num(total_num), 0);
+		symbol_len = total_num;
+		unsigned sub_len = sub_set.size();
+		for(unsigned i = 0; i < sub_len; i++)
 		{
-			if(*it1 == *it2)
-			{
-				symbol_status->push_back(true);
-				symbol_num++;
-				it1++;
-				it2++;
-			}
-			else if(*it1 < *it2)
-			{
-				symbol_status->push_back(false);
-				it1++;
-			}
-			else
+			if(sub_set[i] >= total_num)
 			{
 				std::cerr << "illegal case" << std::endl;
-				std::cerr << "it1: " << *it1 << ";" << "it2: " << *it2 << std::endl;
+				std::cerr << "symbol: " << sub_set[i] << ";" << "total: " << total_num << std::endl;
 				exit(1);
 			}
+			(*symbol_status)[sub_set[i] / PZ3_WORD_BITS] |= (bit_word)1 << (sub_set[i] % PZ3_WORD_BITS);
 		}
-		// fill 'false' in remaining positions
-		while(it1 != it1_end)
-		{
-			symbol_status->push_back(false);
-			it1++;
-		}
-
-		assert(symbol_status->size() == total_set.size());
+		symbol_num = sub_len;
+		hash_valid = false;
 	}
 
 	unsigned symbol_size()
 	{
-		return symbol_status->size();
+		return symbol_len;
 	}
 
 	unsigned truebit_num()
@@ -71,8 +76,8 @@ public:
 
 	bool get_status(unsigned idx)
 	{
-		if(idx < symbol_status->size())
-			return symbol_status->at(idx);
+		if(idx < symbol_len)
+			return ((*symbol_status)[idx / PZ3_WORD_BITS] >> (idx % PZ3_WORD_BITS)) & 1;
 		else
 		{
 			std::cerr << "illegal parameter" << std::endl;
@@ -82,48 +87,69 @@ public:
 
 	bool operator[](unsigned idx)
 	{
-		if(idx < symbol_status->size())
-			return symbol_status->at(idx);
-		else
-		{
-			std::cerr << "illegal parameter" << std::endl;
-			return false;
-		}
+		return get_status(idx);
 	}
 
 	void push(bool value)
 	{
-		symbol_status->push_back(value);
+		if(symbol_len % PZ3_WORD_BITS == 0)
+			symbol_status->push_back(0);
 		if(value)
+		{
+			symbol_status->back() |= (bit_word)1 << (symbol_len % PZ3_WORD_BITS);
 			symbol_num++;
+		}
+		symbol_len++;
+		hash_valid = false;
+	}
+
+	unsigned hash() const
+	{
+		if(!hash_valid)
+		{
+			// FNV-1a over words
+			unsigned long long h = 14695981039346656037ull;
+			bit_word const * words = symbol_status->empty() ? NULL : &(*symbol_status)[0];
+			unsigned len = symbol_status->size();
+			for(unsigned i = 0; i < len; i++)
+			{
+				h ^= words[i];
+				h *= 1099511628211ull;
+			}
+			hash_value = (unsigned)(h ^ (h >> 32));
+			hash_valid = true;
+		}
+		return hash_value;
 	}
 
 	friend bool operator<(const simple_node &lhs, const simple_node &rhs)
 	{
 		if (lhs.symbol_num < rhs.symbol_num) return true;
 		if (lhs.symbol_num > rhs.symbol_num) return false;
+		// the first differing symbol decides: lhs is smaller if it lacks that symbol
 		unsigned len = lhs.symbol_status->size();
 		for(unsigned i = 0; i < len; i++)
 		{
-			if(!lhs.symbol_status->at(i) && rhs.symbol_status->at(i)) return true;
-			if(lhs.symbol_status->at(i) && !rhs.symbol_status->at(i)) return false;
+			bit_word lw = (*lhs.symbol_status)[i];
+			bit_word rw = (*rhs.symbol_status)[i];
+			if(lw != rw)
+			{
+				bit_word low = (lw ^ rw) & (~(lw ^ rw) + 1);
+				return (rw & low) != 0;
+			}
 		}
 		return false; // If they are all the same
 	}
 
 	friend bool operator==(const simple_node &lhs, const simple_node& rhs)
 	{
-		if (lhs.symbol_num == rhs.symbol_num)
-		{
-			unsigned len = lhs.symbol_status->size();
-			for(unsigned i = 0; i < len; i++)
-			{
-				if(lhs.symbol_status->at(i) != rhs.symbol_status->at(i))
-					return false;
-			}
+		if (lhs.symbol_num != rhs.symbol_num)
+			return false;
+		if (lhs.symbol_status == rhs.symbol_status)
 			return true;
-		}
-		return false;
+		if (lhs.hash_valid && rhs.hash_valid && lhs.hash_value != rhs.hash_value)
+			return false;
+		return *lhs.symbol_status == *rhs.symbol_status;
 	}
 
 	friend bool operator>(const simple_node &lhs, const simple_node &rhs)
@@ -133,30 +159,48 @@ public:
 		return true;
 	}
 
+	// word-wise AND; the loops below run on plain arrays so that they can be vectorized
 	simple_node intersect(simple_node * hs)
 	{
 		unsigned len = symbol_status->size();
-		assert(len == hs->symbol_size());
+		assert(symbol_len == hs->symbol_size());
 		simple_node result;
+		result.symbol_status->resize(len);
+		result.symbol_len = symbol_len;
+		if(len == 0)
+			return result;
+		bit_word const * lw = &(*symbol_status)[0];
+		bit_word const * rw = &(*hs->symbol_status)[0];
+		bit_word * ow = &(*result.symbol_status)[0];
+		unsigned count = 0;
 		for(unsigned i = 0; i < len; i++)
 		{
-			if(symbol_status->at(i) && hs->get_status(i))
-				result.push(true);
-			else
-				result.push(false);
+			ow[i] = lw[i] & rw[i];
+			count += __builtin_popcountll(ow[i]);
 		}
+		result.symbol_num = count;
 		return result;
 	}
 
+	// strict subset test by word-wise ANDNOT
 	bool is_subset(simple_node * hs)
 	{
 		unsigned len = symbol_status->size();
-		assert(len == hs->symbol_size());
+		assert(symbol_len == hs->symbol_size());
 		if(symbol_num >= hs->truebit_num())
 			return false;
-		for(unsigned i = 0; i < len; i++)
+		bit_word const * lw = &(*symbol_status)[0];
+		bit_word const * rw = &(*hs->symbol_status)[0];
+		// check blocks of 8 words without branches, and leave early between blocks
+		for(unsigned i = 0; i < len; i += 8)
 		{
-			if(symbol_status->at(i) && !hs->get_status(i))
+			unsigned block_end = (i + 8 < len) ? i + 8 : len;
+			bit_word rest = 0;
+			for(unsigned j = i; j < block_end; j++)
+			{
+				rest |= lw[j] & ~rw[j];
+			}
+			if(rest != 0)
 				return false;
 		}
 		return true;
@@ -171,6 +215,8 @@ protected:
 	boost::shared_ptr<std::vector<node*> > after;
 	unsigned weight;
 	unsigned cls_num;
+	// position of this node in insertion order (parents are always inserted after children)
+	unsigned idx;
 
 public:
 	node():simple_node()
@@ -179,6 +225,7 @@ public:
 		after = boost::shared_ptr<std::vector<node*> >(new std::vector<node*>);
 		weight = 0;
 		cls_num = 0;
+		idx = 0;
 	}
 
 	node(simple_node & sn):simple_node(sn)
@@ -187,6 +234,17 @@ public:
 		after = boost::shared_ptr<std::vector<node*> >(new std::vector<node*>);
 		weight = 0;
 		cls_num = 0;
+		idx = 0;
+	}
+
+	void set_index(unsigned index)
+	{
+		idx = index;
+	}
+
+	unsigned get_index()
+	{
+		return idx;
 	}
 
 	void set_weight(unsigned wgt)
@@ -256,6 +314,36 @@ public:
 };
 
 
+#define PZ3_STREAM_GAMMA 1.5
+#define PZ3_STREAM_SLACK 1.1
+
+// state of the streaming distribution method (dist/stream.cpp)
+class stream_partitioner
+{
+protected:
+	int parts;
+	unsigned words;
+	// partitions where each symbol appears, one bitset of 'words' words per symbol
+	std::vector<bit_word> symbol_part;
+	std::vector<double> load;
+	// penalty of each partition, updated when its load changes
+	std::vector<double> penalty;
+	// number of symbols of the current clause in each partition, and partitions touched by it
+	std::vector<int> shared;
+	std::vector<int> touched;
+	double alpha;
+	double capacity;
+
+public:
+	void init(unsigned symbol_num, unsigned clause_num, unsigned occur_num, int part_num);
+
+	// assign one clause (sorted symbol ids) to a partition
+	int assign(symbol_list & syms);
+
+	// record a clause assigned to partition part before
+	void place(symbol_list & syms, int part);
+};
+
 // prepare searching from a top node
 bool top_search(node * new_nd, node * top_nd);
 
@@ -263,6 +351,7 @@ bool top_search(node * new_nd, node * top_nd);
 void sub_search(simple_node * insc, node * new_nd, node * sub_nd);
 
 // find shortest path to construct a division
-void find_shortest(node * this_node, std::vector<simple_node> & cur_path, std::vector<simple_node> & best_path, unsigned cur_wgt, unsigned & best_wgt, unsigned cur_num);
+// all_node must be in insertion order, which is a topological order of the poset
+void find_shortest(int part_num, std::vector<node*> & all_node, std::vector<node*> & bot_node, std::vector<simple_node> & best_path, unsigned & best_wgt);
 
 #endif
@@ -1,42 +1,52 @@
 #include "dist.hpp"
+#include "../flatMap.hpp"
 #include <list>
 #include <climits>
 
-extern int core_num;
-extern std::vector<int> expr_dist;
+// order positions of entries in stat by their nodes
+struct stat_less
+{
+	flat_map<simple_node, std::vector<int> > & stat;
+	stat_less(flat_map<simple_node, std::vector<int> > & st) : stat(st) {}
+	bool operator()(unsigned lhs, unsigned rhs)
+	{
+		return (stat.begin() + lhs)->first < (stat.begin() + rhs)->first;
+	}
+};
+
+char const dist_name[] = "heur1";
 
-void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned> > &symbol_sub, std::vector<int> &clause_weight)
+void dist_clause(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist)
 {
 	unsigned cls_num = symbol_sub.size();
 
 	// initialize nodes
-	std::map<simple_node, std::vector<int> > stat;
+	flat_map<simple_node, std::vector<int> > stat;
 	for(unsigned i = 0; i < cls_num; i++)
 	{
-		std::set<unsigned> & my_sub = symbol_sub.at(i);
+		symbol_list & my_sub = symbol_sub.at(i);
 		simple_node sn;
-		sn.set_symbol(symbol_set, my_sub);
-		std::map<simple_node, std::vector<int> >::iterator findit = stat.find(sn);
-		if(findit == stat.end())
-		{
-			std::vector<int> newvec;
-			newvec.push_back(i);
-			stat.insert(std::pair<simple_node, std::vector<int> >(sn, newvec));
-		}
-		else
-		{
-			(findit->second).push_back(i);
-		}
+		sn.set_symbol(symbol_num, my_sub);
+		stat[sn].push_back(i);
 	}
+	// nodes must be added to the poset in ascending order
+	std::vector<unsigned> stat_order(stat.size());
+	for(unsigned i = 0; i < stat_order.size(); i++)
+		stat_order.at(i) = i;
+	std::sort(stat_order.begin(), stat_order.end(), stat_less(stat));
 
 	// construct a poset for nodes
+	// all nodes in insertion order
+	std::vector<node*> all_node;
 	// bottom nodes increase only
 	std::vector<node*> bot_node;
 	// top nodes increase and reduce
 	std::list<node*> top_node;
 
-	for(std::map<simple_node, std::vector<int> >::iterator it = stat.begin(); it != stat.end(); ++it)
+	unsigned stat_len = stat_order.size();
+	for(unsigned k = 0; k < stat_len; k++)
 	{
+		flat_map<simple_node, std::vector<int> >::iterator it = stat.begin() + stat_order.at(k);
 		simple_node this_sn = it->first;
 		int clause_idx = (it->second).at(0);
 		int clause_wgt = clause_weight.at(clause_idx);
@@ -44,6 +54,8 @@ void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned>
 		node * nd = new node(this_sn);
 		nd->set_weight(clause_wgt);
 		nd->set_clause_num(clause_num);
+		nd->set_index(all_node.size());
+		all_node.push_back(nd);
 
 		// make connections
 		std::list<node*>::iterator list_it = top_node.begin();
@@ -77,19 +89,14 @@ void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned>
 	}
 
 	// search for a shortest path from bottom node
-	unsigned bot_len = bot_node.size();
-	std::vector<simple_node> cur_path;
 	std::vector<simple_node> best_path;
 	unsigned best_wgt = UINT_MAX;
-	for(unsigned i = 0; i < bot_len; i++)
-	{
-		find_shortest(bot_node.at(i), cur_path, best_path, 0, best_wgt, 0);
-	}
+	find_shortest(part_num, all_node, bot_node, best_path, best_wgt);
 
 	if(best_wgt < UINT_MAX)
 	{
 		// if such a path is derived
-		expr_dist = std::vector<int>(cls_num, 0); // initialize first
+		dist = std::vector<int>(cls_num, 0); // initialize first
 		std::vector<int> rem_vec;
 		unsigned bp_len = best_path.size();
 		for(unsigned i = 0; i < bp_len; i++)
@@ -98,19 +105,19 @@ void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned>
 			std::vector<int> &this_vecint = (stat.find(this_sn))->second;
 			rem_vec.insert(rem_vec.begin(), this_vecint.begin(), this_vecint.end());
 		}
-		// clauses in rem_vec are divided into (core_num - 1) partitions
+		// clauses in rem_vec are divided into (part_num - 1) partitions
 #if 0
 		unsigned rem_len = rem_vec.size();
 		for(unsigned i = 0; i < rem_len; i++)
 		{
-			expr_dist.at(rem_vec.at(i)) = i % (core_num - 1) + 1;
+			dist.at(rem_vec.at(i)) = i % (part_num - 1) + 1;
 		}
 #endif
 
 #if 1
-		for(unsigned i = 0; i < (unsigned)(core_num - 1); i++)
+		for(unsigned i = 0; i < (unsigned)(part_num - 1); i++)
 		{
-			expr_dist.at(rem_vec.at(i)) = i + 1;
+			dist.at(rem_vec.at(i)) = i + 1;
 		}
 #endif
 		// ok, remaining clauses compose into sub-formula 0
@@ -119,9 +126,10 @@ void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned>
 	else
 	{
 		// if no such a path is derived, just use sequential deivision method
-		int q = cls_num / core_num;
-		int r = cls_num % core_num;
-		for(int i = 0; i < core_num; i++)
+		dist.clear();
+		int q = cls_num / part_num;
+		int r = cls_num % part_num;
+		for(int i = 0; i < part_num; i++)
 		{
 			int pick_num = q;
 			if(r > 0)
@@ -130,12 +138,19 @@ void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned>
 				r--;
 			}
 			for(int j = 0; j < pick_num; j++)
-				expr_dist.push_back(i);
+				dist.push_back(i);
 		}
 	}
 
 }
 
+void dist_extend(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist)
+{
+	// partition 0 takes the clauses left by the shortest path, and so it takes new clauses too
+	unsigned cls_num = symbol_sub.size();
+	dist.resize(cls_num, 0);
+}
+
 bool top_search(node * new_nd, node * top_nd)
 {
 	simple_node insc;
@@ -175,29 +190,72 @@ void sub_search(simple_node * insc, node * new_nd, node * sub_nd)
 	}
 }
 
-void find_shortest(node * this_node, std::vector<simple_node> & cur_path, std::vector<simple_node> & best_path, unsigned cur_wgt, unsigned & best_wgt, unsigned cur_num)
+/*
+  A path starts from a bottom node, goes up through parents and terminates at the first node where
+  it has collected at least (part_num - 1) clauses. Its weight is the sum of node weights.
+  The state of a path at a node is the number of clauses collected before the node, which is less
+  than (part_num - 1), so the minimum weight of every (node, count) state is computed by dynamic
+  programming over nodes in topological order. All bottom nodes are seeded at once.
+  Time: O((nodes + edges) * part_num), instead of enumerating every upward path.
+*/
+void find_shortest(int part_num, std::vector<node*> & all_node, std::vector<node*> & bot_node, std::vector<simple_node> & best_path, unsigned & best_wgt)
 {
-	unsigned new_num = cur_num + this_node->clause_num();
-	unsigned new_wgt = cur_wgt + this_node->get_weight();
-	simple_node this_sn = *this_node;
-	cur_path.push_back(this_sn);
-	if(new_num >= (unsigned)(core_num - 1))
+	unsigned node_len = all_node.size();
+	unsigned goal = (unsigned)(part_num - 1);
+	if(goal == 0)
+		return;
+	// state (i, c): node i is reached with c clauses collected, stored at i * goal + c
+	std::vector<unsigned> state_wgt(node_len * goal, UINT_MAX);
+	// predecessor state of each state, UINT_MAX for a path starting here
+	std::vector<unsigned> state_prev(node_len * goal, UINT_MAX);
+	unsigned best_state = UINT_MAX;
+
+	unsigned bot_len = bot_node.size();
+	for(unsigned i = 0; i < bot_len; i++)
+	{
+		state_wgt.at(bot_node.at(i)->get_index() * goal) = 0;
+	}
+
+	for(unsigned i = 0; i < node_len; i++)
 	{
-		// this path terminates
-		if(new_wgt < best_wgt)
+		node * this_node = all_node.at(i);
+		unsigned num_parent = this_node->parent_num();
+		for(unsigned c = 0; c < goal; c++)
 		{
-			best_wgt = new_wgt;
-			best_path = cur_path;
+			unsigned state = i * goal + c;
+			if(state_wgt.at(state) == UINT_MAX)
+				continue;
+			unsigned new_num = c + this_node->clause_num();
+			unsigned new_wgt = state_wgt.at(state) + this_node->get_weight();
+			if(new_num >= goal)
+			{
+				// this path terminates
+				if(new_wgt < best_wgt)
+				{
+					best_wgt = new_wgt;
+					best_state = state;
+				}
+				continue;
+			}
+			// this path should continue extending
+			for(unsigned j = 0; j < num_parent; j++)
+			{
+				unsigned next_state = this_node->get_parent(j)->get_index() * goal + new_num;
+				if(new_wgt < state_wgt.at(next_state))
+				{
+					state_wgt.at(next_state) = new_wgt;
+					state_prev.at(next_state) = state;
+				}
+			}
 		}
-		cur_path.pop_back();
-		return;
 	}
-	// this path should continue extending
-	unsigned num_parent = this_node->parent_num();
-	for(unsigned i = 0; i < num_parent; i++)
+
+	// rebuild the path from bottom to top
+	best_path.clear();
+	unsigned state = best_state;
+	while(state != UINT_MAX)
 	{
-		find_shortest(this_node->get_parent(i), cur_path, best_path, new_wgt, best_wgt, new_num);
+		best_path.insert(best_path.begin(), simple_node(*all_node.at(state / goal)));
+		state = state_prev.at(state);
 	}
-	cur_path.pop_back();
-	return;
-}
\ No newline at end of file
+}
@@ -1,16 +1,16 @@
 #include "dist.hpp"
 
-extern int core_num;
-extern std::vector<int> expr_dist;
+char const dist_name[] = "seq";
 
-void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned> > &symbol_sub, std::vector<int> &clause_weight)
+void dist_clause(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist)
 {
     int length = symbol_sub.size();
+    dist.clear();
 
-    int q = length / core_num;
-    int r = length % core_num;
+    int q = length / part_num;
+    int r = length % part_num;
     int index = 0;
-    for (int i = 0; i < core_num; i++)
+    for (int i = 0; i < part_num; i++)
     {
         int pick_num = q;
         if (r > 0)
@@ -20,7 +20,28 @@ void dist_clause(std::set<unsigned> &symbol_set, std::vector<std::set<unsigned>
         }
         for (int j = 0; j < pick_num; j++, index++)
         {
-            expr_dist.push_back(i);
+            dist.push_back(i);
         }
     }
 }
+
+void dist_extend(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist)
+{
+    std::vector<int> load(part_num, 0);
+    for (unsigned i = 0; i < dist.size(); i++)
+    {
+        load.at(dist[i])++;
+    }
+    // every new clause goes to the partition with the fewest clauses
+    for (unsigned i = dist.size(); i < symbol_sub.size(); i++)
+    {
+        int best = 0;
+        for (int p = 1; p < part_num; p++)
+        {
+            if (load[p] < load[best])
+                best = p;
+        }
+        dist.push_back(best);
+        load[best]++;
+    }
+}
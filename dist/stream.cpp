@@ -0,0 +1,127 @@
+#include "dist.hpp"
+#include <cmath>
+
+/*
+  One-pass streaming distribution (Fennel).
+  Clauses are assigned in arrival order. A clause goes to the partition that already holds most of
+  its symbols, minus a penalty growing with the load of the partition:
+      score(p) = |symbols of clause in p| - alpha * gamma * load(p)^(gamma - 1)
+  and a partition is closed when its load exceeds PZ3_STREAM_SLACK times the average load.
+  The only state is the set of partitions each symbol appears in, so memory is proportional to the
+  number of symbols, and the time is linear in the number of symbol occurrences.
+*/
+
+void stream_partitioner::init(unsigned symbol_num, unsigned clause_num, unsigned occur_num, int part_num)
+{
+    parts = part_num;
+    words = (part_num + PZ3_WORD_BITS - 1) / PZ3_WORD_BITS;
+    symbol_part.assign(symbol_num * words, 0);
+    load.assign(part_num, 0.0);
+    penalty.assign(part_num, 0.0);
+    shared.assign(part_num, 0);
+    // alpha = sqrt(k) * m / n^1.5 as suggested for Fennel, with clauses as vertices and occurrences as edges
+    double n = clause_num > 0 ? clause_num : 1;
+    alpha = std::sqrt((double) part_num) * occur_num / std::pow(n, PZ3_STREAM_GAMMA);
+    capacity = PZ3_STREAM_SLACK * n / part_num;
+}
+
+int stream_partitioner::assign(symbol_list &syms)
+{
+    unsigned len = syms.size();
+    // count symbols of this clause in every partition
+    for (unsigned i = 0; i < len; i++)
+    {
+        bit_word const *mask = &symbol_part[syms[i] * words];
+        for (unsigned w = 0; w < words; w++)
+        {
+            bit_word bits = mask[w];
+            while (bits != 0)
+            {
+                int p = w * PZ3_WORD_BITS + __builtin_ctzll(bits);
+                if (shared[p] == 0)
+                    touched.push_back(p);
+                shared[p]++;
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    int best = -1;
+    double best_score = 0;
+    for (int p = 0; p < parts; p++)
+    {
+        if (load[p] + 1 > capacity)
+            continue;
+        double score = shared[p] - penalty[p];
+        // ties go to the partition with less load
+        if (best < 0 || score > best_score || (score == best_score && load[p] < load[best]))
+        {
+            best = p;
+            best_score = score;
+        }
+    }
+    if (best < 0)
+    {
+        // every partition is full: take the least loaded one
+        best = 0;
+        for (int p = 1; p < parts; p++)
+            if (load[p] < load[best])
+                best = p;
+    }
+
+    for (unsigned i = 0; i < touched.size(); i++)
+        shared[touched[i]] = 0;
+    touched.clear();
+    for (unsigned i = 0; i < len; i++)
+        symbol_part[syms[i] * words + best / PZ3_WORD_BITS] |= (bit_word) 1 << (best % PZ3_WORD_BITS);
+    load[best] += 1;
+    penalty[best] = alpha * PZ3_STREAM_GAMMA * std::pow(load[best], PZ3_STREAM_GAMMA - 1);
+    return best;
+}
+
+void stream_partitioner::place(symbol_list &syms, int part)
+{
+    for (unsigned i = 0; i < syms.size(); i++)
+        symbol_part[syms[i] * words + part / PZ3_WORD_BITS] |= (bit_word) 1 << (part % PZ3_WORD_BITS);
+    load[part] += 1;
+    penalty[part] = alpha * PZ3_STREAM_GAMMA * std::pow(load[part], PZ3_STREAM_GAMMA - 1);
+}
+
+char const dist_name[] = "stream";
+
+void dist_clause(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist)
+{
+    unsigned cls_num = symbol_sub.size();
+    unsigned occur_num = 0;
+    for (unsigned i = 0; i < cls_num; i++)
+        occur_num += symbol_sub.at(i).size();
+
+    stream_partitioner sp;
+    sp.init(symbol_num, cls_num, occur_num, part_num);
+    dist = std::vector<int>(cls_num, 0);
+    for (unsigned i = 0; i < cls_num; i++)
+    {
+        dist.at(i) = sp.assign(symbol_sub.at(i));
+    }
+}
+
+void dist_extend(int part_num, unsigned symbol_num, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight, std::vector<int> &dist)
+{
+    unsigned cls_num = symbol_sub.size();
+    unsigned occur_num = 0;
+    for (unsigned i = 0; i < cls_num; i++)
+        occur_num += symbol_sub.at(i).size();
+
+    // the stream goes on from the clauses distributed before
+    stream_partitioner sp;
+    sp.init(symbol_num, cls_num, occur_num, part_num);
+    unsigned old_num = dist.size();
+    for (unsigned i = 0; i < old_num; i++)
+    {
+        sp.place(symbol_sub.at(i), dist.at(i));
+    }
+    for (unsigned i = old_num; i < cls_num; i++)
+    {
+        dist.push_back(sp.assign(symbol_sub.at(i)));
+    }
+}
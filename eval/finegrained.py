@@ -1,7 +1,8 @@
 import getopt
+import json
 import os
-import re
 import sys
+import tempfile
 
 import subprocess
 
@@ -49,7 +50,10 @@ def main(argv):
 
 def evaluate(tool, bench_dir, core, timeout, export_stat):
     raw_result = []
-    args = [tool]
+    # statistics of every run are written as JSON to this file
+    stats_fd, stats_path = tempfile.mkstemp(suffix='.json')
+    os.close(stats_fd)
+    args = [tool, '--stats', stats_path]
     timeout_value = timeout if timeout > 0 else None
     for root, dirs, files in os.walk(bench_dir):
         smt_files = [os.path.join(root, f) for f in files if f.endswith(".smt2")]
@@ -59,54 +63,31 @@ def evaluate(tool, bench_dir, core, timeout, export_stat):
             try:
                 result = subprocess.run(args, stdout=subprocess.PIPE, timeout=timeout_value)
                 if result.returncode == 0:
-                    duration = load_duration(result.stdout)
+                    duration = load_duration(stats_path)
                     raw_result.append((smt_file, duration))
             except subprocess.TimeoutExpired:
                 # in this case, we discard partial results if any
-                raw_result.append((smt_file, ('*', '*', '*', '*', '*', '*')))
+                raw_result.append((smt_file, tuple('*' for _ in phase_names)))
             export_result(raw_result, export_stat)
             raw_result.clear()
             print(smt_file)
             args.pop()
             args.pop()
+    os.remove(stats_path)
 
-time_pattern = re.compile(r"(\w+): (\d+)")
+# phases timed by pz3 --stats, one column each after the case name
+phase_names = ['division', 'cnf', 'distribution', 'subsolve', 'localization', 'form', 'solve', 'interpolation',
+               'translation', 'ssr']
 
 
-def load_duration(output_str):
-    decomp_time = '*'
-    solve_time = '*'
-    interp_time = '*'
-    formulate_time = '*'
-    ssr_time = '*'
-    gs_time = '*'
-    lines = output_str.decode('utf-8').split('\n')
-    for line in lines:
-        match = re.match(time_pattern, line)
-        if match:
-            time_name = match.group(1)
-            time_metric = match.group(2)
-            if time_name == 'DECOMP':
-                decomp_time = int(time_metric)
-            elif time_name == 'SOLVE':
-                solve_time = int(time_metric)
-            elif time_name == 'INTERP':
-                interp_time = int(time_metric)
-            elif time_name == 'SSR':
-                ssr_time = int(time_metric)
-            elif time_name == 'FORM':
-                formulate_time = int(time_metric)
-            elif time_name == 'GENSOLVE':
-                gs_time = int(time_metric)
-    return decomp_time, solve_time, interp_time, formulate_time, ssr_time, gs_time
+def load_duration(stats_path):
+    # total milliseconds of every phase over all threads, 0 for a phase which did not happen
+    with open(stats_path) as stats_file:
+        stats = json.loads(stats_file.readline())
+    phases = stats.get('timers', {}).get('phases', {})
+    return tuple(phases.get(name, {}).get('ms', 0) for name in phase_names)
 
 case_name_column = 1
-decomp_column = 2
-solve_column = 3
-interp_column = 4
-formulate_column = 5
-ssr_column = 6
-gs_column = 7
 
 
 def export_result(raw_result, export_stat):
@@ -120,14 +101,9 @@ def export_result(raw_result, export_stat):
         row_pointer = ws.max_row + 1
     for result in raw_result:
         case_name, time_result = result
-        decomp_time, solve_time, interp_time, formulate_time, ssr_time, gs_time = time_result
         ws.cell(row=row_pointer, column=case_name_column).value = case_name
-        ws.cell(row=row_pointer, column=decomp_column).value = decomp_time
-        ws.cell(row=row_pointer, column=solve_column).value = solve_time
-        ws.cell(row=row_pointer, column=interp_column).value = interp_time
-        ws.cell(row=row_pointer, column=formulate_column).value = formulate_time
-        ws.cell(row=row_pointer, column=ssr_column).value = ssr_time
-        ws.cell(row=row_pointer, column=gs_column).value = gs_time
+        for i, phase_time in enumerate(time_result):
+            ws.cell(row=row_pointer, column=case_name_column + 1 + i).value = phase_time
         row_pointer += 1
     wb.save(filename=export_stat)
 
@@ -1,7 +1,8 @@
 import os
-import re
 import sys
+import json
 import getopt
+import tempfile
 import subprocess
 import openpyxl
 
@@ -48,7 +49,10 @@ def main(argv):
 
 def evaluate(tool, bench_dir, core, timeout, export_stat):
     raw_result = []
-    args = [tool]
+    # statistics of every run are written as JSON to this file
+    stats_fd, stats_path = tempfile.mkstemp(suffix='.json')
+    os.close(stats_fd)
+    args = [tool, '--stats', stats_path]
     timeout_value = timeout if timeout > 0 else None
     for root, dirs, files in os.walk(bench_dir):
         smt_files = [os.path.join(root, f) for f in files if f.endswith(".smt2")]
@@ -58,7 +62,7 @@ def evaluate(tool, bench_dir, core, timeout, export_stat):
             try:
                 result = subprocess.run(args, stdout=subprocess.PIPE, timeout=timeout_value)
                 if result.returncode == 0:
-                    duration = load_duration(result.stdout)
+                    duration = load_duration(stats_path)
                     raw_result.append((smt_file, duration))
             except subprocess.TimeoutExpired:
                 # if we have triggered timeout exception, the specified timeout must be greater than 0
@@ -71,28 +75,14 @@ def evaluate(tool, bench_dir, core, timeout, export_stat):
             print(smt_file)
             args.pop()
             args.pop()
+    os.remove(stats_path)
     return raw_result
 
-time_pattern = re.compile(r"(\w+): (\d+)\D+")
 
-
-def load_duration(output_str):
-    decompose_time = '*'
-    subsolve_time = '*'
-    conciliate_time = '*'
-    lines = output_str.decode('utf-8').split('\n')
-    for line in lines:
-        match = re.match(time_pattern, line)
-        if match:
-            time_name = match.group(1)
-            time_metric = match.group(2)
-            if time_name == 'DECOMPOSITION':
-                decompose_time = int(time_metric)
-            elif time_name == 'SUBSOLVE':
-                subsolve_time = int(time_metric)
-            elif time_name == 'CONCILIATION':
-                conciliate_time = int(time_metric)
-    return decompose_time, subsolve_time, conciliate_time
+def load_duration(stats_path):
+    with open(stats_path) as stats_file:
+        stats = json.loads(stats_file.readline())
+    return stats['division_ms'], stats['subsolve_ms'], stats['conciliation_ms']
 
 case_name_column = 1
 decompose_column = 2
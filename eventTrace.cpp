@@ -0,0 +1,67 @@
+#include "eventTrace.hpp"
+#include <unistd.h>
+
+eventTrace::eventTrace()
+{
+    on = false;
+}
+
+void eventTrace::enable(unsigned thread_num)
+{
+    rings.resize(thread_num);
+    for (unsigned i = 0; i < thread_num; i++)
+    {
+        rings[i].events.resize(PZ3_TRACE_EVENTS);
+        rings[i].head = 0;
+    }
+    epoch = boost::chrono::high_resolution_clock::now();
+    on = true;
+}
+
+void eventTrace::set_name(unsigned thread, std::string const &name)
+{
+    rings.at(thread).name = name;
+}
+
+void eventTrace::write(std::ostream &out) const
+{
+    long pid = getpid();
+    std::streamsize precision = out.precision(3);
+    std::ios_base::fmtflags flags = out.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (unsigned t = 0; t < rings.size(); t++)
+    {
+        trace_ring const &ring = rings[t];
+        if (!first)
+            out << ",";
+        first = false;
+        out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << t
+            << ",\"args\":{\"name\":\"" << ring.name << "\"}}";
+
+        unsigned long long capacity = ring.events.size();
+        unsigned long long from = ring.head > capacity ? ring.head - capacity : 0;
+        // ends of spans whose beginning was overwritten are left out
+        unsigned depth = 0;
+        for (unsigned long long i = from; i < ring.head; i++)
+        {
+            trace_event const &ev = ring.events[i % capacity];
+            if (ev.phase == 'E')
+            {
+                if (depth == 0)
+                    continue;
+                depth--;
+            }
+            else
+                depth++;
+            out << ",\n{\"name\":\"" << ev.name << "\",\"ph\":\"" << ev.phase << "\",\"ts\":" << ev.ts_ns / 1e3
+                << ",\"pid\":" << pid << ",\"tid\":" << t;
+            if (ev.round > 0)
+                out << ",\"args\":{\"round\":" << ev.round << "}";
+            out << "}";
+        }
+    }
+    out << "\n]}" << std::endl;
+    out.precision(precision);
+    out.flags(flags);
+}
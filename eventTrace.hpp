@@ -0,0 +1,107 @@
+#ifndef _EVENT_TRACE_H_
+#define _EVENT_TRACE_H_
+
+#include <boost/chrono.hpp>
+#include <vector>
+#include <string>
+#include <iostream>
+
+// events kept per thread; older ones are overwritten
+#define PZ3_TRACE_EVENTS (1u << 16)
+
+// trace_event: begin ('B') or end ('E') of a span; name is a string literal
+struct trace_event
+{
+    char const *name;
+    long long ts_ns;
+    unsigned round;
+    char phase;
+};
+
+// trace_ring: events of one thread, written only by the thread running in its place
+struct trace_ring
+{
+    std::vector<trace_event> events;
+    // head: events written so far, the next one goes to head % capacity
+    unsigned long long head;
+    std::string name;
+    // keep heads of threads on different cache lines
+    char pad[64];
+};
+
+/*
+  eventTrace: spans of every thread of a solver (phases, barrier waits) for a timeline, written in
+  the Chrome trace format read by chrome://tracing and Perfetto. Every thread has a ring of its own,
+  so recording an event takes no lock and no atomic operation; rings are read after the threads
+  are joined. When it is off, recording costs a test of a flag.
+*/
+class eventTrace
+{
+protected:
+    bool on;
+    std::vector<trace_ring> rings;
+    boost::chrono::high_resolution_clock::time_point epoch;
+
+    void record(unsigned thread, char const *name, unsigned round, char phase)
+    {
+        trace_ring &ring = rings[thread];
+        trace_event &ev = ring.events[ring.head % ring.events.size()];
+        ev.name = name;
+        ev.ts_ns = boost::chrono::nanoseconds(boost::chrono::high_resolution_clock::now() - epoch).count();
+        ev.round = round;
+        ev.phase = phase;
+        ring.head++;
+    }
+
+public:
+    eventTrace();
+    /* Keep events of thread_num threads from now on */
+    void enable(unsigned thread_num);
+    void set_name(unsigned thread, std::string const &name);
+
+    bool enabled() const
+    {
+        return on;
+    }
+
+    void begin(unsigned thread, char const *name, unsigned round = 0)
+    {
+        if (on)
+            record(thread, name, round, 'B');
+    }
+
+    void end(unsigned thread, char const *name, unsigned round = 0)
+    {
+        if (on)
+            record(thread, name, round, 'E');
+    }
+
+    /* Write all events kept as a Chrome trace (JSON) */
+    void write(std::ostream &out) const;
+};
+
+// trace_span: a span from construction to destruction
+class trace_span
+{
+protected:
+    eventTrace &trace;
+    unsigned thread;
+    char const *name;
+    unsigned round;
+
+public:
+    trace_span(eventTrace &t, unsigned thread_id, char const *span_name, unsigned round_id = 0) : trace(t)
+    {
+        thread = thread_id;
+        name = span_name;
+        round = round_id;
+        trace.begin(thread, name, round);
+    }
+
+    ~trace_span()
+    {
+        trace.end(thread, name, round);
+    }
+};
+
+#endif
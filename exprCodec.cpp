@@ -0,0 +1,610 @@
+#include "exprCodec.hpp"
+#include <cstring>
+
+// operators of terms in an expression table; 0 marks an uninterpreted function
+typedef enum
+{
+    PZ3_op_true = 1,
+    PZ3_op_false,
+    PZ3_op_not,
+    PZ3_op_and,
+    PZ3_op_or,
+    PZ3_op_implies,
+    PZ3_op_iff,
+    PZ3_op_xor,
+    PZ3_op_eq,
+    PZ3_op_distinct,
+    PZ3_op_ite
+} PZ3_Op;
+
+void binWriter::put(unsigned value)
+{
+    while (value >= 0x80)
+    {
+        buf.push_back((char) (value | 0x80));
+        value >>= 7;
+    }
+    buf.push_back((char) value);
+}
+
+void binWriter::put(std::string const &value)
+{
+    put((unsigned) value.size());
+    buf.append(value);
+}
+
+void binWriter::put(closure value)
+{
+    put(value.get_sort());
+    put(value.get_value());
+}
+
+void binWriter::put(symbol_list const &list)
+{
+    unsigned len = list.size();
+    put(len);
+    unsigned last = 0;
+    for (unsigned i = 0; i < len; i++)
+    {
+        put(list[i] - last);
+        last = list[i];
+    }
+}
+
+void binWriter::put(closure_list const &list)
+{
+    put((unsigned) list.size());
+    for (unsigned i = 0; i < list.size(); i++)
+    {
+        put(list[i].first);
+        put(list[i].second);
+    }
+}
+
+void binWriter::put(entry_list const &list)
+{
+    put((unsigned) list.size());
+    for (unsigned i = 0; i < list.size(); i++)
+    {
+        model_entry const &entry = list[i];
+        put(entry.fun_id);
+        put((unsigned) entry.args.size());
+        for (unsigned j = 0; j < entry.args.size(); j++)
+            put(entry.args[j]);
+        put(entry.value);
+    }
+}
+
+void binWriter::put_section(unsigned tag, binWriter const &body)
+{
+    put(tag);
+    put(body.buf);
+}
+
+void binWriter::put_header()
+{
+    buf.append(PZ3_FORMAT_MAGIC);
+    put((unsigned) PZ3_FORMAT_VERSION);
+}
+
+binReader::binReader(std::string const &data)
+{
+    buf = data.data();
+    len = data.size();
+    pos = 0;
+}
+
+binReader::binReader(char const *data, size_t size)
+{
+    buf = data;
+    len = size;
+    pos = 0;
+}
+
+bool binReader::get(unsigned &value)
+{
+    value = 0;
+    // 5 bytes at most for 32 bits
+    for (unsigned shift = 0; shift < 35; shift += 7)
+    {
+        if (pos == len)
+            return false;
+        unsigned char byte = buf[pos++];
+        value |= (unsigned) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool binReader::get(std::string &value)
+{
+    unsigned size;
+    if (!get(size) || len - pos < size)
+        return false;
+    value.assign(buf + pos, size);
+    pos += size;
+    return true;
+}
+
+bool binReader::get(closure &value)
+{
+    unsigned sort_id, value_id;
+    if (!get(sort_id) || !get(value_id))
+        return false;
+    value = closure(sort_id, value_id);
+    return true;
+}
+
+bool binReader::get(symbol_list &list)
+{
+    unsigned size;
+    if (!get(size) || len - pos < size)
+        return false;
+    list.resize(size);
+    unsigned last = 0;
+    for (unsigned i = 0; i < size; i++)
+    {
+        unsigned gap;
+        if (!get(gap))
+            return false;
+        last += gap;
+        list[i] = last;
+    }
+    return true;
+}
+
+bool binReader::get(closure_list &list)
+{
+    unsigned size;
+    // a pair takes 3 bytes at least
+    if (!get(size) || (len - pos) / 3 < size)
+        return false;
+    list.resize(size);
+    for (unsigned i = 0; i < size; i++)
+    {
+        if (!get(list[i].first) || !get(list[i].second))
+            return false;
+    }
+    return true;
+}
+
+bool binReader::get(entry_list &list)
+{
+    unsigned size;
+    // an instance takes 4 bytes at least
+    if (!get(size) || (len - pos) / 4 < size)
+        return false;
+    list.resize(size);
+    for (unsigned i = 0; i < size; i++)
+    {
+        model_entry &entry = list[i];
+        unsigned arg_num;
+        if (!get(entry.fun_id) || !get(arg_num) || (len - pos) / 2 < arg_num)
+            return false;
+        entry.args.resize(arg_num);
+        for (unsigned j = 0; j < arg_num; j++)
+        {
+            if (!get(entry.args[j]))
+                return false;
+        }
+        if (!get(entry.value))
+            return false;
+    }
+    return true;
+}
+
+bool binReader::get_block(binReader &body)
+{
+    unsigned size;
+    if (!get(size) || len - pos < size)
+        return false;
+    body = binReader(buf + pos, size);
+    pos += size;
+    return true;
+}
+
+bool binReader::get_section(unsigned &tag, binReader &body)
+{
+    return get(tag) && get_block(body);
+}
+
+bool binReader::find_section(unsigned tag, binReader &body) const
+{
+    binReader scan(buf + pos, len - pos);
+    unsigned this_tag;
+    while (!scan.at_end())
+    {
+        if (!scan.get_section(this_tag, body))
+            return false;
+        if (this_tag == tag)
+            return true;
+    }
+    return false;
+}
+
+bool binReader::get_header()
+{
+    unsigned magic_len = strlen(PZ3_FORMAT_MAGIC);
+    if (len - pos < magic_len || memcmp(buf + pos, PZ3_FORMAT_MAGIC, magic_len) != 0)
+        return false;
+    pos += magic_len;
+    unsigned version;
+    return get(version) && version >= 1 && version <= PZ3_FORMAT_VERSION;
+}
+
+static unsigned op_code(Z3_decl_kind kind)
+{
+    switch (kind)
+    {
+    case Z3_OP_TRUE:
+        return PZ3_op_true;
+    case Z3_OP_FALSE:
+        return PZ3_op_false;
+    case Z3_OP_NOT:
+        return PZ3_op_not;
+    case Z3_OP_AND:
+        return PZ3_op_and;
+    case Z3_OP_OR:
+        return PZ3_op_or;
+    case Z3_OP_IMPLIES:
+        return PZ3_op_implies;
+    case Z3_OP_IFF:
+        return PZ3_op_iff;
+    case Z3_OP_XOR:
+        return PZ3_op_xor;
+    case Z3_OP_EQ:
+        return PZ3_op_eq;
+    case Z3_OP_DISTINCT:
+        return PZ3_op_distinct;
+    case Z3_OP_ITE:
+        return PZ3_op_ite;
+    default:
+        return 0;
+    }
+}
+
+exprEncoder::exprEncoder()
+{
+}
+
+void exprEncoder::put_symbol(binWriter &out, symbol const &sym)
+{
+    if (sym.kind() == Z3_STRING_SYMBOL)
+    {
+        out.put(0u);
+        out.put(sym.str());
+    }
+    else
+    {
+        out.put(1u);
+        out.put((unsigned) Z3_get_symbol_int(sym.ctx(), sym));
+    }
+}
+
+bool exprEncoder::add_sort(sort const &s, unsigned &index)
+{
+    unsigned id = Z3_get_ast_id(s.ctx(), Z3_sort_to_ast(s.ctx(), s));
+    flat_map<unsigned, unsigned>::iterator it = sort_ids.find(id);
+    if (it != sort_ids.end())
+    {
+        index = it->second;
+        return true;
+    }
+    switch (s.sort_kind())
+    {
+    case Z3_BOOL_SORT:
+        sorts.put(0u);
+        break;
+    case Z3_UNINTERPRETED_SORT:
+        sorts.put(1u);
+        put_symbol(sorts, s.name());
+        break;
+    default:
+        return false;
+    }
+    index = sort_ids.size();
+    sort_ids.insert(std::pair<unsigned, unsigned>(id, index));
+    return true;
+}
+
+bool exprEncoder::add_decl(func_decl const &d, unsigned &index)
+{
+    unsigned id = Z3_get_ast_id(d.ctx(), Z3_func_decl_to_ast(d.ctx(), d));
+    flat_map<unsigned, unsigned>::iterator it = decl_ids.find(id);
+    if (it != decl_ids.end())
+    {
+        index = it->second;
+        return true;
+    }
+    // sorts of the declaration go first
+    unsigned arity = d.arity();
+    std::vector<unsigned> domain(arity);
+    unsigned range;
+    for (unsigned i = 0; i < arity; i++)
+    {
+        if (!add_sort(d.domain(i), domain[i]))
+            return false;
+    }
+    if (!add_sort(d.range(), range))
+        return false;
+    put_symbol(decls, d.name());
+    decls.put(arity);
+    for (unsigned i = 0; i < arity; i++)
+        decls.put(domain[i]);
+    decls.put(range);
+    index = decl_ids.size();
+    decl_ids.insert(std::pair<unsigned, unsigned>(id, index));
+    return true;
+}
+
+bool exprEncoder::add(expr const &fs, unsigned &root)
+{
+    Z3_context c = fs.ctx();
+    // terms are written after their arguments, so the walk keeps a term until its arguments are done
+    std::vector<expr> todo;
+    todo.push_back(fs);
+    while (!todo.empty())
+    {
+        expr e = todo.back();
+        unsigned id = Z3_get_ast_id(c, e);
+        if (term_ids.find(id) != term_ids.end())
+        {
+            todo.pop_back();
+            continue;
+        }
+        if (!e.is_app())
+            return false;
+        unsigned num = e.num_args();
+        bool ready = true;
+        for (unsigned i = 0; i < num; i++)
+        {
+            expr arg = e.arg(i);
+            if (term_ids.find(Z3_get_ast_id(c, arg)) == term_ids.end())
+            {
+                todo.push_back(arg);
+                ready = false;
+            }
+        }
+        if (!ready)
+            continue;
+        todo.pop_back();
+
+        unsigned index = term_ids.size();
+        func_decl d = e.decl();
+        Z3_decl_kind kind = d.decl_kind();
+        if (kind == Z3_OP_UNINTERPRETED)
+        {
+            unsigned decl_index;
+            if (!add_decl(d, decl_index))
+                return false;
+            terms.put(0u);
+            terms.put(decl_index);
+        }
+        else
+        {
+            unsigned op = op_code(kind);
+            if (op == 0)
+                return false;
+            terms.put(op);
+            terms.put(num);
+        }
+        for (unsigned i = 0; i < num; i++)
+        {
+            expr arg = e.arg(i);
+            terms.put(index - term_ids.find(Z3_get_ast_id(c, arg))->second);
+        }
+        term_ids.insert(std::pair<unsigned, unsigned>(id, index));
+    }
+    root = term_ids.find(Z3_get_ast_id(c, fs))->second;
+    return true;
+}
+
+void exprEncoder::write(binWriter &out)
+{
+    out.put((unsigned) sort_ids.size());
+    out.put(sorts.data());
+    out.put((unsigned) decl_ids.size());
+    out.put(decls.data());
+    out.put((unsigned) term_ids.size());
+    out.put(terms.data());
+}
+
+void exprEncoder::clear()
+{
+    sort_ids.clear();
+    decl_ids.clear();
+    term_ids.clear();
+    sorts.clear();
+    decls.clear();
+    terms.clear();
+}
+
+exprDecoder::exprDecoder(context &c) : ctx(c), sorts(c), decls(c), terms(c)
+{
+}
+
+void exprDecoder::know(expr const &fs)
+{
+    Z3_context c = fs.ctx();
+    std::set<unsigned> visited;
+    std::vector<expr> todo;
+    todo.push_back(fs);
+    while (!todo.empty())
+    {
+        expr e = todo.back();
+        todo.pop_back();
+        if (!e.is_app() || !visited.insert(Z3_get_ast_id(c, e)).second)
+            continue;
+        sort s = e.get_sort();
+        if (s.sort_kind() == Z3_UNINTERPRETED_SORT && s.name().kind() == Z3_STRING_SYMBOL)
+            known_sorts.insert(std::pair<std::string, sort>(s.name().str(), s));
+        unsigned num = e.num_args();
+        for (unsigned i = 0; i < num; i++)
+            todo.push_back(e.arg(i));
+    }
+}
+
+bool exprDecoder::get_symbol(binReader &in, symbol &sym)
+{
+    unsigned kind;
+    if (!in.get(kind))
+        return false;
+    if (kind == 0)
+    {
+        std::string name;
+        if (!in.get(name))
+            return false;
+        sym = ctx.str_symbol(name.c_str());
+        return true;
+    }
+    unsigned num;
+    if (kind != 1 || !in.get(num))
+        return false;
+    sym = ctx.int_symbol(num);
+    return true;
+}
+
+bool exprDecoder::read(binReader &table)
+{
+    unsigned num;
+    binReader in(NULL, 0);
+    sorts = sort_vector(ctx);
+    decls = func_decl_vector(ctx);
+    terms = expr_vector(ctx);
+
+    // sorts
+    if (!table.get(num) || !table.get_block(in))
+        return false;
+    for (unsigned i = 0; i < num; i++)
+    {
+        unsigned kind;
+        if (!in.get(kind))
+            return false;
+        if (kind == 0)
+        {
+            sorts.push_back(ctx.bool_sort());
+            continue;
+        }
+        symbol name(ctx, Z3_mk_int_symbol(ctx, 0));
+        if (kind != 1 || !get_symbol(in, name))
+            return false;
+        std::map<std::string, sort>::iterator it = known_sorts.end();
+        if (name.kind() == Z3_STRING_SYMBOL)
+            it = known_sorts.find(name.str());
+        if (it != known_sorts.end())
+            sorts.push_back(it->second);
+        else
+            sorts.push_back(sort(ctx, Z3_mk_uninterpreted_sort(ctx, name)));
+    }
+
+    // declarations
+    if (!table.get(num) || !table.get_block(in))
+        return false;
+    std::vector<Z3_sort> domain;
+    for (unsigned i = 0; i < num; i++)
+    {
+        symbol name(ctx, Z3_mk_int_symbol(ctx, 0));
+        unsigned arity, range;
+        if (!get_symbol(in, name) || !in.get(arity))
+            return false;
+        domain.resize(arity);
+        for (unsigned j = 0; j < arity; j++)
+        {
+            unsigned sort_index;
+            if (!in.get(sort_index) || sort_index >= sorts.size())
+                return false;
+            domain[j] = sorts[sort_index];
+        }
+        if (!in.get(range) || range >= sorts.size())
+            return false;
+        Z3_func_decl d = Z3_mk_func_decl(ctx, name, arity, arity > 0 ? &domain[0] : NULL, sorts[range]);
+        if (d == NULL)
+            return false;
+        decls.push_back(func_decl(ctx, d));
+    }
+
+    // terms
+    if (!table.get(num) || !table.get_block(in))
+        return false;
+    std::vector<Z3_ast> args;
+    for (unsigned i = 0; i < num; i++)
+    {
+        unsigned op, arg_num, decl_index = 0;
+        if (!in.get(op))
+            return false;
+        if (op == 0)
+        {
+            if (!in.get(decl_index) || decl_index >= decls.size())
+                return false;
+            arg_num = decls[decl_index].arity();
+        }
+        else if (!in.get(arg_num))
+            return false;
+        args.resize(arg_num);
+        for (unsigned j = 0; j < arg_num; j++)
+        {
+            unsigned back;
+            if (!in.get(back) || back == 0 || back > i)
+                return false;
+            args[j] = terms[i - back];
+        }
+        Z3_ast *arg_ptr = arg_num > 0 ? &args[0] : NULL;
+        Z3_ast term = NULL;
+        switch (op)
+        {
+        case 0:
+            term = Z3_mk_app(ctx, decls[decl_index], arg_num, arg_ptr);
+            break;
+        case PZ3_op_true:
+            term = (arg_num == 0) ? Z3_mk_true(ctx) : NULL;
+            break;
+        case PZ3_op_false:
+            term = (arg_num == 0) ? Z3_mk_false(ctx) : NULL;
+            break;
+        case PZ3_op_not:
+            term = (arg_num == 1) ? Z3_mk_not(ctx, args[0]) : NULL;
+            break;
+        case PZ3_op_and:
+            term = (arg_num > 0) ? Z3_mk_and(ctx, arg_num, arg_ptr) : NULL;
+            break;
+        case PZ3_op_or:
+            term = (arg_num > 0) ? Z3_mk_or(ctx, arg_num, arg_ptr) : NULL;
+            break;
+        case PZ3_op_implies:
+            term = (arg_num == 2) ? Z3_mk_implies(ctx, args[0], args[1]) : NULL;
+            break;
+        case PZ3_op_iff:
+            term = (arg_num == 2) ? Z3_mk_iff(ctx, args[0], args[1]) : NULL;
+            break;
+        case PZ3_op_xor:
+            term = (arg_num == 2) ? Z3_mk_xor(ctx, args[0], args[1]) : NULL;
+            break;
+        case PZ3_op_eq:
+            term = (arg_num == 2) ? Z3_mk_eq(ctx, args[0], args[1]) : NULL;
+            break;
+        case PZ3_op_distinct:
+            term = (arg_num > 0) ? Z3_mk_distinct(ctx, arg_num, arg_ptr) : NULL;
+            break;
+        case PZ3_op_ite:
+            term = (arg_num == 3) ? Z3_mk_ite(ctx, args[0], args[1], args[2]) : NULL;
+            break;
+        default:
+            break;
+        }
+        // arguments of wrong sorts are refused by Z3
+        if (term == NULL || Z3_get_error_code(ctx) != Z3_OK)
+            return false;
+        terms.push_back(expr(ctx, term));
+    }
+    return true;
+}
+
+bool exprDecoder::get(binReader &in, expr &fs)
+{
+    unsigned index;
+    if (!in.get(index) || index >= terms.size())
+        return false;
+    fs = terms[index];
+    return true;
+}
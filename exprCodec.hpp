@@ -0,0 +1,186 @@
+#ifndef _EXPR_CODEC_H_
+#define _EXPR_CODEC_H_
+
+#include "core.hpp"
+#include "flatMap.hpp"
+#include <string>
+
+/*
+  Binary format of PZ3. A document is the magic "PZ3B", the version of the format, then sections:
+      <tag> <length of body> <body>
+  All numbers are unsigned LEB128 (7 bits per byte, low bits first), so small numbers take one byte.
+  A reader skips sections with tags it does not know, and refuses documents of a newer version.
+  Decompositions in the cache and messages between a solver and its workers are documents.
+*/
+#define PZ3_FORMAT_MAGIC "PZ3B"
+#define PZ3_FORMAT_VERSION 3
+
+// section tags
+typedef enum
+{
+    // expression table (see exprEncoder), then root indices
+    PZ3_sec_exprs = 1,
+    // key of a cache entry and checksum of the sections after it (see decompCache.hpp)
+    PZ3_sec_key,
+    // symbols of a decomposition by id: key (name and sorts, see symbolTable), function flag, arity, weight
+    PZ3_sec_symbols,
+    // variables and functions of every clause
+    PZ3_sec_clause_symbols,
+    // partition of every clause plus one, 0 for clauses of components solved on their own
+    PZ3_sec_dist,
+    // components solved on their own: core, clauses
+    PZ3_sec_components,
+    // configuration of a check: a line of a portfolio file, time limit in milliseconds
+    PZ3_sec_config,
+    // shared functions asked for in a model: number, then id and name of every function
+    PZ3_sec_shared_funcs,
+    // closures by id (see put(closure_list)): of shared variables (svexpr), or of the terms of a
+    // check by their index among its roots
+    PZ3_sec_svexpr,
+    // function instances with their values (see put(entry_list)): of shared functions (sfist), or
+    // the entries of shared functions in a model of a sub-formula
+    PZ3_sec_sfist,
+    // interpolants: expression table, then root indices
+    PZ3_sec_interpolants,
+    // result of a check (check_result of z3++)
+    PZ3_sec_result,
+    // why a message cannot be answered
+    PZ3_sec_error
+} PZ3_Section;
+
+// closure_list: closures by id, entry_list: function instances with values
+typedef std::vector<std::pair<unsigned, closure> > closure_list;
+typedef std::vector<model_entry> entry_list;
+
+// binWriter: appends fields to a buffer
+class binWriter
+{
+protected:
+    std::string buf;
+
+public:
+    void put(unsigned value);
+    void put(std::string const &value);
+    void put(closure value);
+    /* A sorted list of ids, as its length and the gaps between ids */
+    void put(symbol_list const &list);
+    /* Length, then id and closure of every pair */
+    void put(closure_list const &list);
+    /* Length, then function id, number of arguments, arguments and value of every instance */
+    void put(entry_list const &list);
+    /* A section: tag, length and the body written by another writer */
+    void put_section(unsigned tag, binWriter const &body);
+    /* The magic and the version */
+    void put_header();
+
+    std::string const &data() const
+    {
+        return buf;
+    }
+
+    void clear()
+    {
+        buf.clear();
+    }
+};
+
+// binReader: reads fields in the order they were written; any read past the end fails
+class binReader
+{
+protected:
+    char const *buf;
+    size_t len;
+    size_t pos;
+
+public:
+    binReader(std::string const &data);
+    binReader(char const *data, size_t size);
+    bool get(unsigned &value);
+    bool get(std::string &value);
+    bool get(closure &value);
+    bool get(symbol_list &list);
+    bool get(closure_list &list);
+    bool get(entry_list &list);
+    /* A string written by put, read in place */
+    bool get_block(binReader &body);
+    /* Next section: its tag and a reader over its body */
+    bool get_section(unsigned &tag, binReader &body);
+    /* Check the magic and the version */
+    bool get_header();
+    /* Body of the first section with tag from here on, without moving; false if there is none */
+    bool find_section(unsigned tag, binReader &body) const;
+
+    bool at_end() const
+    {
+        return pos == len;
+    }
+
+    size_t remaining() const
+    {
+        return len - pos;
+    }
+};
+
+/*
+  exprEncoder: table of the DAGs of formulas of one context. Every distinct sort, declaration and
+  term is written once, in the order they are first met, and terms refer to their arguments by the
+  distance back in the table. Terms of QF_UF are supported: Boolean connectives, equalities, ite,
+  distinct and uninterpreted functions and constants over Bool and uninterpreted sorts.
+      table: <sorts> <sort>* <decls> <decl>* <terms> <term>*
+      sort:  0 (Bool) | 1 <symbol> (uninterpreted)
+      decl:  <symbol> <arity> <sort>* <range sort>
+      term:  0 <decl> <arg>* | <op> <arg number> <arg>*
+      symbol: 0 <string> | 1 <number>
+  where op is one of PZ3_op_*.
+*/
+class exprEncoder
+{
+protected:
+    // Z3 ids of sorts, declarations and terms met so far, and their index in the table
+    flat_map<unsigned, unsigned> sort_ids;
+    flat_map<unsigned, unsigned> decl_ids;
+    flat_map<unsigned, unsigned> term_ids;
+    binWriter sorts;
+    binWriter decls;
+    binWriter terms;
+
+    bool add_sort(sort const &s, unsigned &index);
+    bool add_decl(func_decl const &d, unsigned &index);
+    static void put_symbol(binWriter &out, symbol const &sym);
+
+public:
+    exprEncoder();
+    /* Add the DAG of a formula and give the index of its root; false if it has unsupported terms */
+    bool add(expr const &fs, unsigned &root);
+    /* Write the table */
+    void write(binWriter &out);
+    void clear();
+};
+
+/*
+  exprDecoder: terms of a table written by exprEncoder, rebuilt in a context. An uninterpreted sort
+  made by Z3_mk_uninterpreted_sort is not the sort of the same name declared by the parser, so sorts
+  of formulas already in the context are told to the decoder first and reused by name.
+*/
+class exprDecoder
+{
+protected:
+    context &ctx;
+    std::map<std::string, sort> known_sorts;
+    sort_vector sorts;
+    func_decl_vector decls;
+    expr_vector terms;
+
+    bool get_symbol(binReader &in, symbol &sym);
+
+public:
+    exprDecoder(context &c);
+    /* Reuse the uninterpreted sorts of fs */
+    void know(expr const &fs);
+    /* Read a table in place of the one read before; false if it is malformed */
+    bool read(binReader &in);
+    /* Read a root index and give its term */
+    bool get(binReader &in, expr &fs);
+};
+
+#endif
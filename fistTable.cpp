@@ -0,0 +1,136 @@
+#include "fistTable.hpp"
+#include "flatMap.hpp"
+
+fist_table::fist_table()
+{
+    offsets.push_back(0);
+    index.assign(16, 0);
+    mask = 15;
+}
+
+unsigned fist_table::hash_key(unsigned func, closure const *dom, unsigned len)
+{
+    unsigned h = flat_mix(func) ^ len;
+    for (unsigned i = 0; i < len; i++)
+    {
+        h = flat_mix(h ^ dom[i].hash());
+    }
+    return h;
+}
+
+bool fist_table::same_key(unsigned id, unsigned func, closure const *dom, unsigned len) const
+{
+    if (funcs[id] != func)
+        return false;
+    unsigned start = offsets[id];
+    if (offsets[id + 1] - start != len)
+        return false;
+    for (unsigned i = 0; i < len; i++)
+    {
+        if (arena[start + i] != dom[i])
+            return false;
+    }
+    return true;
+}
+
+unsigned fist_table::probe(unsigned hash, unsigned func, closure const *dom, unsigned len) const
+{
+    unsigned slot = hash & mask;
+    while (index[slot] != 0)
+    {
+        unsigned id = index[slot] - 1;
+        if (hashes[id] == hash && same_key(id, func, dom, len))
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void fist_table::rehash(unsigned new_cap)
+{
+    index.assign(new_cap, 0);
+    mask = new_cap - 1;
+    unsigned num = funcs.size();
+    for (unsigned id = 0; id < num; id++)
+    {
+        unsigned slot = hashes[id] & mask;
+        while (index[slot] != 0)
+            slot = (slot + 1) & mask;
+        index[slot] = id + 1;
+    }
+}
+
+unsigned fist_table::intern(fist_key const &key, bool &is_new)
+{
+    unsigned func = key.get_func();
+    unsigned len = key.get_domain_length();
+    closure const *dom = key.get_domain();
+    unsigned hash = hash_key(func, dom, len);
+    unsigned slot = probe(hash, func, dom, len);
+    if (index[slot] != 0)
+    {
+        is_new = false;
+        return index[slot] - 1;
+    }
+    unsigned id = funcs.size();
+    funcs.push_back(func);
+    hashes.push_back(hash);
+    arena.insert(arena.end(), dom, dom + len);
+    offsets.push_back(arena.size());
+    index[slot] = id + 1;
+    // keep load factor below 1/2
+    if (funcs.size() * 2 > index.size())
+        rehash(index.size() * 2);
+    is_new = true;
+    return id;
+}
+
+bool fist_table::find(fist_key const &key, unsigned &id) const
+{
+    unsigned func = key.get_func();
+    unsigned len = key.get_domain_length();
+    closure const *dom = key.get_domain();
+    unsigned slot = probe(hash_key(func, dom, len), func, dom, len);
+    if (index[slot] == 0)
+        return false;
+    id = index[slot] - 1;
+    return true;
+}
+
+void fist_table::clear()
+{
+    // keep capacity of arena and index for the next round
+    funcs.clear();
+    hashes.clear();
+    arena.clear();
+    offsets.clear();
+    offsets.push_back(0);
+    index.assign(index.size(), 0);
+}
+
+void fist_table::reserve(unsigned num, unsigned num_args)
+{
+    funcs.reserve(num);
+    hashes.reserve(num);
+    offsets.reserve(num + 1);
+    arena.reserve(num_args);
+    unsigned cap = index.size();
+    while (cap < num * 2)
+        cap <<= 1;
+    if (cap != index.size())
+        rehash(cap);
+}
+
+std::ostream &operator<<(std::ostream &out, const func_inst &rhs)
+{
+    unsigned len = rhs.get_domain_length();
+    out << rhs.get_func() << "(";
+    for (unsigned i = 0; i < len; i++)
+    {
+        if (i > 0)
+            out << ",";
+        out << rhs[i];
+    }
+    out << ")";
+    return out;
+}
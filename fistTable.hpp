@@ -0,0 +1,206 @@
+#ifndef _FIST_TABLE_H_
+#define _FIST_TABLE_H_
+
+#include "core.hpp"
+
+class fist_table;
+class func_inst;
+
+// fist_key: scratch key for building, looking up and interning a function instance
+// The domain buffer is reused by reset(), so building keys in a loop does not allocate.
+class fist_key
+{
+protected:
+    unsigned func;
+    std::vector<closure> domain;
+
+public:
+    fist_key()
+    {
+        func = 0;
+    }
+
+    void reset(unsigned fun_id)
+    {
+        func = fun_id;
+        domain.clear();
+    }
+
+    void push(closure clo)
+    {
+        domain.push_back(clo);
+    }
+
+    inline void set(func_inst const &fist);
+
+    unsigned get_func() const
+    {
+        return func;
+    }
+
+    unsigned get_domain_length() const
+    {
+        return domain.size();
+    }
+
+    closure const *get_domain() const
+    {
+        return domain.empty() ? NULL : &domain[0];
+    }
+};
+
+// func_inst: handle of a function instance interned in a fist_table
+// Handles from the same table are compared by id only.
+class func_inst
+{
+protected:
+    fist_table const *table;
+    unsigned id;
+
+public:
+    func_inst(fist_table const *tab, unsigned fist_id)
+    {
+        table = tab;
+        id = fist_id;
+    }
+
+    unsigned get_id() const
+    {
+        return id;
+    }
+
+    inline unsigned get_func() const;
+    inline unsigned get_domain_length() const;
+    inline closure operator[](unsigned i) const;
+
+    friend bool operator<(const func_inst &lhs, const func_inst &rhs)
+    {
+        return lhs.id < rhs.id;
+    }
+
+    friend bool operator==(const func_inst &lhs, const func_inst &rhs)
+    {
+        return lhs.table == rhs.table && lhs.id == rhs.id;
+    }
+
+    friend std::ostream &operator<<(std::ostream &out, const func_inst &rhs);
+};
+
+// fist_table: interning table of function instances
+// Arguments of all instances are stored contiguously in one arena; an instance is
+// identified by a dense id. Lookup goes through an open-addressing index over the arena.
+class fist_table
+{
+protected:
+    std::vector<unsigned> funcs;
+    // arguments of instance i are arena[offsets[i]] .. arena[offsets[i + 1] - 1]
+    std::vector<unsigned> offsets;
+    std::vector<closure> arena;
+    std::vector<unsigned> hashes;
+    // index: id + 1 of an instance, 0 marks an empty slot
+    std::vector<unsigned> index;
+    unsigned mask;
+
+    static unsigned hash_key(unsigned func, closure const *dom, unsigned len);
+    bool same_key(unsigned id, unsigned func, closure const *dom, unsigned len) const;
+    unsigned probe(unsigned hash, unsigned func, closure const *dom, unsigned len) const;
+    void rehash(unsigned new_cap);
+
+public:
+    fist_table();
+
+    /* Intern an instance; is_new is set when the instance was not in the table */
+    unsigned intern(fist_key const &key, bool &is_new);
+
+    /* Look up an instance; return false if it is not interned */
+    bool find(fist_key const &key, unsigned &id) const;
+
+    void clear();
+    void reserve(unsigned num, unsigned num_args);
+
+    unsigned size() const
+    {
+        return funcs.size();
+    }
+
+    func_inst get(unsigned id) const
+    {
+        return func_inst(this, id);
+    }
+
+    unsigned get_func(unsigned id) const
+    {
+        return funcs[id];
+    }
+
+    unsigned get_domain_length(unsigned id) const
+    {
+        return offsets[id + 1] - offsets[id];
+    }
+
+    closure get_arg(unsigned id, unsigned i) const
+    {
+        return arena[offsets[id] + i];
+    }
+};
+
+// fist_map: function instances interned in a fist_table with a value per instance
+template <class V>
+class fist_map : public fist_table
+{
+protected:
+    std::vector<V> values;
+
+public:
+    // same semantics as std::map::insert: an existing value is not overwritten
+    std::pair<unsigned, bool> insert(fist_key const &key, V const &val)
+    {
+        bool is_new = false;
+        unsigned id = intern(key, is_new);
+        if (is_new)
+            values.push_back(val);
+        return std::pair<unsigned, bool>(id, is_new);
+    }
+
+    V &value(unsigned id)
+    {
+        return values[id];
+    }
+
+    void clear()
+    {
+        fist_table::clear();
+        values.clear();
+    }
+};
+
+unsigned func_inst::get_func() const
+{
+    return table->get_func(id);
+}
+
+unsigned func_inst::get_domain_length() const
+{
+    return table->get_domain_length(id);
+}
+
+closure func_inst::operator[](unsigned i) const
+{
+    if (i < table->get_domain_length(id))
+        return table->get_arg(id, i);
+    // unexpected case below
+    closure zero_clo;
+    return zero_clo;
+}
+
+void fist_key::set(func_inst const &fist)
+{
+    unsigned len = fist.get_domain_length();
+    reset(fist.get_func());
+    for (unsigned i = 0; i < len; i++)
+    {
+        domain.push_back(fist[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef _FLAT_MAP_H_
+#define _FLAT_MAP_H_
+
+#include <vector>
+#include <string>
+#include <utility>
+
+// mix bits of a 32-bit key so that linear probing works well on hash values of Z3 objects
+inline unsigned flat_mix(unsigned h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// default hasher: keys provide their own hash()
+template <class K>
+struct flat_hash
+{
+    unsigned operator()(K const &key) const
+    {
+        return flat_mix(key.hash());
+    }
+};
+
+template <>
+struct flat_hash<unsigned>
+{
+    unsigned operator()(unsigned key) const
+    {
+        return flat_mix(key);
+    }
+};
+
+template <>
+struct flat_hash<int>
+{
+    unsigned operator()(int key) const
+    {
+        return flat_mix((unsigned) key);
+    }
+};
+
+template <>
+struct flat_hash<std::string>
+{
+    unsigned operator()(std::string const &key) const
+    {
+        // FNV-1a
+        unsigned h = 2166136261u;
+        unsigned len = key.size();
+        for (unsigned i = 0; i < len; i++)
+        {
+            h ^= (unsigned char) key[i];
+            h *= 16777619u;
+        }
+        return flat_mix(h);
+    }
+};
+
+// flat_map: open-addressing hash map
+// Entries are stored densely in insertion order, while an index table of power-of-two size
+// maps hash slots to entry positions (linear probing). Iteration walks the dense entry array.
+// Erasing single entries is not supported; use clear() to reuse the map.
+template <class K, class V, class H = flat_hash<K> >
+class flat_map
+{
+public:
+    typedef std::pair<K, V> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+protected:
+    std::vector<value_type> entries;
+    // index: position + 1 of an entry, 0 marks an empty slot
+    std::vector<unsigned> index;
+    unsigned mask;
+    H hasher;
+
+    void rehash(unsigned new_cap)
+    {
+        index.assign(new_cap, 0);
+        mask = new_cap - 1;
+        unsigned len = entries.size();
+        for (unsigned i = 0; i < len; i++)
+        {
+            unsigned slot = hasher(entries[i].first) & mask;
+            while (index[slot] != 0)
+                slot = (slot + 1) & mask;
+            index[slot] = i + 1;
+        }
+    }
+
+    // locate the slot of key, or the empty slot where it should be placed
+    unsigned probe(K const &key) const
+    {
+        unsigned slot = hasher(key) & mask;
+        while (index[slot] != 0 && !(entries[index[slot] - 1].first == key))
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+public:
+    flat_map()
+    {
+        index.assign(16, 0);
+        mask = 15;
+    }
+
+    unsigned size() const
+    {
+        return entries.size();
+    }
+
+    bool empty() const
+    {
+        return entries.empty();
+    }
+
+    void clear()
+    {
+        // keep capacity for the next round
+        entries.clear();
+        index.assign(index.size(), 0);
+    }
+
+    void reserve(unsigned num)
+    {
+        entries.reserve(num);
+        unsigned cap = index.size();
+        while (cap < num * 2)
+            cap <<= 1;
+        if (cap != index.size())
+            rehash(cap);
+    }
+
+    iterator begin()
+    {
+        return entries.begin();
+    }
+
+    iterator end()
+    {
+        return entries.end();
+    }
+
+    const_iterator begin() const
+    {
+        return entries.begin();
+    }
+
+    const_iterator end() const
+    {
+        return entries.end();
+    }
+
+    iterator find(K const &key)
+    {
+        unsigned pos = index[probe(key)];
+        if (pos == 0)
+            return entries.end();
+        return entries.begin() + (pos - 1);
+    }
+
+    const_iterator find(K const &key) const
+    {
+        unsigned pos = index[probe(key)];
+        if (pos == 0)
+            return entries.end();
+        return entries.begin() + (pos - 1);
+    }
+
+    // same semantics as std::map::insert: an existing entry is not overwritten
+    std::pair<iterator, bool> insert(value_type const &val)
+    {
+        unsigned slot = probe(val.first);
+        if (index[slot] != 0)
+            return std::pair<iterator, bool>(entries.begin() + (index[slot] - 1), false);
+        entries.push_back(val);
+        index[slot] = entries.size();
+        // keep load factor below 1/2
+        if (entries.size() * 2 > index.size())
+            rehash(index.size() * 2);
+        return std::pair<iterator, bool>(entries.end() - 1, true);
+    }
+
+    V &operator[](K const &key)
+    {
+        return (insert(value_type(key, V())).first)->second;
+    }
+};
+
+#endif
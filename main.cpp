@@ -0,0 +1,205 @@
+#include "pz3Solver.hpp"
+#include "batchMode.hpp"
+#include "serveMode.hpp"
+#include "scriptMode.hpp"
+#include <climits>
+#include <unistd.h>
+
+// arguments from command prompt
+// batch_mode: file_path is a list of files, results are written to batch_out (stdout if empty)
+// script_mode: file_path is a script checked incrementally, one result per check-sat
+// stats_path: file of statistics (a line of JSON per check), "-" for stderr
+std::string file_path;
+std::string portfolio_path;
+std::string stats_path;
+bool batch_mode = false;
+bool script_mode = false;
+std::string batch_out;
+pz3::Options options;
+
+int main(int argc, char *argv[])
+{
+    // a worker process started by a solver with --processes (see workerProcess.hpp)
+    if (argc == 3 && std::string(argv[1]) == "--worker")
+    {
+        return workerProcess::serve(atoi(argv[2]));
+    }
+    // --processes, --incremental, --race, --stats, --counters, --trace, --max-memory and the cache
+    // options go before other arguments
+    while (argc > 1)
+    {
+        std::string opt(argv[1]);
+        int used = 1;
+        if (opt == "--processes")
+        {
+            // workers are started from this executable
+            char exe[PATH_MAX];
+            ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+            if (len > 0)
+                options.worker_path = std::string(exe, len);
+            options.processes = true;
+        }
+        else if (opt == "--incremental")
+            script_mode = true;
+        else if (opt == "--race")
+            options.race = true;
+        else if (opt == "--stats" && argc > 2)
+        {
+            options.stats = true;
+            stats_path = argv[2];
+            used = 2;
+        }
+        else if (opt == "--counters")
+            options.counters = true;
+        else if (opt == "--trace" && argc > 2)
+        {
+            options.trace_path = argv[2];
+            used = 2;
+        }
+        else if (opt == "--max-memory" && argc > 2)
+        {
+            options.max_memory_mb = atoi(argv[2]);
+            used = 2;
+        }
+        else if (opt == "--cache" && argc > 2)
+        {
+            options.cache_dir = argv[2];
+            used = 2;
+        }
+        else if (opt == "--cache-limit" && argc > 2)
+        {
+            options.cache_mb = atoi(argv[2]);
+            used = 2;
+        }
+        else
+            break;
+        argv[used] = argv[0];
+        argv += used;
+        argc -= used;
+    }
+    // server mode: one sequential solver per worker, no cores to share
+    if (argc == 4 && std::string(argv[1]) == "--serve")
+    {
+        int worker_num = atoi(argv[3]);
+        if (worker_num <= 0)
+        {
+            std::cerr << "Invalid worker number!\n";
+            exit(1);
+        }
+        return solve_serve(argv[2], worker_num);
+    }
+    if (argc < 3 || argc > 5 || (argc == 5 && std::string(argv[1]) != "--batch"))
+    {
+        usage(argv[0]);
+    }
+    get_args(argc, argv);
+
+    if (options.core_num <= 0)
+    {
+        std::cerr << "Invalid core number!\n";
+        exit(1);
+    }
+    pz3::Solver solver(options);
+    if (!portfolio_path.empty() && !solver.get_portfolio().load(portfolio_path))
+    {
+        std::cerr << "Portfolio file doesn't exist.\n";
+        exit(1);
+    }
+#ifndef PZ3_ONECORE
+    if (options.core_num > 1)
+    {
+        solver.get_topology().report(std::cerr);
+    }
+#endif
+
+    if (batch_mode)
+    {
+        int rc = solve_batch(file_path, batch_out, solver);
+        solver.get_portfolio().report(std::cerr);
+        solver.get_cache().report(std::cerr);
+        return rc;
+    }
+
+    std::ofstream stats_file;
+    std::ostream *stats_out = NULL;
+    if (!stats_path.empty())
+    {
+        if (stats_path != "-")
+        {
+            stats_file.open(stats_path.c_str());
+            if (!stats_file)
+            {
+                std::cerr << "Statistics file cannot be written.\n";
+                exit(1);
+            }
+        }
+        stats_out = (stats_path == "-") ? &std::cerr : &stats_file;
+    }
+
+    if (script_mode)
+    {
+        int rc = solve_script(file_path, solver, stats_out);
+        solver.get_portfolio().report(std::cerr);
+        return rc;
+    }
+
+    pz3::Result result = solver.solve_file(file_path);
+    if (stats_out != NULL)
+        solver.write_stats(*stats_out, result);
+    if (result.error)
+    {
+        std::cerr << result.message << "\n";
+        // the solver writes its trace when it is destroyed
+        return 1;
+    }
+    solver.get_portfolio().report(std::cerr);
+    solver.get_cache().report(std::cerr);
+
+    switch (result.status)
+    {
+    case PZ3_unsat:
+        std::cout << "unsat\n";
+        break;
+    case PZ3_sat:
+        std::cout << "sat\n";
+        break;
+    default:
+        std::cout << "unknown\n";
+    }
+    return 0;
+}
+
+void usage(char const *prog_name)
+{
+    std::cerr << "Usage: " << prog_name << " [--processes] [--race] [--cache dir] [--cache-limit MB] [--max-memory MB] ";
+    std::cerr << "[--stats file [--counters]] [--trace file] ";
+    std::cerr << "[Path of smtlib file] [Number of cores] [Path of portfolio file (optional)]\n";
+    std::cerr << "       " << prog_name << " --incremental [--race] [--stats file [--counters]] [--trace file] ";
+    std::cerr << "[Path of smtlib script] [Number of cores] [Path of portfolio file (optional)]\n";
+    std::cerr << "       " << prog_name << " [--processes] [--race] [--cache dir] [--cache-limit MB] [--max-memory MB] --batch ";
+    std::cerr << "[Path of file list] [Number of cores] [Path of result file (optional)]\n";
+    std::cerr << "       " << prog_name << " --serve ";
+    std::cerr << "[Path of socket] [Number of workers]\n";
+    exit(1);
+}
+
+void get_args(int argc, char *const argv[])
+{
+    if (std::string(argv[1]) == "--batch")
+    {
+        if (argc < 4)
+            usage(argv[0]);
+        batch_mode = true;
+        file_path = std::string(argv[2]);
+        options.core_num = atoi(argv[3]);
+        if (argc > 4)
+            batch_out = std::string(argv[4]);
+        return;
+    }
+    file_path = std::string(argv[1]);
+    options.core_num = atoi(argv[2]);
+    if (argc > 3)
+    {
+        portfolio_path = std::string(argv[3]);
+    }
+}
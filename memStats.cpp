@@ -0,0 +1,54 @@
+#include "memStats.hpp"
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <pthread.h>
+
+// instances running in the process and instances started so far, over all solvers
+static pthread_mutex_t peak_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned active_num = 0;
+static unsigned long started_num = 0;
+
+bool memStats::sample(mem_sample &s)
+{
+    s = mem_sample();
+    std::ifstream file("/proc/self/status");
+    if (!file)
+        return false;
+    // lines such as "VmRSS:\t  123456 kB"
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            s.rss_kb = atol(line.c_str() + 6);
+        else if (line.compare(0, 6, "VmHWM:") == 0)
+            s.peak_kb = atol(line.c_str() + 6);
+    }
+    return s.rss_kb > 0;
+}
+
+bool memStats::reset_peak()
+{
+    std::ofstream file("/proc/self/clear_refs");
+    if (!file)
+        return false;
+    file << "5" << std::endl;
+    return !file.fail();
+}
+
+void memStats::begin(peak_scope &scope)
+{
+    pthread_mutex_lock(&peak_mutex);
+    active_num++;
+    scope.ticket = ++started_num;
+    scope.alone = active_num == 1 && reset_peak();
+    pthread_mutex_unlock(&peak_mutex);
+}
+
+void memStats::end(peak_scope &scope)
+{
+    pthread_mutex_lock(&peak_mutex);
+    scope.alone = scope.alone && started_num == scope.ticket;
+    active_num--;
+    pthread_mutex_unlock(&peak_mutex);
+}
@@ -0,0 +1,53 @@
+#ifndef _MEM_STATS_H_
+#define _MEM_STATS_H_
+
+// mem_sample: memory of the process in KB, the resident set now and its high-water mark
+struct mem_sample
+{
+    long rss_kb;
+    long peak_kb;
+
+    mem_sample()
+    {
+        rss_kb = 0;
+        peak_kb = 0;
+    }
+};
+
+// peak_scope: an instance measured by the high-water mark, alone if no other one ran meanwhile
+struct peak_scope
+{
+    bool alone;
+    unsigned long ticket;
+
+    peak_scope()
+    {
+        alone = false;
+        ticket = 0;
+    }
+};
+
+/*
+  memStats: resident memory of the process, read from /proc/self/status. Partitions are threads of
+  one process, so memory is not told apart per thread: samples taken at the end of phases show which
+  phase the process grows in. Where /proc cannot be read, samples are 0 and left out of the output.
+  The high-water mark is one for the process, and restarting it is too, so it is restarted only for
+  an instance which no other solver of the process is running beside; the peak of any other
+  instance is the one of the process.
+*/
+class memStats
+{
+public:
+    /* Resident set of the process now; false if it cannot be read */
+    static bool sample(mem_sample &s);
+    /* An instance starts: restart the high-water mark if no other one is running */
+    static void begin(peak_scope &scope);
+    /* The instance is done: it stays alone if no other instance started while it ran */
+    static void end(peak_scope &scope);
+
+protected:
+    /* Restart the high-water mark from the resident set now (Linux 4.0 and later); false if it cannot */
+    static bool reset_peak();
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "perfCounters.hpp"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <cstring>
+#include <stdint.h>
+
+static char const *counter_names[PZ3_counter_num] =
+{
+    "cycles", "instructions", "llc_misses", "branch_misses", "context_switches"
+};
+
+// usable: the counter could be opened by probe(), user_only: only with the kernel excluded
+static bool usable[PZ3_counter_num];
+static bool user_only[PZ3_counter_num];
+static pthread_once_t probe_once = PTHREAD_ONCE_INIT;
+// key of the descriptors of the calling thread
+static pthread_key_t fd_key;
+
+static void counter_attr(PZ3_Counter counter, bool exclude_kernel, perf_event_attr &attr)
+{
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (counter)
+    {
+    case PZ3_counter_cycles:
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PZ3_counter_instructions:
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PZ3_counter_llc_misses:
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case PZ3_counter_branch_misses:
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    default:
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+    }
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+// open a counter of the calling thread on any CPU, -1 if it cannot be opened
+static int open_counter(PZ3_Counter counter, bool exclude_kernel)
+{
+    perf_event_attr attr;
+    counter_attr(counter, exclude_kernel, attr);
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void close_fds(void *arg)
+{
+    int *fds = (int *) arg;
+    for (unsigned i = 0; i < PZ3_counter_num; i++)
+    {
+        if (fds[i] >= 0)
+            close(fds[i]);
+    }
+    delete[] fds;
+}
+
+static void probe_counters()
+{
+    pthread_key_create(&fd_key, close_fds);
+    for (unsigned i = 0; i < PZ3_counter_num; i++)
+    {
+        // counting in the kernel is not allowed unless perf_event_paranoid is below 2
+        user_only[i] = false;
+        int fd = open_counter((PZ3_Counter) i, false);
+        if (fd < 0)
+        {
+            user_only[i] = true;
+            fd = open_counter((PZ3_Counter) i, true);
+        }
+        usable[i] = (fd >= 0);
+        if (fd >= 0)
+            close(fd);
+    }
+}
+
+bool perfCounters::probe()
+{
+    pthread_once(&probe_once, probe_counters);
+    for (unsigned i = 0; i < PZ3_counter_num; i++)
+    {
+        if (usable[i])
+            return true;
+    }
+    return false;
+}
+
+bool perfCounters::available(PZ3_Counter counter)
+{
+    return usable[counter];
+}
+
+void perfCounters::read(counter_reading &values)
+{
+    int *fds = (int *) pthread_getspecific(fd_key);
+    if (fds == NULL)
+    {
+        fds = new int[PZ3_counter_num];
+        for (unsigned i = 0; i < PZ3_counter_num; i++)
+        {
+            fds[i] = usable[i] ? open_counter((PZ3_Counter) i, user_only[i]) : -1;
+        }
+        pthread_setspecific(fd_key, fds);
+    }
+    for (unsigned i = 0; i < PZ3_counter_num; i++)
+    {
+        // value, time enabled, time running
+        uint64_t data[3] = {0, 0, 0};
+        values.valid[i] = fds[i] >= 0 && ::read(fds[i], data, sizeof(data)) == sizeof(data);
+        values.value[i] = data[0];
+        values.enabled[i] = data[1];
+        values.running[i] = data[2];
+    }
+}
+
+void perfCounters::add(counter_set &sum, counter_reading const &start, counter_reading const &end)
+{
+    for (unsigned i = 0; i < PZ3_counter_num; i++)
+    {
+        long long value = end.value[i] - start.value[i];
+        long long enabled = end.enabled[i] - start.enabled[i];
+        long long running = end.running[i] - start.running[i];
+        if (!start.valid[i] || !end.valid[i] || (running <= 0 && enabled > 0))
+            sum.valid[i] = false;
+        else if (running > 0)
+            sum.value[i] += (running < enabled) ? (long long) ((double) value * enabled / running) : value;
+    }
+}
+
+char const *perfCounters::name(PZ3_Counter counter)
+{
+    return counter_names[counter];
+}
@@ -0,0 +1,66 @@
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+typedef enum
+{
+    PZ3_counter_cycles,
+    PZ3_counter_instructions,
+    // misses of the last level cache
+    PZ3_counter_llc_misses,
+    PZ3_counter_branch_misses,
+    PZ3_counter_context_switches,
+    PZ3_counter_num
+} PZ3_Counter;
+
+// counter_set: a value of every counter, and whether it is known (see perfCounters::add)
+struct counter_set
+{
+    long long value[PZ3_counter_num];
+    bool valid[PZ3_counter_num];
+
+    counter_set()
+    {
+        for (unsigned i = 0; i < PZ3_counter_num; i++)
+        {
+            value[i] = 0;
+            valid[i] = true;
+        }
+    }
+};
+
+/*
+  counter_reading: what a thread read from its counters, with the time each one was enabled and
+  the time it was running on the PMU (in nanoseconds). valid is false for a counter which this
+  thread could not open or read.
+*/
+struct counter_reading
+{
+    long long value[PZ3_counter_num];
+    long long enabled[PZ3_counter_num];
+    long long running[PZ3_counter_num];
+    bool valid[PZ3_counter_num];
+};
+
+/*
+  perfCounters: counters of the calling thread, read through Linux perf_event_open. Every thread
+  opens its counters the first time it reads them, and they are closed when the thread exits.
+  Counters which cannot be opened here (no PMU in a virtual machine or container, or denied by
+  perf_event_paranoid) are left out: probe() finds them once. When there are more counters than
+  the PMU has, the kernel takes turns with them, so a count is scaled by the time its counter was
+  enabled over the time it was running. A counter which a thread could not open, or which never
+  ran while enabled, is not known for the phase it was read in.
+*/
+class perfCounters
+{
+public:
+    /* Find the counters which can be opened; false if there is none */
+    static bool probe();
+    static bool available(PZ3_Counter counter);
+    /* Current readings of the counters of the calling thread */
+    static void read(counter_reading &values);
+    /* Add the scaled counts between two readings to sum, or mark them unknown in it */
+    static void add(counter_set &sum, counter_reading const &start, counter_reading const &end);
+    static char const *name(PZ3_Counter counter);
+};
+
+#endif
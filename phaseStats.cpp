@@ -0,0 +1,235 @@
+#include "phaseStats.hpp"
+
+static char const *phase_names[PZ3_phase_num] =
+{
+    "division", "cnf", "distribution", "subsolve", "localization", "form", "solve", "interpolation",
+    "translation", "ssr"
+};
+
+phaseStats::phaseStats()
+{
+    on = false;
+    counting = false;
+    trace = NULL;
+}
+
+void phaseStats::reset(unsigned thread_num, bool enable, bool count)
+{
+    on = enable;
+    counting = enable && count;
+    rows.clear();
+    if (on)
+        rows.resize(thread_num);
+}
+
+void phaseStats::add(unsigned thread, unsigned round, PZ3_Phase phase, long long ns, long rss_kb,
+                     counter_set const *counted)
+{
+    std::vector<phase_row> &my_rows = rows.at(thread);
+    if (my_rows.size() <= round)
+        my_rows.resize(round + 1);
+    my_rows[round].ns[phase] += ns;
+    my_rows[round].count[phase]++;
+    if (rss_kb > my_rows[round].rss_kb[phase])
+        my_rows[round].rss_kb[phase] = rss_kb;
+    if (counted == NULL)
+        return;
+    counter_set &sum = my_rows[round].counters[phase];
+    for (unsigned i = 0; i < PZ3_counter_num; i++)
+    {
+        sum.value[i] += counted->value[i];
+        sum.valid[i] = sum.valid[i] && counted->valid[i];
+    }
+}
+
+void phaseStats::add_solver(unsigned thread, unsigned round, PZ3_Phase phase, solver_counts const &counts)
+{
+    std::vector<phase_row> &my_rows = rows.at(thread);
+    if (my_rows.size() <= round)
+        my_rows.resize(round + 1);
+    solver_counts &sum = my_rows[round].solver[phase];
+    for (solver_counts::const_iterator it = counts.begin(); it != counts.end(); ++it)
+    {
+        sum[it->first] += it->second;
+    }
+}
+
+bool phaseStats::samples_memory(PZ3_Phase phase)
+{
+    // division and subsolve end the stages before conciliation, solve and ssr the ones of a round
+    return phase == PZ3_phase_division || phase == PZ3_phase_subsolve || phase == PZ3_phase_solve ||
+           phase == PZ3_phase_ssr;
+}
+
+char const *phaseStats::name(PZ3_Phase phase)
+{
+    return phase_names[phase];
+}
+
+// "counters":{"cycles":123,...} with counters which are known
+static void write_counters(std::ostream &out, counter_set const &counted)
+{
+    out << "\"counters\":{";
+    bool first = true;
+    for (unsigned i = 0; i < PZ3_counter_num; i++)
+    {
+        if (!perfCounters::available((PZ3_Counter) i) || !counted.valid[i])
+            continue;
+        if (!first)
+            out << ",";
+        first = false;
+        out << "\"" << perfCounters::name((PZ3_Counter) i) << "\":" << counted.value[i];
+    }
+    out << "}";
+}
+
+// "z3":{"conflicts":12,...}, with whole numbers written as such
+static void write_solver(std::ostream &out, solver_counts const &counts)
+{
+    out << "\"z3\":{";
+    for (solver_counts::const_iterator it = counts.begin(); it != counts.end(); ++it)
+    {
+        if (it != counts.begin())
+            out << ",";
+        out << "\"" << it->first << "\":";
+        long long whole = (long long) it->second;
+        if (whole == it->second)
+            out << whole;
+        else
+            out << it->second;
+    }
+    out << "}";
+}
+
+/*
+  "phases":{"solve":{"ms":1.5,"count":2,"rss_mb":80.5},...} with phases which happened; max_ns is
+  written if given, counters if counting, and statistics of solvers if any was checked
+*/
+static void write_row(std::ostream &out, phase_row const &row, long long const *max_ns, bool counting)
+{
+    out << "\"phases\":{";
+    bool first = true;
+    for (unsigned i = 0; i < PZ3_phase_num; i++)
+    {
+        if (row.count[i] == 0)
+            continue;
+        if (!first)
+            out << ",";
+        first = false;
+        out << "\"" << phase_names[i] << "\":{\"ms\":" << row.ns[i] / 1e6 << ",\"count\":" << row.count[i];
+        if (row.rss_kb[i] > 0)
+            out << ",\"rss_mb\":" << row.rss_kb[i] / 1024.0;
+        if (max_ns != NULL)
+            out << ",\"max_ms\":" << max_ns[i] / 1e6;
+        if (counting)
+        {
+            out << ",";
+            write_counters(out, row.counters[i]);
+        }
+        if (!row.solver[i].empty())
+        {
+            out << ",";
+            write_solver(out, row.solver[i]);
+        }
+        out << "}";
+    }
+    out << "}";
+}
+
+static void add_row(phase_row &sum, phase_row const &row)
+{
+    for (unsigned i = 0; i < PZ3_phase_num; i++)
+    {
+        sum.ns[i] += row.ns[i];
+        sum.count[i] += row.count[i];
+        if (row.rss_kb[i] > sum.rss_kb[i])
+            sum.rss_kb[i] = row.rss_kb[i];
+        for (unsigned c = 0; c < PZ3_counter_num; c++)
+        {
+            sum.counters[i].value[c] += row.counters[i].value[c];
+            sum.counters[i].valid[c] = sum.counters[i].valid[c] && row.counters[i].valid[c];
+        }
+        for (solver_counts::const_iterator it = row.solver[i].begin(); it != row.solver[i].end(); ++it)
+        {
+            sum.solver[i][it->first] += it->second;
+        }
+    }
+}
+
+void phaseStats::write_json(std::ostream &out) const
+{
+    unsigned thread_num = rows.size();
+    unsigned round_num = 0;
+    for (unsigned t = 0; t < thread_num; t++)
+    {
+        if (rows[t].size() > round_num)
+            round_num = rows[t].size();
+    }
+    std::streamsize precision = out.precision(6);
+    std::ios_base::fmtflags flags = out.setf(std::ios_base::fixed, std::ios_base::floatfield);
+
+    phase_row total;
+    std::vector<phase_row> thread_total(thread_num);
+    for (unsigned t = 0; t < thread_num; t++)
+    {
+        for (unsigned r = 0; r < rows[t].size(); r++)
+            add_row(thread_total[t], rows[t][r]);
+        add_row(total, thread_total[t]);
+    }
+    out << "{";
+    write_row(out, total, NULL, counting);
+    if (counting)
+    {
+        // counters which could not be opened here are not in the list
+        out << ",\"counters\":[";
+        bool first = true;
+        for (unsigned i = 0; i < PZ3_counter_num; i++)
+        {
+            if (!perfCounters::available((PZ3_Counter) i))
+                continue;
+            if (!first)
+                out << ",";
+            first = false;
+            out << "\"" << perfCounters::name((PZ3_Counter) i) << "\"";
+        }
+        out << "]";
+    }
+
+    out << ",\"threads\":[";
+    for (unsigned t = 0; t < thread_num; t++)
+    {
+        if (t > 0)
+            out << ",";
+        out << "{\"thread\":" << t << ",\"role\":\"" << (t + 1 == thread_num ? "master" : "partition") << "\",";
+        write_row(out, thread_total[t], NULL, counting);
+        out << "}";
+    }
+
+    // the slowest thread of a round is the one the others wait for at its barrier
+    out << "],\"rounds\":[";
+    for (unsigned r = 1; r < round_num; r++)
+    {
+        phase_row sum;
+        long long max_ns[PZ3_phase_num] = {0};
+        for (unsigned t = 0; t < thread_num; t++)
+        {
+            if (r >= rows[t].size())
+                continue;
+            phase_row const &row = rows[t][r];
+            add_row(sum, row);
+            for (unsigned i = 0; i < PZ3_phase_num; i++)
+            {
+                if (row.ns[i] > max_ns[i])
+                    max_ns[i] = row.ns[i];
+            }
+        }
+        if (r > 1)
+            out << ",";
+        out << "{\"round\":" << r << ",";
+        write_row(out, sum, max_ns, counting);
+        out << "}";
+    }
+    out << "]}";
+    out.precision(precision);
+    out.flags(flags);
+}
@@ -0,0 +1,207 @@
+#ifndef _PHASE_STATS_H_
+#define _PHASE_STATS_H_
+
+#include "eventTrace.hpp"
+#include "perfCounters.hpp"
+#include "memStats.hpp"
+#include <boost/chrono.hpp>
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+
+typedef enum
+{
+    // division: parsing, symbols and building the sub-formula of a partition (cnf is a part of it)
+    PZ3_phase_division,
+    PZ3_phase_cnf,
+    PZ3_phase_distribution,
+    // subsolve: first check of the sub-formula of a partition, racing included
+    PZ3_phase_subsolve,
+    // localization, form (constraints of shared terms), solve and interpolation: a slave in a round
+    PZ3_phase_localization,
+    PZ3_phase_form,
+    PZ3_phase_solve,
+    PZ3_phase_interpolation,
+    // translation: shared symbols and interpolants into the shared context
+    PZ3_phase_translation,
+    // ssr: the master solving shared terms in a round
+    PZ3_phase_ssr,
+    PZ3_phase_num
+} PZ3_Phase;
+
+// solver_counts: statistics of Z3 solvers (conflicts, decisions, propagations, ...) by their names
+typedef std::map<std::string, double> solver_counts;
+
+/*
+  phase_row: time (in nanoseconds), number of times, hardware counters and statistics of the solvers
+  checked in every phase, and the largest resident set of the process (in KB) at the end of its runs
+  for phases which sample memory
+*/
+struct phase_row
+{
+    long long ns[PZ3_phase_num];
+    unsigned count[PZ3_phase_num];
+    long rss_kb[PZ3_phase_num];
+    counter_set counters[PZ3_phase_num];
+    solver_counts solver[PZ3_phase_num];
+
+    phase_row()
+    {
+        for (unsigned i = 0; i < PZ3_phase_num; i++)
+        {
+            ns[i] = 0;
+            count[i] = 0;
+            rss_kb[i] = 0;
+        }
+    }
+};
+
+/*
+  phaseStats: time of every phase of an instance, per thread and per conciliation round. Thread i < n
+  is partition i, and thread n is the master (with the set-up of the shared context). Row 0 of a
+  thread is what it did before conciliation, row r is round r. Every thread writes only its own
+  rows, so nothing is locked; rows are read after the threads are joined.
+  Phases are also spans of the trace, if there is one. When both are off, a phase_timer costs a test
+  of a flag. With counting, hardware counters of a thread (see perfCounters) are added to its phases
+  too; a counter which is not known for some run of a phase is left out of the output of that
+  phase, and of every total the phase is in, rather than counted as 0. Statistics of the solvers a thread
+  checks are added to the phase of the check.
+*/
+class phaseStats
+{
+protected:
+    bool on;
+    bool counting;
+    std::vector<std::vector<phase_row> > rows;
+    eventTrace *trace;
+
+public:
+    phaseStats();
+    /* Forget the last instance; rows are kept for thread_num threads if on, with counters if count */
+    void reset(unsigned thread_num, bool enable, bool count = false);
+
+    bool enabled() const
+    {
+        return on;
+    }
+
+    bool counts() const
+    {
+        return counting;
+    }
+
+    /* Trace phases in t from now on, NULL for none */
+    void set_trace(eventTrace *t)
+    {
+        trace = t;
+    }
+
+    eventTrace *get_trace() const
+    {
+        return trace;
+    }
+
+    void add(unsigned thread, unsigned round, PZ3_Phase phase, long long ns, long rss_kb, counter_set const *counted = NULL);
+    /* Memory is sampled at the end of phases which end a stage of a thread, not of their parts */
+    static bool samples_memory(PZ3_Phase phase);
+    /* Add statistics of a solver checked by a thread in a phase */
+    void add_solver(unsigned thread, unsigned round, PZ3_Phase phase, solver_counts const &counts);
+    /* One JSON object with totals of phases, totals per thread and totals (and the slowest thread) per round */
+    void write_json(std::ostream &out) const;
+    static char const *name(PZ3_Phase phase);
+};
+
+/*
+  phase_timer: one run of a phase, from its construction to stop() or its destruction, added to a
+  thread of stats. Time (and counts) between pause() and resume() (waiting at a barrier) is left out,
+  and every part in between is a span of the trace. Memory is sampled when a phase which ends a
+  stage is done (see phaseStats::samples_memory), so short phases do not read /proc every time.
+*/
+class phase_timer
+{
+protected:
+    phaseStats &stats;
+    eventTrace *trace;
+    unsigned thread;
+    unsigned round;
+    PZ3_Phase phase;
+    bool timed;
+    bool counted;
+    bool running;
+    bool done;
+    long long elapsed;
+    boost::chrono::high_resolution_clock::time_point start;
+    counter_reading start_counts;
+    counter_set counts;
+
+public:
+    phase_timer(phaseStats &ps, unsigned thread_id, unsigned round_id, PZ3_Phase ph) : stats(ps)
+    {
+        trace = stats.get_trace();
+        thread = thread_id;
+        round = round_id;
+        phase = ph;
+        timed = stats.enabled();
+        counted = timed && stats.counts();
+        running = false;
+        done = !timed && trace == NULL;
+        elapsed = 0;
+        resume();
+    }
+
+    ~phase_timer()
+    {
+        stop();
+    }
+
+    void pause()
+    {
+        if (!running)
+            return;
+        running = false;
+        if (timed)
+        {
+            boost::chrono::nanoseconds ns = boost::chrono::high_resolution_clock::now() - start;
+            elapsed += ns.count();
+        }
+        if (counted)
+        {
+            counter_reading now;
+            perfCounters::read(now);
+            perfCounters::add(counts, start_counts, now);
+        }
+        if (trace != NULL)
+            trace->end(thread, phaseStats::name(phase), round);
+    }
+
+    void resume()
+    {
+        if (done || running)
+            return;
+        running = true;
+        if (trace != NULL)
+            trace->begin(thread, phaseStats::name(phase), round);
+        if (counted)
+            perfCounters::read(start_counts);
+        if (timed)
+            start = boost::chrono::high_resolution_clock::now();
+    }
+
+    void stop()
+    {
+        if (done)
+            return;
+        pause();
+        done = true;
+        if (timed)
+        {
+            mem_sample mem;
+            if (phaseStats::samples_memory(phase))
+                memStats::sample(mem);
+            stats.add(thread, round, phase, elapsed, mem.rss_kb, counted ? &counts : NULL);
+        }
+    }
+};
+
+#endif
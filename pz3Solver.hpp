@@ -0,0 +1,547 @@
+#ifndef _PZ3_SOLVER_H_
+#define _PZ3_SOLVER_H_
+
+#include "core.hpp"
+#include "contextManager.hpp"
+#include "fistTable.hpp"
+#include "flatMap.hpp"
+#include "symbolTable.hpp"
+#include "cpuTopology.hpp"
+#include "solverPortfolio.hpp"
+#include "workerProcess.hpp"
+#include "decompCache.hpp"
+#include "smtInput.hpp"
+#include "phaseStats.hpp"
+#include <pthread.h>
+#include <string>
+
+// instances solved sequentially in one context before it is renewed
+#define PZ3_SEQ_CTX_REUSE 256
+// resident memory taken by a partition per byte of input, until one division is measured
+#define PZ3_MEM_RATIO 64.0
+// smallest input measured, so that what a context costs anyway is not taken for a part of the input
+#define PZ3_MEM_LEARN_SIZE (1u << 20)
+
+namespace pz3
+{
+
+// Options: how an instance is solved
+struct Options
+{
+    // number of cores, 1 for sequential Z3
+    unsigned core_num;
+    // bind threads to CPUs by topology; solvers of a process which bind get CPUs no other one uses
+    // while there are some left (see cpuTopology.hpp), and hold them until they are destroyed
+    bool bind_threads;
+    // time limit of every check of Z3 in milliseconds, 0 for none
+    unsigned timeout_ms;
+    // race the built-in configurations of Z3 on unfinished sub-formulas (see solverPortfolio.hpp);
+    // every racer keeps a copy of all clauses in its context. Off, sub-formulas are checked with
+    // the default configuration only, unless a portfolio is loaded into get_portfolio()
+    bool race;
+    // check sub-formulas in a worker process per partition (see workerProcess.hpp), started from
+    // worker_path, a pz3 executable; partitions are solved by threads if it is empty
+    bool processes;
+    std::string worker_path;
+    // directory of the decomposition cache (see decompCache.hpp), empty for none, and its size limit
+    std::string cache_dir;
+    unsigned cache_mb;
+    // time every phase per thread and round (see phaseStats.hpp), written by write_stats()
+    bool stats;
+    // with stats, add hardware counters of every phase (see perfCounters.hpp)
+    bool counters;
+    // file of a Chrome trace of all instances (see eventTrace.hpp), written when the solver is
+    // destroyed; empty for none
+    std::string trace_path;
+    // memory (in MB) an instance should stay within, 0 for no limit: fewer partitions (down to
+    // sequential Z3) are used for an input whose copies in every partition would not fit
+    unsigned max_memory_mb;
+
+    Options()
+    {
+        core_num = 1;
+        bind_threads = true;
+        timeout_ms = 0;
+        race = false;
+        processes = false;
+        cache_mb = PZ3_CACHE_DEFAULT_MB;
+        stats = false;
+        counters = false;
+        max_memory_mb = 0;
+    }
+};
+
+// Statistics: sizes and phase times (in milliseconds) of the last instance
+struct Statistics
+{
+    unsigned clause_num;
+    // components solved separately, without decomposition
+    unsigned component_num;
+    unsigned shared_var_num;
+    unsigned shared_func_num;
+    // rounds of conciliation
+    unsigned round_num;
+    // the decomposition was taken from the cache
+    bool cache_hit;
+    double division_ms;
+    double subsolve_ms;
+    double conciliation_ms;
+    // peak_rss_mb: high-water mark of the resident memory during this instance; peak_process_wide
+    // if it is the mark of the process instead, because the kernel cannot restart it or other
+    // solvers of the process ran beside this one (see memStats.hpp)
+    double peak_rss_mb;
+    bool peak_process_wide;
+    double total_ms;
+
+    Statistics()
+    {
+        clause_num = 0;
+        component_num = 0;
+        shared_var_num = 0;
+        shared_func_num = 0;
+        round_num = 0;
+        cache_hit = false;
+        division_ms = 0;
+        subsolve_ms = 0;
+        conciliation_ms = 0;
+        peak_rss_mb = 0;
+        peak_process_wide = false;
+        total_ms = 0;
+    }
+};
+
+// Result: outcome of an instance
+struct Result
+{
+    PZ3_Result status;
+    // the input cannot be read, status is PZ3_unknown and message tells why
+    bool error;
+    std::string message;
+    Statistics stats;
+
+    Result()
+    {
+        status = PZ3_unknown;
+        error = false;
+    }
+};
+
+/*
+  Solver: owns all state of decomposition and conciliation, so solvers are independent of each other
+  and several of them can run at once in one process. A solver can be reused for many instances one
+  after another, but one instance is solved at a time by each solver.
+  An incremental instance is given command by command (declare(), add(), push(), pop()) and checked
+  by check() as often as needed. Its contexts, the solver of every partition and the solver of the
+  master stay between checks: new assertions are parsed and distributed once and added to the
+  partitions, and scopes are pushed and popped on all these solvers, so a check mostly costs what was
+  asserted since the last one.
+*/
+class Solver
+{
+protected:
+    // thread_arg: the solver and the rank of a thread working for it
+    struct thread_arg
+    {
+        Solver *solver;
+        long rank;
+    };
+
+    // inc_scope: sizes of an incremental instance where a scope starts
+    struct inc_scope
+    {
+        size_t prelude_len;
+        unsigned clause_num;
+    };
+
+    Options options;
+    std::string file_path;
+    unsigned core_num;
+    // input_text: formula given as SMTLIB2 text instead of file_path
+    bool from_text;
+    std::string input_text;
+    // input: text of the instance being solved, read once for all threads
+    smtInput input;
+    // error_message: why the input cannot be read (set once by the first division thread)
+    std::string error_message;
+    Statistics stats;
+    // seq_uses: instances solved in the context kept for sequential solving
+    unsigned seq_uses;
+
+    // cm goes first, so contexts are destroyed after every object living in them
+    contextManager cm;
+    // topology: CPUs of partitions and the master thread
+    cpuTopology topology;
+    // portfolio: solver configurations racing on sub-formulas
+    solverPortfolio portfolio;
+    std::vector<thread_arg> thread_args;
+    // workers: worker process of every partition while an instance is solved, empty with threads only
+    std::vector<workerProcess *> workers;
+    // decoders: interpolants of every worker are read into the context of its partition
+    std::vector<exprDecoder *> decoders;
+    // cache: decompositions of inputs solved before
+    // cache_key: key of the input, empty if it is not looked up
+    // cache_doc: the cached decomposition (hit) or the one to be cached (miss)
+    decompCache cache;
+    std::string cache_key;
+    std::string cache_doc;
+    bool cache_hit;
+
+    // incremental instance (see declare(), add(), push(), pop() and check())
+    // inc_prelude: declarations so far, parsed again before new assertions
+    // inc_pending: assertions not parsed into the contexts yet, inc_text: text being parsed
+    // inc_sub, inc_weight: symbols and weight of every clause, as the distribution takes them
+    // inc_uses: clauses of every partition using every symbol, inc_parts: partitions using every symbol
+    // inc_changed: partitions given or deprived of clauses since their sub-formula was joined
+    // part_solvers: solver of the sub-formula of every partition, kept between checks
+    // shared_solver: solver of the master in the shared context, keeping interpolants between checks
+    // While an instance is incremental, core_clauses, expr_table, expr_list, var_fs, fun_fs, sv_set
+    // and sf_set are kept between checks too, and changed by the clauses added or dropped.
+    bool incremental;
+    std::string inc_prelude;
+    std::string inc_pending;
+    std::string inc_text;
+    std::vector<inc_scope> inc_scopes;
+    std::vector<symbol_list> inc_sub;
+    std::vector<int> inc_weight;
+    std::vector<std::vector<unsigned> > inc_uses;
+    std::vector<unsigned> inc_parts;
+    std::vector<bool> inc_changed;
+    std::vector<solver *> part_solvers;
+    solver *shared_solver;
+    // part_totals, shared_totals: statistics of these solvers over their checks so far
+    std::vector<solver_counts> part_totals;
+    solver_counts shared_totals;
+
+    closure true_clo;
+    closure false_clo;
+
+    // symbols: dense ids of all uninterpreted symbols
+    symbolTable symbols;
+
+    // clause distribution, variable list, clauses per core, formula per core respectively
+    std::vector<int> expr_dist;
+    std::vector<symbol_list> expr_var;
+    std::vector<symbol_list> expr_fun;
+    // core_clauses: indices of the clauses of every core in order, made once from expr_dist
+    std::vector<std::vector<int> > core_clauses;
+
+    std::vector<expr_vector> expr_table;
+    // clause_table: all clauses in the context of every core, for racing on sub-formulas of other cores
+    // (and always kept by an incremental instance, which adds clauses to it)
+    std::vector<expr_vector> clause_table;
+    // expr_list: sub-formulas for every core
+    std::vector<expr> expr_list;
+
+    // structures on shared variables
+    // sv_set: set of shared variables
+    // sf_set: set of shared functions
+    symbol_list sv_set;
+    symbol_list sf_set;
+    // var_fs: set of variables for each sub-formula
+    // fun_fs: set of functions for each sub-formula
+    std::vector<symbol_list> var_fs;
+    std::vector<symbol_list> fun_fs;
+
+    // var_expr: list of shared variables in each sub-formula
+    // fun_expr: list of shared function declarations in each formula
+    std::vector<std::map<unsigned, expr> > var_expr;
+    std::vector<std::map<unsigned, func_decl> > fun_expr;
+    // svexpr: expressions corresponding to shared variables and classification number
+    // sfist: shared function instances and corresponding classification number
+    flat_map<unsigned, closure> svexpr;
+    fist_map<closure> sfist;
+    // sv_map: shared variables translated into shared context
+    std::map<unsigned, expr> sv_map;
+
+    // checklist indicates check result for every sub-formula
+    std::vector<check_result> checklist;
+    // interpo_list is a list for interpolants in every sub-formula
+    std::vector<expr> interpo_list;
+    // table_list: equivalence class conversion table of each sub-problem
+    std::vector<flat_map<closure, closure> > table_list;
+    // entry_list: entries of shared functions in the model of every sub-formula
+    std::vector<std::vector<model_entry> > entry_list;
+
+    // independent components solved without decomposition
+    // comp_clauses: clauses of every component, comp_core: the core solving it
+    std::vector<std::vector<int> > comp_clauses;
+    std::vector<int> comp_core;
+    // comp_result: combined result of these components (an unsat one makes the formula unsat)
+    PZ3_Result comp_result;
+    // dec_clause_num: number of clauses left to decomposition
+    unsigned dec_clause_num;
+
+    bool need_term;
+    // early_unsat: a component or sub-formula is unsat, so the other cores stop
+    boost::atomic<bool> early_unsat;
+    // file_error: the input cannot be parsed
+    bool file_error;
+
+    // set-up of shared context runs while sub-formulas are solved
+    // core_ready: sub-formula of the core is solved, so its context can be read by the set-up thread
+    // setup_cancel: some sub-formula is unsat and the set-up is useless
+    std::vector<bool> core_ready;
+    bool setup_cancel;
+    pthread_mutex_t ready_mutex;
+    pthread_cond_t ready_cond;
+
+    // racing on sub-formulas in subsolve
+    // part_done: result of the sub-formula is known, part_result: the result
+    // part_winner: configuration which solved the sub-formula first (slaves keep using it)
+    // part_racers: number of other cores racing on the sub-formula
+    // helping: sub-formula raced on by each core, -1 for none
+    std::vector<bool> part_done;
+    std::vector<check_result> part_result;
+    std::vector<unsigned> part_winner;
+    std::vector<unsigned> part_racers;
+    std::vector<int> helping;
+    pthread_mutex_t race_mutex;
+
+    // phases: time of phases of the last instance, if options.stats
+    // trace: spans of all instances, if options.trace_path is given; thread core_num is the master
+    // (and the set-up of the shared context), thread core_num + 1 the one which called the solver
+    phaseStats phases;
+    eventTrace trace;
+
+    // memory of the last instance (see memStats.hpp), with the memory of Z3 noted in cm
+    // term_max: most shared terms a slave collected in a round, for every partition
+    // mem_ratio: resident memory taken by a partition per byte of input, the most seen in divisions
+    std::vector<unsigned> term_max;
+    double mem_ratio;
+
+    // for parallel control
+    pthread_mutex_t err_mutex;
+    pthread_barrier_t crea_barrier;
+    pthread_barrier_t stat_barrier;
+    pthread_barrier_t dist_barrier;
+    pthread_barrier_t coll_barrier;
+
+    pthread_barrier_t barrier1;
+    pthread_barrier_t barrier2;
+
+    // a solver holds contexts and threads, so it is never copied
+    Solver(Solver const &);
+    Solver &operator=(Solver const &);
+
+    /* Entries of threads, calling the member function for the rank in thread_arg */
+    static void *division_entry(void *arg);
+    static void *subsolve_entry(void *arg);
+    static void *shared_setup_entry(void *arg);
+    static void *master_entry(void *arg);
+    static void *slave_entry(void *arg);
+    static void *context_entry(void *arg);
+
+    /* Run entry for every partition in a thread on its CPU, and wait for all of them */
+    void run_parts(void *(*entry)(void *));
+
+    /* Check the satisfiability of the input */
+    PZ3_Result solve();
+
+    /* Check the satisfiability of the input by decomposition */
+    PZ3_Result solve_parallel();
+
+    /* Check the satisfiability of the input with sequential Z3 */
+    PZ3_Result solve_one();
+
+    /* Solve the sub-formulas of partitions and conciliate them */
+    PZ3_Result solve_partitions();
+
+    /* Use as many partitions (up to options.core_num) as fit in options.max_memory_mb for the input */
+    void fit_memory();
+
+    /* Solve with num partitions from now on */
+    void set_parts(unsigned num);
+
+    /* Resident memory, memory of Z3 and sizes of containers of the last instance as a JSON object */
+    void write_memory(std::ostream &out);
+
+    /* Start an incremental instance, dropping the last instance */
+    void start_script();
+
+    /* Parse assertions given since the last call, and add the new clauses to every partition */
+    bool absorb();
+
+    /* Make the context of a partition for an incremental instance */
+    void *make_context(void *rank);
+
+    /* Put the clauses from first on into the tables of their partitions, counting their symbols */
+    void inc_place(unsigned first);
+
+    /* Take the clauses from clause_num on out of the tables of their partitions */
+    void inc_drop(unsigned clause_num);
+
+    /*
+      Count the uses of symbols by a clause of partition part (count is 1 or -1), appending symbols
+      the partition starts or stops using to part_syms, and symbols which become or stop being
+      shared to shared
+    */
+    void inc_count(int part, symbol_list &syms, int count, symbol_list &part_syms, symbol_list &shared);
+
+    /* Solve the partitions of the incremental instance with the clauses absorbed so far */
+    PZ3_Result check_incremental();
+
+    /* Start a worker process for every partition, or none if one cannot be started */
+    void start_workers();
+    void stop_workers();
+
+    /* Send the sub-formula of a partition to its worker and check it there */
+    check_result worker_load(int my_rank);
+
+    /* Check the sub-formula of a partition with a constraint in its worker, like slave_func does */
+    check_result worker_check(int my_rank, expr &constr_expr, std::map<closure, expr_vector> &term_stat);
+
+    /* Report a worker which failed (reason is empty if it is gone), and give up its partition */
+    check_result worker_error(int my_rank, std::string const &reason);
+
+    /*
+      Add the statistics of a solver just checked by a thread to its phase, and note the memory of Z3
+      for context ctx_index (-1 for the shared context). For a solver kept between checks, totals has
+      its statistics so far, and only what this check added is taken.
+    */
+    void note_solver(int ctx_index, unsigned thread, unsigned round, PZ3_Phase phase, solver &s,
+                     solver_counts *totals = NULL);
+
+    /* Wait at a barrier, as a span of the trace */
+    void wait_at(pthread_barrier_t &barrier, unsigned thread, char const *name, unsigned round = 0);
+
+    /* Clear state of the last instance before solving another one */
+    void reset_state();
+
+    /* Clear state of the last check (an incremental instance keeps its sub-formulas and symbols) */
+    void reset_rounds();
+
+    /* Record why the input cannot be read */
+    void input_error(std::string const &reason);
+
+    /* Problem division */
+    void *division(void *rank);
+
+    /* Split clauses into components and distribute the rest of them to cores */
+    void distribute(int num_clause);
+
+    /* Take the decomposition of the input from the cache, except its clauses */
+    bool load_division();
+    bool read_division();
+
+    /* Read the clauses of the cached decomposition into a context */
+    bool read_clauses(context &ctx, expr_vector &list);
+
+    /* Write the decomposition with its clauses (in the context of the master) to cache_doc */
+    void save_division(expr_vector &list);
+
+    /* Split clauses into independent components, returning the large ones left to decomposition */
+    void split_components(int num_clause, std::vector<std::vector<int> > &dec_comps);
+
+    /* Solve components assigned to a core, each by its own solver */
+    void solve_components(int my_rank, expr_vector &list);
+
+    /* Parse the whole input */
+    PZ3_File_Result parse_file(context &ctx, expr &fs);
+
+    /* Parse the input into clauses, collecting symbols of every step-th clause from the one of my_rank */
+    bool read_input(int my_rank, unsigned step, expr_vector &list, std::vector<symbol_list> &vars,
+                    std::vector<symbol_list> &funs);
+
+    /* Index the clauses of every core from expr_dist */
+    void index_clauses();
+
+    /* Collect the clauses of a core into its sub-formula */
+    void build_part(int my_rank, expr_vector &list);
+
+    /* Conjunct the clauses of expr_table of a core into its sub-formula */
+    void join_part(int my_rank);
+
+    /* Merge symbols of clauses and weigh them for the distribution */
+    void clause_symbols(std::vector<int> &clauses, std::vector<symbol_list> &symbol_sub, std::vector<int> &clause_weight);
+
+    /* Convert parsed formula into CNF */
+    bool fs_to_cnf(int const my_rank, expr &fs, expr_vector &list);
+
+    /* Solve sub-problems in parallel */
+    void *subsolve(void *rank);
+
+    /* The formula is unsat: stop other cores */
+    void stop_unsat(int my_rank);
+
+    /* Record the result of a racer on a sub-formula and stop the others */
+    check_result finish_race(int part, int my_rank, unsigned config, check_result result);
+
+    /* Race on unfinished sub-formulas of other cores with other configurations */
+    void help_race(int my_rank);
+
+    /* Merge symbol lists of the clauses of a core into the symbol list of the core */
+    void symbols_merge(int my_rank, std::vector<symbol_list> &clause_syms, symbol_list &core_syms);
+
+    /* Merge variable maps of clauses in the same core */
+    void vars_merge(int my_rank);
+
+    /* Merge function maps of clauses in the same core */
+    void funcs_merge(int my_rank);
+
+    /* Count symbols shared by different cores */
+    void shared_count();
+
+    /* Collect shared variables from different contexts(cores) */
+    bool shared_collect();
+
+    /* Extract expression objects of shared variables of a core */
+    void *extract_vars(void *arg);
+
+    /* Set up the shared context while sub-formulas are solved */
+    void *shared_setup(void *arg);
+
+    /* Function for master thread -- calculating the model for shared variables */
+    void *master_func(void *arg);
+
+    /* Function for slave thread -- calculating interpolation for sub-formulas */
+    void *slave_func(void *arg);
+
+    /* Localize terms for a sub-problem based on global shared terms */
+    void localization(context & c, std::map<unsigned, expr> & my_var, std::map<unsigned, func_decl> & my_fun, std::vector<local_func_inst> & result, std::set<closure> & valid_closure);
+
+public:
+    Solver(Options const &opt);
+    ~Solver();
+
+    /* Check the satisfiability of an SMTLIB2 file */
+    Result solve_file(std::string const &path);
+
+    /* Check the satisfiability of a formula given as SMTLIB2 text */
+    Result solve_text(std::string const &text);
+
+    /* Add a declaration or definition (an SMTLIB2 command) to the incremental instance */
+    void declare(std::string const &command);
+
+    /* Add an assertion (an SMTLIB2 assert command) to the incremental instance */
+    void add(std::string const &command);
+
+    /* Open scopes of the incremental instance; false if the assertions before cannot be parsed */
+    bool push(unsigned num);
+
+    /* Close scopes, dropping assertions and declarations given in them */
+    void pop(unsigned num);
+
+    /* Check the satisfiability of the incremental instance */
+    Result check();
+
+    /* Check the incremental instance under assumptions (SMTLIB2 terms), dropped after the check */
+    Result check_assuming(std::string const &literals);
+
+    /* Drop the incremental instance */
+    void reset_script();
+
+    /* Change the time limit of checks for following instances */
+    void set_timeout(unsigned timeout_ms);
+
+    /* Write the statistics and phases of the last instance as one line of JSON */
+    void write_stats(std::ostream &out, Result const &result);
+
+    Options const &get_options();
+    cpuTopology &get_topology();
+    solverPortfolio &get_portfolio();
+    decompCache &get_cache();
+};
+
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "scriptMode.hpp"
+#include "smtInput.hpp"
+
+static void print_result(pz3::Result const &result)
+{
+    if (result.error)
+    {
+        std::cout << "(error \"" << result.message << "\")" << std::endl;
+        return;
+    }
+    switch (result.status)
+    {
+    case PZ3_sat:
+        std::cout << "sat" << std::endl;
+        break;
+    case PZ3_unsat:
+        std::cout << "unsat" << std::endl;
+        break;
+    default:
+        std::cout << "unknown" << std::endl;
+    }
+}
+
+// number of scopes of push and pop, 1 if it is not given
+static unsigned scope_num(std::string const &args)
+{
+    return args.empty() ? 1 : (unsigned) atoi(args.c_str());
+}
+
+int solve_script(std::string const &path, pz3::Solver &solver, std::ostream *stats_out)
+{
+    smtInput input;
+    PZ3_File_Result pfr = input.open(path);
+    if (pfr != PZ3_file_ok)
+    {
+        std::cerr << file_reason(pfr) << "\n";
+        return 1;
+    }
+    std::string name;
+    std::string args;
+    for (unsigned i = 0; i < input.command_num(); i++)
+    {
+        PZ3_Cmd_Kind kind = input.command_kind(i);
+        if (kind == PZ3_cmd_assert)
+        {
+            solver.add(input.command_text(i));
+            continue;
+        }
+        if (kind == PZ3_cmd_decl)
+        {
+            solver.declare(input.command_text(i));
+            continue;
+        }
+        input.split_command(i, name, args);
+        if (name == "push")
+        {
+            // assertions before the scope are parsed now, so their errors are reported here
+            if (!solver.push(scope_num(args)))
+            {
+                pz3::Result failed;
+                failed.error = true;
+                failed.message = "cannot parse the assertions";
+                print_result(failed);
+            }
+        }
+        else if (name == "pop")
+            solver.pop(scope_num(args));
+        else if (name == "reset" || name == "reset-assertions")
+            solver.reset_script();
+        else if (name == "check-sat" || name == "check-sat-assuming")
+        {
+            pz3::Result result;
+            if (name == "check-sat")
+                result = solver.check();
+            else
+            {
+                // the literals are given as a list
+                if (args.size() >= 2 && args[0] == '(' && args[args.size() - 1] == ')')
+                    args = args.substr(1, args.size() - 2);
+                result = solver.check_assuming(args);
+            }
+            print_result(result);
+            if (stats_out != NULL)
+                solver.write_stats(*stats_out, result);
+        }
+        else if (name == "echo")
+        {
+            if (args.size() >= 2 && args[0] == '"')
+                args = args.substr(1, args.size() - 2);
+            std::cout << args << std::endl;
+        }
+        else if (name == "exit")
+            break;
+        else
+            std::cout << "unsupported" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef _SCRIPT_MODE_H_
+#define _SCRIPT_MODE_H_
+
+#include "pz3Solver.hpp"
+#include <string>
+
+/*
+  Script mode: run the commands of an SMTLIB2 script one by one on an incremental instance of solver.
+  Assertions and declarations go to the instance, push and pop open and close its scopes, and every
+  check-sat and check-sat-assuming prints its result to stdout. reset and reset-assertions drop the
+  instance, echo prints its string, and other commands print "unsupported".
+  Statistics of every check are written to stats_out unless it is NULL.
+*/
+int solve_script(std::string const &path, pz3::Solver &solver, std::ostream *stats_out);
+
+#endif
@@ -0,0 +1,146 @@
+// pz3_client: send SMTLIB2 files to a server started by "pz3 --serve" and print the results as CSV
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <boost/chrono.hpp>
+
+typedef boost::chrono::high_resolution_clock boost_clock;
+
+// files sent, indexed by request id, and when each was sent
+std::vector<std::string> client_files;
+std::vector<boost_clock::time_point> client_sent;
+pthread_mutex_t client_mutex;
+int client_fd;
+
+static bool send_all(int fd, char const *data, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = send(fd, data + done, len - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+/* Read a response line per request, in the order the server finishes them */
+void *client_reader(void *arg)
+{
+    unsigned left = *(unsigned *) arg;
+    std::string pending;
+    char buf[4096];
+    while (left > 0)
+    {
+        ssize_t n = read(client_fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        pending.append(buf, n);
+        size_t end;
+        while (left > 0 && (end = pending.find('\n')) != std::string::npos)
+        {
+            std::istringstream line(pending.substr(0, end));
+            pending.erase(0, end + 1);
+            unsigned id;
+            std::string result, queue_ms, solve_ms;
+            if (!(line >> id >> result >> queue_ms >> solve_ms) || id >= client_files.size())
+                continue;
+            pthread_mutex_lock(&client_mutex);
+            boost::chrono::duration<double, boost::milli> total = boost_clock::now() - client_sent[id];
+            std::cout << client_files[id] << "," << result << "," << queue_ms << "," << solve_ms << ","
+                      << total.count() << std::endl;
+            pthread_mutex_unlock(&client_mutex);
+            left--;
+        }
+    }
+    if (left > 0)
+        std::cerr << left << " requests got no response.\n";
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " [Path of socket] [Deadline in ms, 0 for default] [Paths of smtlib files]\n";
+        exit(1);
+    }
+    std::string socket_path(argv[1]);
+    unsigned deadline_ms = atoi(argv[2]);
+
+    sockaddr_un addr;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Socket path is too long.\n";
+        exit(1);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path.c_str());
+    client_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (client_fd < 0 || connect(client_fd, (sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        std::cerr << "Cannot connect to " << socket_path << ": " << strerror(errno) << "\n";
+        exit(1);
+    }
+
+    for (int i = 3; i < argc; i++)
+        client_files.push_back(argv[i]);
+    client_sent.resize(client_files.size());
+    pthread_mutex_init(&client_mutex, NULL);
+
+    // responses are read while requests are still sent, so the server is never blocked on us
+    std::cout << "file,result,queue_ms,solve_ms,total_ms" << std::endl;
+    unsigned request_num = client_files.size();
+    pthread_t reader;
+    pthread_create(&reader, NULL, client_reader, &request_num);
+    int rc = 0;
+    for (unsigned i = 0; i < client_files.size(); i++)
+    {
+        std::ifstream in(client_files[i].c_str(), std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "File " << client_files[i] << " doesn't exist.\n";
+            rc = 1;
+            break;
+        }
+        std::stringstream text;
+        text << in.rdbuf();
+        std::string payload = text.str();
+        std::ostringstream header;
+        header << "SOLVE " << i << " " << deadline_ms << " " << payload.size() << "\n";
+        pthread_mutex_lock(&client_mutex);
+        client_sent[i] = boost_clock::now();
+        pthread_mutex_unlock(&client_mutex);
+        std::string head = header.str();
+        if (!send_all(client_fd, head.data(), head.size()) || !send_all(client_fd, payload.data(), payload.size()))
+        {
+            std::cerr << "Connection closed by the server.\n";
+            rc = 1;
+            break;
+        }
+    }
+    if (rc != 0)
+    {
+        // no more responses are coming for requests never sent
+        shutdown(client_fd, SHUT_RDWR);
+    }
+    pthread_join(reader, NULL);
+    close(client_fd);
+    pthread_mutex_destroy(&client_mutex);
+    return rc;
+}
@@ -0,0 +1,285 @@
+#include "serveMode.hpp"
+#include <deque>
+#include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef boost::chrono::high_resolution_clock boost_clock;
+
+// queue of requests: readers wait for room, workers wait for requests
+std::deque<serve_request *> serve_queue;
+pthread_mutex_t queue_mutex;
+pthread_cond_t queue_room;
+pthread_cond_t queue_ready;
+
+// serve_input: buffered reading of a connection
+struct serve_input
+{
+    int fd;
+    char buf[4096];
+    unsigned pos;
+    unsigned len;
+};
+
+static bool fill_input(serve_input &in)
+{
+    while (true)
+    {
+        ssize_t n = read(in.fd, in.buf, sizeof(in.buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        in.pos = 0;
+        in.len = n;
+        return true;
+    }
+}
+
+static bool read_line(serve_input &in, std::string &line)
+{
+    line.clear();
+    while (true)
+    {
+        if (in.pos == in.len && !fill_input(in))
+            return false;
+        char ch = in.buf[in.pos++];
+        if (ch == '\n')
+            return true;
+        line += ch;
+        // no header is that long
+        if (line.size() > 1024)
+            return false;
+    }
+}
+
+static bool read_bytes(serve_input &in, unsigned num, std::string &text)
+{
+    text.clear();
+    text.reserve(num);
+    while (text.size() < num)
+    {
+        if (in.pos == in.len && !fill_input(in))
+            return false;
+        unsigned take = std::min(in.len - in.pos, num - (unsigned) text.size());
+        text.append(in.buf + in.pos, take);
+        in.pos += take;
+    }
+    return true;
+}
+
+static double ms_since(boost_clock::time_point start)
+{
+    boost::chrono::duration<double, boost::milli> elapsed = boost_clock::now() - start;
+    return elapsed.count();
+}
+
+static void respond(serve_conn *conn, std::string const &id, char const *result, double queue_ms, double solve_ms)
+{
+    std::ostringstream out;
+    out << id << " " << result << " " << queue_ms << " " << solve_ms << "\n";
+    std::string line = out.str();
+    pthread_mutex_lock(&conn->mutex);
+    size_t done = 0;
+    while (done < line.size())
+    {
+        ssize_t n = send(conn->fd, line.data() + done, line.size() - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        // the client is gone, so is the response
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    pthread_mutex_unlock(&conn->mutex);
+}
+
+// drop a reference to a connection, the last one closes it
+static void release_conn(serve_conn *conn)
+{
+    pthread_mutex_lock(&conn->mutex);
+    conn->refs--;
+    bool last = (conn->refs == 0);
+    pthread_mutex_unlock(&conn->mutex);
+    if (last)
+    {
+        close(conn->fd);
+        pthread_mutex_destroy(&conn->mutex);
+        delete conn;
+    }
+}
+
+void *serve_reader(void *arg)
+{
+    serve_conn *conn = (serve_conn *) arg;
+    serve_input in;
+    in.fd = conn->fd;
+    in.pos = 0;
+    in.len = 0;
+    std::string line;
+    while (read_line(in, line))
+    {
+        boost_clock::time_point arrival = boost_clock::now();
+        std::istringstream header(line);
+        std::string cmd, id;
+        unsigned deadline_ms = 0, length = 0;
+        if (!(header >> cmd >> id >> deadline_ms >> length) || cmd != "SOLVE" || length > PZ3_SERVE_MAX_PAYLOAD)
+        {
+            // the stream cannot be followed any more
+            respond(conn, id.empty() ? "-" : id, "error", 0, 0);
+            break;
+        }
+        serve_request *req = new serve_request;
+        if (!read_bytes(in, length, req->text))
+        {
+            delete req;
+            break;
+        }
+        req->conn = conn;
+        req->id = id;
+        req->deadline_ms = (deadline_ms > 0) ? deadline_ms : PZ3_SERVE_DEADLINE;
+        req->arrival = arrival;
+
+        // Wait for room in the queue until the deadline. The connection is not read meanwhile,
+        // so a client sending faster than workers solve is held back by its socket buffer.
+        double left_ms = std::max(req->deadline_ms - ms_since(arrival), 0.0);
+        timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        long long until_ns = until.tv_nsec + (long long) (left_ms * 1000000);
+        until.tv_sec += until_ns / 1000000000;
+        until.tv_nsec = until_ns % 1000000000;
+        bool queued = false;
+        pthread_mutex_lock(&queue_mutex);
+        while (serve_queue.size() >= PZ3_SERVE_QUEUE_SIZE)
+        {
+            if (pthread_cond_timedwait(&queue_room, &queue_mutex, &until) == ETIMEDOUT)
+                break;
+        }
+        if (serve_queue.size() < PZ3_SERVE_QUEUE_SIZE)
+        {
+            pthread_mutex_lock(&conn->mutex);
+            conn->refs++;
+            pthread_mutex_unlock(&conn->mutex);
+            serve_queue.push_back(req);
+            queued = true;
+            pthread_cond_signal(&queue_ready);
+        }
+        pthread_mutex_unlock(&queue_mutex);
+        if (!queued)
+        {
+            respond(conn, id, "busy", ms_since(arrival), 0);
+            delete req;
+        }
+    }
+    release_conn(conn);
+    return NULL;
+}
+
+void *serve_worker(void *arg)
+{
+    // a sequential solver, whose context serves one request after another
+    pz3::Options opt;
+    opt.bind_threads = false;
+    pz3::Solver solver(opt);
+    while (true)
+    {
+        pthread_mutex_lock(&queue_mutex);
+        while (serve_queue.empty())
+            pthread_cond_wait(&queue_ready, &queue_mutex);
+        serve_request *req = serve_queue.front();
+        serve_queue.pop_front();
+        pthread_cond_signal(&queue_room);
+        pthread_mutex_unlock(&queue_mutex);
+
+        double queue_ms = ms_since(req->arrival);
+        double solve_ms = 0;
+        char const *result = "timeout";
+        if (queue_ms < req->deadline_ms)
+        {
+            // the time left until the deadline limits the check
+            solver.set_timeout(req->deadline_ms - (unsigned) queue_ms);
+            pz3::Result res = solver.solve_text(req->text);
+            solve_ms = res.stats.total_ms;
+            if (res.error)
+                result = "error";
+            else if (res.status == PZ3_sat)
+                result = "sat";
+            else if (res.status == PZ3_unsat)
+                result = "unsat";
+            else if (queue_ms + solve_ms >= req->deadline_ms)
+                result = "timeout";
+            else
+                result = "unknown";
+        }
+        respond(req->conn, req->id, result, queue_ms, solve_ms);
+        release_conn(req->conn);
+        delete req;
+    }
+    return NULL;
+}
+
+int solve_serve(std::string const &socket_path, unsigned worker_num)
+{
+    sockaddr_un addr;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Socket path is too long.\n";
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path.c_str());
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    // a socket left by an earlier server is replaced
+    unlink(socket_path.c_str());
+    if (listen_fd < 0 || bind(listen_fd, (sockaddr *) &addr, sizeof(addr)) < 0 || listen(listen_fd, 64) < 0)
+    {
+        std::cerr << "Cannot listen on " << socket_path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    pthread_mutex_init(&queue_mutex, NULL);
+    pthread_cond_init(&queue_room, NULL);
+    pthread_cond_init(&queue_ready, NULL);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (unsigned i = 0; i < worker_num; i++)
+    {
+        pthread_t handle;
+        pthread_create(&handle, &attr, serve_worker, NULL);
+    }
+    std::cerr << "Serving on " << socket_path << " with " << worker_num << " workers" << std::endl;
+
+    while (true)
+    {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            std::cerr << "Cannot accept connections: " << strerror(errno) << "\n";
+            break;
+        }
+        serve_conn *conn = new serve_conn;
+        conn->fd = fd;
+        conn->refs = 1;
+        pthread_mutex_init(&conn->mutex, NULL);
+        pthread_t handle;
+        if (pthread_create(&handle, &attr, serve_reader, conn) != 0)
+        {
+            close(fd);
+            pthread_mutex_destroy(&conn->mutex);
+            delete conn;
+        }
+    }
+    pthread_attr_destroy(&attr);
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return 1;
+}
@@ -0,0 +1,56 @@
+#ifndef _SERVE_MODE_H_
+#define _SERVE_MODE_H_
+
+#include "pz3Solver.hpp"
+#include <string>
+
+// requests waiting for a worker; connections stop being read while the queue is full
+#define PZ3_SERVE_QUEUE_SIZE 64
+// deadline of a request which gives none, in milliseconds
+#define PZ3_SERVE_DEADLINE 10000u
+// longest payload accepted, in bytes
+#define PZ3_SERVE_MAX_PAYLOAD (64u * 1024u * 1024u)
+
+/*
+  Protocol on the Unix socket. Requests follow each other on a connection:
+      SOLVE <id> <deadline in ms, 0 for the default> <payload length in bytes>\n<payload>
+  where the payload is SMTLIB2 text. Every request gets one response line:
+      <id> <result> <queue_ms> <solve_ms>\n
+  result is sat, unsat, unknown, timeout (the deadline passed), busy (the queue stayed full until the
+  deadline) or error (the payload cannot be parsed, or the request is malformed and the connection
+  is closed). Responses come in the order requests are finished, not the order they were sent.
+*/
+
+// serve_conn: a client connection, shared by its reader and the requests still running
+struct serve_conn
+{
+    int fd;
+    // refs: the reader and every unanswered request
+    unsigned refs;
+    pthread_mutex_t mutex;
+};
+
+// serve_request: a request waiting in the queue
+struct serve_request
+{
+    serve_conn *conn;
+    std::string id;
+    std::string text;
+    unsigned deadline_ms;
+    boost::chrono::high_resolution_clock::time_point arrival;
+};
+
+/*
+  Server mode: listen on socket_path, and solve requests of all clients by a pool of worker_num
+  workers. Every worker keeps its own sequential solver, so its context is reused by requests.
+  Runs until the process is killed.
+*/
+int solve_serve(std::string const &socket_path, unsigned worker_num);
+
+/* Thread reading requests of a connection into the queue */
+void *serve_reader(void *arg);
+
+/* Worker thread solving requests from the queue */
+void *serve_worker(void *arg);
+
+#endif
@@ -0,0 +1,399 @@
+#include "smtInput.hpp"
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef PZ3_ZSTD
+#include <zstd.h>
+#endif
+
+// output of inflating grows by this much at least
+#define PZ3_INFLATE_STEP (1u << 20)
+
+smtInput::smtInput()
+{
+    data = "";
+    len = 0;
+    map_addr = NULL;
+    map_len = 0;
+    scoped = false;
+}
+
+smtInput::~smtInput()
+{
+    close();
+}
+
+void smtInput::close()
+{
+    if (map_addr != NULL)
+    {
+        munmap(map_addr, map_len);
+        map_addr = NULL;
+        map_len = 0;
+    }
+    std::string().swap(buf);
+    commands.clear();
+    data = "";
+    len = 0;
+    scoped = false;
+}
+
+PZ3_File_Result smtInput::open(std::string const &path)
+{
+    close();
+    PZ3_File_Result pfr = (path == "-") ? read_stdin() : map_file(path);
+    if (pfr == PZ3_file_ok)
+        pfr = inflate();
+    if (pfr == PZ3_file_ok)
+        pfr = scan();
+    if (pfr != PZ3_file_ok)
+        close();
+    return pfr;
+}
+
+PZ3_File_Result smtInput::set_text(std::string const &text)
+{
+    close();
+    data = text.c_str();
+    len = text.size();
+    PZ3_File_Result pfr = scan();
+    if (pfr != PZ3_file_ok)
+        close();
+    return pfr;
+}
+
+PZ3_File_Result smtInput::read_stdin()
+{
+    char chunk[1 << 16];
+    while (true)
+    {
+        ssize_t n = read(0, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return PZ3_file_noexist;
+        if (n == 0)
+            break;
+        buf.append(chunk, n);
+    }
+    data = buf.c_str();
+    len = buf.size();
+    return PZ3_file_ok;
+}
+
+PZ3_File_Result smtInput::map_file(std::string const &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return PZ3_file_noexist;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return PZ3_file_noexist;
+    }
+    size_t size = st.st_size;
+    // the rest of the last page is zero, so a mapped text is followed by a NUL unless it fills the page
+    long page = sysconf(_SC_PAGESIZE);
+    if (size > 0 && size % page != 0)
+    {
+        void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            madvise(addr, size, MADV_SEQUENTIAL);
+            ::close(fd);
+            map_addr = addr;
+            map_len = size;
+            data = (char const *) addr;
+            len = size;
+            return PZ3_file_ok;
+        }
+    }
+    buf.resize(size);
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t n = read(fd, &buf[done], size - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    ::close(fd);
+    buf.resize(done);
+    data = buf.c_str();
+    len = buf.size();
+    return PZ3_file_ok;
+}
+
+PZ3_File_Result smtInput::inflate()
+{
+    unsigned char const *in = (unsigned char const *) data;
+    std::string out;
+    if (len >= 2 && in[0] == 0x1f && in[1] == 0x8b)
+    {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        // 16: gzip header
+        if (inflateInit2(&zs, 15 + 16) != Z_OK)
+            return PZ3_file_corrupt;
+        zs.next_in = (Bytef *) in;
+        zs.avail_in = len;
+        int ret = Z_OK;
+        while (ret != Z_STREAM_END || zs.avail_in > 0)
+        {
+            // members of a gzip file follow each other
+            if (ret == Z_STREAM_END && inflateReset(&zs) != Z_OK)
+                break;
+            size_t done = out.size();
+            out.resize(done + std::max((size_t) PZ3_INFLATE_STEP, done / 2));
+            zs.next_out = (Bytef *) &out[done];
+            zs.avail_out = out.size() - done;
+            ret = ::inflate(&zs, Z_NO_FLUSH);
+            out.resize(out.size() - zs.avail_out);
+            if (ret != Z_OK && ret != Z_STREAM_END)
+                break;
+        }
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END)
+            return PZ3_file_corrupt;
+    }
+#ifdef PZ3_ZSTD
+    else if (len >= 4 && in[0] == 0x28 && in[1] == 0xb5 && in[2] == 0x2f && in[3] == 0xfd)
+    {
+        ZSTD_DStream *zs = ZSTD_createDStream();
+        ZSTD_initDStream(zs);
+        ZSTD_inBuffer zin = {in, len, 0};
+        size_t ret = 0;
+        while (zin.pos < zin.size)
+        {
+            size_t done = out.size();
+            out.resize(done + std::max((size_t) PZ3_INFLATE_STEP, done / 2));
+            ZSTD_outBuffer zout = {&out[done], out.size() - done, 0};
+            ret = ZSTD_decompressStream(zs, &zout, &zin);
+            out.resize(done + zout.pos);
+            if (ZSTD_isError(ret))
+                break;
+        }
+        ZSTD_freeDStream(zs);
+        // ret is 0 when a frame is complete
+        if (ZSTD_isError(ret) || ret != 0)
+            return PZ3_file_corrupt;
+    }
+#endif
+    else
+    {
+        return PZ3_file_ok;
+    }
+    if (map_addr != NULL)
+    {
+        munmap(map_addr, map_len);
+        map_addr = NULL;
+        map_len = 0;
+    }
+    buf.swap(out);
+    data = buf.c_str();
+    len = buf.size();
+    return PZ3_file_ok;
+}
+
+char const *file_reason(PZ3_File_Result pfr)
+{
+    switch (pfr)
+    {
+    case PZ3_file_noexist:
+        return "SMTLIB file doesn't exist.";
+    case PZ3_file_nosmt:
+        return "Input file is not a valid SMTLIB file.";
+    default:
+        return "Input SMTLIB file is corrupted.";
+    }
+}
+
+static PZ3_Cmd_Kind kind_of(char const *name, size_t name_len)
+{
+    std::string cmd(name, name_len);
+    if (cmd == "assert")
+        return PZ3_cmd_assert;
+    if (cmd == "push" || cmd == "pop" || cmd == "reset" || cmd == "reset-assertions")
+        return PZ3_cmd_scope;
+    if (cmd.compare(0, 4, "set-") == 0 || cmd.compare(0, 8, "declare-") == 0 || cmd.compare(0, 7, "define-") == 0)
+        return PZ3_cmd_decl;
+    return PZ3_cmd_other;
+}
+
+PZ3_File_Result smtInput::scan()
+{
+    commands.clear();
+    scoped = false;
+    size_t pos = 0;
+    while (pos < len)
+    {
+        char ch = data[pos];
+        if (ch == ';')
+        {
+            while (pos < len && data[pos] != '\n')
+                pos++;
+            continue;
+        }
+        if (isspace((unsigned char) ch))
+        {
+            pos++;
+            continue;
+        }
+        // a command is a list at the top level
+        if (ch != '(')
+            return commands.empty() ? PZ3_file_nosmt : PZ3_file_corrupt;
+        smt_command cmd;
+        cmd.begin = pos;
+        size_t name = pos + 1;
+        while (name < len && isspace((unsigned char) data[name]))
+            name++;
+        size_t name_end = name;
+        while (name_end < len && !isspace((unsigned char) data[name_end]) && data[name_end] != '(' && data[name_end] != ')')
+            name_end++;
+        cmd.kind = kind_of(data + name, name_end - name);
+        // SMTLIB 1 benchmarks are not supported
+        if (commands.empty() && std::string(data + name, name_end - name) == "benchmark")
+            return PZ3_file_nosmt;
+
+        unsigned depth = 0;
+        while (pos < len)
+        {
+            ch = data[pos];
+            if (ch == '(')
+                depth++;
+            else if (ch == ')')
+            {
+                depth--;
+                if (depth == 0)
+                {
+                    pos++;
+                    break;
+                }
+            }
+            else if (ch == ';')
+            {
+                while (pos < len && data[pos] != '\n')
+                    pos++;
+                continue;
+            }
+            else if (ch == '"')
+            {
+                pos++;
+                while (pos < len)
+                {
+                    // "" is a quote in a string
+                    if (data[pos] == '"' && (pos + 1 >= len || data[pos + 1] != '"'))
+                        break;
+                    pos += (data[pos] == '"') ? 2 : 1;
+                }
+            }
+            else if (ch == '|')
+            {
+                pos++;
+                while (pos < len && data[pos] != '|')
+                    pos++;
+            }
+            pos++;
+        }
+        if (depth != 0)
+            return PZ3_file_corrupt;
+        cmd.end = pos;
+        if (cmd.kind == PZ3_cmd_scope)
+            scoped = true;
+        commands.push_back(cmd);
+    }
+    return PZ3_file_ok;
+}
+
+std::string smtInput::command_text(unsigned i)
+{
+    smt_command const &cmd = commands.at(i);
+    return std::string(data + cmd.begin, cmd.end - cmd.begin);
+}
+
+void smtInput::split_command(unsigned i, std::string &name, std::string &args)
+{
+    smt_command const &cmd = commands.at(i);
+    size_t pos = cmd.begin + 1;
+    // the closing parenthesis is left out
+    size_t end = cmd.end - 1;
+    while (pos < end && isspace((unsigned char) data[pos]))
+        pos++;
+    size_t name_end = pos;
+    while (name_end < end && !isspace((unsigned char) data[name_end]) && data[name_end] != '(' && data[name_end] != ')')
+        name_end++;
+    name.assign(data + pos, name_end - pos);
+    while (name_end < end && isspace((unsigned char) data[name_end]))
+        name_end++;
+    while (end > name_end && isspace((unsigned char) data[end - 1]))
+        end--;
+    args.assign(data + name_end, end - name_end);
+}
+
+bool smtInput::parse(context &c, expr &fs)
+{
+    Z3_ast m_fs = Z3_parse_smtlib2_string(c, data, 0, 0, 0, 0, 0, 0);
+    if (Z3_get_error_code(c) != Z3_OK)
+        return false;
+    fs = expr(c, m_fs);
+    return true;
+}
+
+smt_reader::smt_reader(smtInput &in, context &c) : input(in), ctx(c)
+{
+    next_cmd = 0;
+    error = false;
+}
+
+bool smt_reader::next(expr &fs)
+{
+    unsigned cmd_num = input.commands.size();
+    if (error || next_cmd >= cmd_num)
+        return false;
+    // assertions depend on the scopes around them, so such an input is one chunk
+    if (input.scoped)
+    {
+        next_cmd = cmd_num;
+        error = !input.parse(ctx, fs);
+        return !error;
+    }
+    chunk.clear();
+    size_t limit = std::max((size_t) PZ3_CHUNK_BYTES, prelude.size());
+    while (next_cmd < cmd_num && chunk.size() < limit)
+    {
+        smt_command const &cmd = input.commands[next_cmd++];
+        char const *text = input.data + cmd.begin;
+        size_t text_len = cmd.end - cmd.begin;
+        if (cmd.kind == PZ3_cmd_assert)
+        {
+            chunk.append(text, text_len);
+            chunk.push_back('\n');
+        }
+        else if (cmd.kind == PZ3_cmd_decl)
+        {
+            prelude.append(text, text_len);
+            prelude.push_back('\n');
+        }
+    }
+    // declarations after the last assertion make no chunk
+    if (chunk.empty())
+        return false;
+    chunk.insert(0, prelude);
+    Z3_ast m_fs = Z3_parse_smtlib2_string(ctx, chunk.c_str(), 0, 0, 0, 0, 0, 0);
+    if (Z3_get_error_code(ctx) != Z3_OK)
+    {
+        error = true;
+        return false;
+    }
+    fs = expr(ctx, m_fs);
+    return true;
+}
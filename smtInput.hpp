@@ -0,0 +1,129 @@
+#ifndef _SMT_INPUT_H_
+#define _SMT_INPUT_H_
+
+#include "core.hpp"
+#include <string>
+
+// assertions parsed at once by smt_reader, unless the declarations before them are longer
+#define PZ3_CHUNK_BYTES (1u << 20)
+
+typedef enum
+{
+    // assert
+    PZ3_cmd_assert,
+    // set-logic, set-option, set-info, declarations and definitions: repeated before every chunk
+    PZ3_cmd_decl,
+    // push, pop, reset: the input is parsed as a whole
+    PZ3_cmd_scope,
+    // check-sat, get-*, exit and others: left out of chunks
+    PZ3_cmd_other
+} PZ3_Cmd_Kind;
+
+/* Message telling why an input cannot be read */
+char const *file_reason(PZ3_File_Result pfr);
+
+// smt_command: a top-level command, as a range of the text
+struct smt_command
+{
+    size_t begin;
+    size_t end;
+    PZ3_Cmd_Kind kind;
+};
+
+/*
+  smtInput: the text of an SMTLIB2 input, read once and shared by all threads parsing it. A file is
+  mapped into memory, "-" is stdin read to its end, and gzip input (known by its magic bytes) is
+  inflated; so is zstd input when built with PZ3_ZSTD. Whatever the extension, the text must start
+  with a command or a comment. It is split into top-level commands when opened, so smt_reader can
+  parse a formula a chunk of assertions at a time.
+*/
+class smtInput
+{
+protected:
+    // data: the text, always followed by a NUL
+    char const *data;
+    size_t len;
+    void *map_addr;
+    size_t map_len;
+    // buf: the text when it is not mapped (stdin, inflated or given as a string)
+    std::string buf;
+    std::vector<smt_command> commands;
+    bool scoped;
+
+    PZ3_File_Result read_stdin();
+    PZ3_File_Result map_file(std::string const &path);
+    /* Replace the text by its inflated content if it is compressed */
+    PZ3_File_Result inflate();
+    /* Split the text into commands */
+    PZ3_File_Result scan();
+
+    smtInput(smtInput const &);
+    smtInput &operator=(smtInput const &);
+
+public:
+    smtInput();
+    ~smtInput();
+    /* Read a file, or stdin if path is "-" */
+    PZ3_File_Result open(std::string const &path);
+    /* Take a text kept by the caller while this input is open */
+    PZ3_File_Result set_text(std::string const &text);
+    void close();
+
+    char const *c_str()
+    {
+        return data;
+    }
+
+    size_t size()
+    {
+        return len;
+    }
+
+    unsigned command_num()
+    {
+        return commands.size();
+    }
+
+    PZ3_Cmd_Kind command_kind(unsigned i)
+    {
+        return commands.at(i).kind;
+    }
+
+    /* Text of the i-th command */
+    std::string command_text(unsigned i);
+
+    /* Name of the i-th command and the text of its arguments */
+    void split_command(unsigned i, std::string &name, std::string &args);
+
+    /* Parse the whole input into context c */
+    bool parse(context &c, expr &fs);
+
+    friend class smt_reader;
+};
+
+/*
+  smt_reader: assertions of an input parsed into one context a chunk at a time. Declarations met so
+  far are parsed again with every chunk, so terms of all chunks share their declarations.
+*/
+class smt_reader
+{
+protected:
+    smtInput &input;
+    context &ctx;
+    unsigned next_cmd;
+    std::string prelude;
+    std::string chunk;
+    bool error;
+
+public:
+    smt_reader(smtInput &in, context &c);
+    /* Conjunction of the next chunk of assertions; false at the end or on an error */
+    bool next(expr &fs);
+
+    bool failed()
+    {
+        return error;
+    }
+};
+
+#endif
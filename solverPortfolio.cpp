@@ -0,0 +1,175 @@
+#include "solverPortfolio.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+solverPortfolio::solverPortfolio()
+{
+    warned = false;
+    pthread_mutex_init(&mutex, NULL);
+    set_single();
+}
+
+solverPortfolio::~solverPortfolio()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+void solverPortfolio::add(std::string const &line)
+{
+    std::istringstream in(line);
+    solver_config cfg;
+    if (!(in >> cfg.name) || cfg.name[0] == '#')
+        return;
+    std::string item;
+    while (in >> item)
+    {
+        std::string::size_type eq = item.find('=');
+        if (eq == std::string::npos)
+        {
+            std::cerr << "Ignored setting without value in portfolio: " << item << "\n";
+            continue;
+        }
+        cfg.settings.push_back(std::pair<std::string, std::string>(item.substr(0, eq), item.substr(eq + 1)));
+    }
+    configs.push_back(cfg);
+    races.push_back(0);
+    wins.push_back(0);
+}
+
+void solverPortfolio::set_single()
+{
+    configs.clear();
+    races.clear();
+    wins.clear();
+    add("default");
+}
+
+void solverPortfolio::set_default()
+{
+    set_single();
+    add("seed7 random_seed=7");
+    add("luby restart_strategy=2 random_seed=13");
+    add("phase-false phase_selection=0 random_seed=29");
+    add("phase-random phase_selection=4 random_seed=41");
+}
+
+bool solverPortfolio::load(std::string const &path)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+        return false;
+    configs.clear();
+    races.clear();
+    wins.clear();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        add(line);
+    }
+    // there is always a configuration to start with
+    if (configs.empty())
+        add("default");
+    return true;
+}
+
+std::string solverPortfolio::get_line(unsigned index)
+{
+    solver_config &cfg = configs.at(index);
+    std::string line = cfg.name;
+    for (unsigned i = 0; i < cfg.settings.size(); i++)
+    {
+        line += " " + cfg.settings[i].first + "=" + cfg.settings[i].second;
+    }
+    return line;
+}
+
+void solverPortfolio::set_line(std::string const &line)
+{
+    configs.clear();
+    races.clear();
+    wins.clear();
+    add(line);
+    if (configs.empty())
+        add("default");
+}
+
+unsigned solverPortfolio::size()
+{
+    return configs.size();
+}
+
+std::string const &solverPortfolio::get_name(unsigned index)
+{
+    return configs.at(index).name;
+}
+
+void solverPortfolio::apply(solver &s, unsigned index, unsigned timeout_ms)
+{
+    solver_config &cfg = configs.at(index);
+    if (cfg.settings.empty() && timeout_ms == 0)
+        return;
+    params p(s.ctx());
+    if (timeout_ms > 0)
+        p.set("timeout", timeout_ms);
+    for (unsigned i = 0; i < cfg.settings.size(); i++)
+    {
+        char const *key = cfg.settings[i].first.c_str();
+        std::string const &value = cfg.settings[i].second;
+        char *end = NULL;
+        double num = strtod(value.c_str(), &end);
+        if (value == "true" || value == "false")
+            p.set(key, value == "true");
+        else if (value.find_first_not_of("0123456789") == std::string::npos)
+            p.set(key, (unsigned) strtoul(value.c_str(), NULL, 10));
+        else if (end != value.c_str() && *end == '\0')
+            p.set(key, num);
+        else
+            p.set(key, s.ctx().str_symbol(value.c_str()));
+    }
+    try
+    {
+        s.set(p);
+    }
+    catch (exception &ex)
+    {
+        // unknown parameter for this version of Z3: keep solving with defaults
+        pthread_mutex_lock(&mutex);
+        if (!warned)
+            std::cerr << "Portfolio configuration " << cfg.name << " not applied: " << ex.msg() << "\n";
+        warned = true;
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+void solverPortfolio::record_race(unsigned index)
+{
+    pthread_mutex_lock(&mutex);
+    races.at(index)++;
+    pthread_mutex_unlock(&mutex);
+}
+
+void solverPortfolio::record_win(unsigned index)
+{
+    pthread_mutex_lock(&mutex);
+    wins.at(index)++;
+    pthread_mutex_unlock(&mutex);
+}
+
+void solverPortfolio::report(std::ostream &out)
+{
+    pthread_mutex_lock(&mutex);
+    unsigned total = 0;
+    for (unsigned i = 0; i < races.size(); i++)
+        total += races[i];
+    // nothing to report if no sub-problem was raced on
+    if (total > 0)
+    {
+        out << "Portfolio (configuration: wins/races):" << std::endl;
+        for (unsigned i = 0; i < configs.size(); i++)
+        {
+            out << "  " << configs[i].name << ": " << wins[i] << "/" << races[i] << std::endl;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,62 @@
+#ifndef _SOLVER_PORTFOLIO_H_
+#define _SOLVER_PORTFOLIO_H_
+
+#include <z3++.h>
+#include <pthread.h>
+#include <vector>
+#include <string>
+#include <iostream>
+
+using namespace z3;
+
+// solver_config: named set of solver parameters, given as strings "key=value"
+struct solver_config
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string> > settings;
+};
+
+/*
+  solverPortfolio: configurations of Z3 which race on hard sub-problems
+  Configuration 0 is the one every sub-problem starts with. Cores done with their own sub-problem
+  run the other configurations on unfinished ones, and the first result wins. A portfolio starts with
+  the default configuration alone, so nothing races unless more are set or loaded.
+  A portfolio file has one configuration per line: a name followed by key=value pairs, e.g.
+      luby restart_strategy=2 random_seed=13
+  Lines starting with '#' are ignored.
+*/
+class solverPortfolio
+{
+protected:
+    std::vector<solver_config> configs;
+    // races: times a configuration took part in a race, wins: times it finished first
+    std::vector<unsigned> races;
+    std::vector<unsigned> wins;
+    bool warned;
+    pthread_mutex_t mutex;
+
+    void add(std::string const &line);
+
+public:
+    solverPortfolio();
+    ~solverPortfolio();
+    /* Only default parameters, nothing races */
+    void set_single();
+    /* Built-in configurations: default parameters, other seeds, restart and phase strategies */
+    void set_default();
+    /* Read configurations from a portfolio file */
+    bool load(std::string const &path);
+    /* A configuration as a line of a portfolio file */
+    std::string get_line(unsigned index);
+    /* Only the configuration of a line of a portfolio file */
+    void set_line(std::string const &line);
+    unsigned size();
+    std::string const &get_name(unsigned index);
+    /* Set parameters of a configuration on a solver, and a time limit of its checks if not 0 */
+    void apply(solver &s, unsigned index, unsigned timeout_ms = 0);
+    void record_race(unsigned index);
+    void record_win(unsigned index);
+    void report(std::ostream &out);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "symbolTable.hpp"
+#include <algorithm>
+#include <sstream>
+
+// name of a symbol; integer symbols (e.g. of auxiliary variables) get a prefix no SMT-LIB simple symbol starts with
+static std::string symbol_name(symbol const &sym)
+{
+    if (sym.kind() == Z3_STRING_SYMBOL)
+        return sym.str();
+    std::ostringstream out;
+    out << "#" << Z3_get_symbol_int(sym.ctx(), sym);
+    return out.str();
+}
+
+// key of a declaration: its name, then the sorts of its arguments and its range, separated by NUL
+// (which a name of SMT-LIB cannot have)
+std::string symbolTable::symbol_key(func_decl const &fd)
+{
+    std::string key = symbol_name(fd.name());
+    unsigned arity = fd.arity();
+    for (unsigned i = 0; i <= arity; i++)
+    {
+        sort s = (i < arity) ? fd.domain(i) : fd.range();
+        key.push_back('\0');
+        key.append(Z3_sort_to_string(fd.ctx(), s));
+    }
+    return key;
+}
+
+symbolTable::symbolTable()
+{
+    pthread_mutex_init(&mutex, NULL);
+}
+
+symbolTable::~symbolTable()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+unsigned symbolTable::intern(std::string const &key, bool is_func, unsigned arity, int weight)
+{
+    pthread_mutex_lock(&mutex);
+    std::pair<flat_map<std::string, unsigned>::iterator, bool> ret;
+    ret = key_map.insert(std::pair<std::string, unsigned>(key, arities.size()));
+    if (ret.second)
+    {
+        arities.push_back(arity);
+        func_flags.push_back(is_func);
+        weights.push_back(weight);
+    }
+    unsigned id = ret.first->second;
+    pthread_mutex_unlock(&mutex);
+    return id;
+}
+
+unsigned symbolTable::size()
+{
+    pthread_mutex_lock(&mutex);
+    unsigned num = arities.size();
+    pthread_mutex_unlock(&mutex);
+    return num;
+}
+
+void symbolTable::clear()
+{
+    pthread_mutex_lock(&mutex);
+    key_map.clear();
+    arities.clear();
+    func_flags.clear();
+    weights.clear();
+    pthread_mutex_unlock(&mutex);
+}
+
+void symbolTable::get_keys(std::vector<std::string> &keys)
+{
+    pthread_mutex_lock(&mutex);
+    keys.resize(arities.size());
+    for (flat_map<std::string, unsigned>::iterator it = key_map.begin(); it != key_map.end(); ++it)
+        keys[it->second] = it->first;
+    pthread_mutex_unlock(&mutex);
+}
+
+bool symbolTable::is_func(unsigned id)
+{
+    pthread_mutex_lock(&mutex);
+    bool flag = func_flags.at(id) != 0;
+    pthread_mutex_unlock(&mutex);
+    return flag;
+}
+
+unsigned symbolTable::get_arity(unsigned id)
+{
+    pthread_mutex_lock(&mutex);
+    unsigned arity = arities.at(id);
+    pthread_mutex_unlock(&mutex);
+    return arity;
+}
+
+int symbolTable::get_weight(unsigned id)
+{
+    pthread_mutex_lock(&mutex);
+    int weight = weights.at(id);
+    pthread_mutex_unlock(&mutex);
+    return weight;
+}
+
+void symbolTable::get_weights(std::vector<int> &all)
+{
+    pthread_mutex_lock(&mutex);
+    all = weights;
+    pthread_mutex_unlock(&mutex);
+}
+
+unsigned symbol_cache::var_id(expr const &fs)
+{
+    func_decl fd = fs.decl();
+    unsigned ast_id = Z3_get_ast_id(fd.ctx(), fd);
+    flat_map<unsigned, unsigned>::iterator it = decl_map.find(ast_id);
+    if (it != decl_map.end())
+        return it->second;
+    // FIXME: weight of variable
+    unsigned id = table->intern(symbolTable::symbol_key(fd), false, 0, PZ3_VAR_WEIGHT);
+    decl_map.insert(std::pair<unsigned, unsigned>(ast_id, id));
+    return id;
+}
+
+unsigned symbol_cache::fun_id(func_decl const &fd)
+{
+    unsigned ast_id = Z3_get_ast_id(fd.ctx(), fd);
+    flat_map<unsigned, unsigned>::iterator it = decl_map.find(ast_id);
+    if (it != decl_map.end())
+        return it->second;
+    // FIXME: weight of function (arity considered)
+    unsigned arity = fd.arity();
+    unsigned id = table->intern(symbolTable::symbol_key(fd), true, arity, arity * PZ3_FUNC_WEIGHT);
+    decl_map.insert(std::pair<unsigned, unsigned>(ast_id, id));
+    return id;
+}
+
+void sort_symbols(symbol_list &list)
+{
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+}
+
+void merge_symbols(symbol_list &list, symbol_list &ids, bool add)
+{
+    if (ids.empty())
+        return;
+    sort_symbols(ids);
+    symbol_list out(add ? list.size() + ids.size() : list.size());
+    symbol_list::iterator end;
+    if (add)
+        end = std::merge(list.begin(), list.end(), ids.begin(), ids.end(), out.begin());
+    else
+        end = std::set_difference(list.begin(), list.end(), ids.begin(), ids.end(), out.begin());
+    out.erase(end, out.end());
+    list.swap(out);
+}
@@ -0,0 +1,78 @@
+#ifndef _SYMBOL_TABLE_H_
+#define _SYMBOL_TABLE_H_
+
+#include "core.hpp"
+#include "flatMap.hpp"
+#include <string>
+#include <pthread.h>
+
+// symbolTable: interning table giving each distinct uninterpreted symbol a dense id
+// Symbols are identified by their key, the name with the sorts of the arguments and the range
+// (see symbol_key()), so the same symbol parsed in different contexts gets the same id, overloads
+// of a name get ids of their own, and unlike hash() values two distinct symbols never share an id.
+// Variables and functions share one id space; weights are kept per id. Division threads intern
+// while others read, so every access takes the lock.
+class symbolTable
+{
+protected:
+    pthread_mutex_t mutex;
+    flat_map<std::string, unsigned> key_map;
+    std::vector<unsigned> arities;
+    std::vector<char> func_flags;
+    std::vector<int> weights;
+
+public:
+    symbolTable();
+    ~symbolTable();
+
+    /* Get id of a symbol by its key, add it if it is new (thread-safe) */
+    unsigned intern(std::string const &key, bool is_func, unsigned arity, int weight);
+
+    /* Number of symbols interned so far */
+    unsigned size();
+
+    /* Forget all symbols */
+    void clear();
+
+    /* Keys of all symbols by id */
+    void get_keys(std::vector<std::string> &keys);
+
+    /* Key of a declaration, the same in every context */
+    static std::string symbol_key(func_decl const &fd);
+
+    bool is_func(unsigned id);
+    unsigned get_arity(unsigned id);
+    int get_weight(unsigned id);
+    /* Weights of all symbols by id, copied under one lock */
+    void get_weights(std::vector<int> &all);
+};
+
+// symbol_cache: per-thread front-end of a symbolTable
+// Declarations are cached by their AST id in the thread's own context, so the shared table
+// (and its lock) is only visited once per distinct declaration.
+class symbol_cache
+{
+protected:
+    symbolTable *table;
+    flat_map<unsigned, unsigned> decl_map;
+
+public:
+    symbol_cache(symbolTable &tab)
+    {
+        table = &tab;
+    }
+
+    /* Id of an uninterpreted constant */
+    unsigned var_id(expr const &fs);
+
+    /* Id of an uninterpreted function */
+    unsigned fun_id(func_decl const &fd);
+};
+
+/* Sort a symbol list and remove duplicates */
+void sort_symbols(symbol_list &list);
+
+/* Add symbols of ids to a sorted list (add) or remove them from it (ids are sorted here) */
+void merge_symbols(symbol_list &list, symbol_list &ids, bool add);
+
+#endif
@@ -0,0 +1,336 @@
+#include "workerProcess.hpp"
+#include "symbolTable.hpp"
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+/*
+  Uninterpreted functions of a formula by their key (see symbolTable), so shared functions named
+  by the solver are found
+*/
+static void collect_funcs(expr fs, std::map<std::string, func_decl> &funcs)
+{
+    std::set<unsigned> visited;
+    std::vector<expr> todo;
+    todo.push_back(fs);
+    while (!todo.empty())
+    {
+        expr e = todo.back();
+        todo.pop_back();
+        if (!e.is_app() || !visited.insert(Z3_get_ast_id(e.ctx(), e)).second)
+            continue;
+        func_decl fd = e.decl();
+        if (fd.decl_kind() == Z3_OP_UNINTERPRETED && fd.arity() > 0)
+            funcs.insert(std::pair<std::string, func_decl>(symbolTable::symbol_key(fd), fd));
+        unsigned num = e.num_args();
+        for (unsigned i = 0; i < num; i++)
+            todo.push_back(e.arg(i));
+    }
+}
+
+workerProcess::workerProcess()
+{
+    pid = -1;
+    fd = -1;
+}
+
+workerProcess::~workerProcess()
+{
+    stop();
+}
+
+bool workerProcess::write_all(int fd, char const *data, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = ::send(fd, data + done, len - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+bool workerProcess::read_all(int fd, char *data, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = read(fd, data + done, len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    return true;
+}
+
+bool workerProcess::send_msg(int fd, unsigned type, std::string const &body)
+{
+    uint32_t header[2];
+    header[0] = type;
+    header[1] = body.size();
+    return write_all(fd, (char const *) header, sizeof(header)) && write_all(fd, body.data(), body.size());
+}
+
+bool workerProcess::recv_msg(int fd, unsigned &type, std::string &body)
+{
+    uint32_t header[2];
+    if (!read_all(fd, (char *) header, sizeof(header)))
+        return false;
+    type = header[0];
+    body.resize(header[1]);
+    return header[1] == 0 || read_all(fd, &body[0], header[1]);
+}
+
+bool workerProcess::send(unsigned type, std::string const &body)
+{
+    return send_msg(fd, type, body);
+}
+
+bool workerProcess::recv(unsigned &type, std::string &body)
+{
+    return recv_msg(fd, type, body);
+}
+
+bool workerProcess::start(std::string const &program, int cpu)
+{
+    if (program.empty() || access(program.c_str(), X_OK) != 0)
+        return false;
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+        return false;
+    // everything the child needs is made before fork, as it may only make async-signal-safe calls
+    std::ostringstream fd_arg;
+    fd_arg << fds[1];
+    std::string fd_text = fd_arg.str();
+    char const *args[] = {program.c_str(), "--worker", fd_text.c_str(), NULL};
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu >= 0)
+        CPU_SET(cpu, &set);
+    pid_t child = fork();
+    if (child < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (child == 0)
+    {
+        if (cpu >= 0)
+            sched_setaffinity(0, sizeof(set), &set);
+        // the socket of this worker is the only one kept, so a dead worker is seen by the solver
+        fcntl(fds[1], F_SETFD, 0);
+        execv(program.c_str(), (char *const *) args);
+        _exit(127);
+    }
+    close(fds[1]);
+    pid = child;
+    fd = fds[0];
+    return true;
+}
+
+void workerProcess::interrupt()
+{
+    // a check in the worker cannot be stopped from here, so we stop listening, and stop() kills it
+    if (fd >= 0)
+        shutdown(fd, SHUT_RDWR);
+}
+
+void workerProcess::stop()
+{
+    if (pid > 0)
+    {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        pid = -1;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+std::string workerProcess::failure()
+{
+    // told already
+    if (pid <= 0)
+        return "";
+    int status;
+    pid_t done = waitpid(pid, &status, 0);
+    pid = -1;
+    if (done < 0)
+        return "is lost";
+    std::ostringstream out;
+    if (WIFSIGNALED(status))
+        out << "was killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+    else
+        out << "exited with status " << WEXITSTATUS(status);
+    return out.str();
+}
+
+// ERROR: a document with the message
+static bool send_error(int fd, std::string const &message)
+{
+    binWriter doc, section;
+    doc.put_header();
+    section.put(message);
+    doc.put_section(PZ3_sec_error, section);
+    return workerProcess::send_msg(fd, PZ3_msg_error, doc.data());
+}
+
+int workerProcess::serve(int fd)
+{
+    solverPortfolio portfolio;
+    unsigned timeout_ms = 0;
+    config cfg;
+    cfg.set("MODEL", true);
+    cfg.set("PROOF", true);
+    context c(cfg);
+    expr part(c);
+    std::map<std::string, func_decl> funcs;
+    unsigned type;
+    std::string body;
+    while (recv_msg(fd, type, body))
+    {
+        binReader in(body);
+        binReader section(NULL, 0);
+        binWriter doc, out;
+        exprDecoder table(c);
+        doc.put_header();
+        if (!in.get_header())
+        {
+            if (!send_error(fd, "cannot read a message of this version"))
+                break;
+            continue;
+        }
+        if (type == PZ3_msg_load)
+        {
+            std::string line;
+            unsigned root_num;
+            bool ok = in.find_section(PZ3_sec_config, section) && section.get(line) && section.get(timeout_ms);
+            ok = ok && in.find_section(PZ3_sec_exprs, section) && table.read(section) && section.get(root_num);
+            if (!ok || root_num != 1 || !table.get(section, part))
+            {
+                if (!send_error(fd, "cannot read its sub-formula"))
+                    break;
+                continue;
+            }
+            portfolio.set_line(line);
+            funcs.clear();
+            collect_funcs(part, funcs);
+            solver s(c);
+            portfolio.apply(s, 0, timeout_ms);
+            s.add(part);
+            out.put((unsigned) s.check());
+            doc.put_section(PZ3_sec_result, out);
+        }
+        else if (type == PZ3_msg_check)
+        {
+            // roots: the constraint, then the probe terms
+            unsigned root_num, fun_num;
+            expr constr(c);
+            bool ok = in.find_section(PZ3_sec_exprs, section) && table.read(section) && section.get(root_num);
+            ok = ok && root_num > 0 && table.get(section, constr);
+            expr_vector probes(c);
+            for (unsigned i = 1; ok && i < root_num; i++)
+            {
+                expr probe(c);
+                ok = table.get(section, probe);
+                probes.push_back(probe);
+            }
+            ok = ok && in.find_section(PZ3_sec_shared_funcs, section) && section.get(fun_num);
+            std::map<unsigned, func_decl> shared_funs;
+            for (unsigned i = 0; ok && i < fun_num; i++)
+            {
+                unsigned fun_id;
+                std::string key;
+                ok = section.get(fun_id) && section.get(key);
+                std::map<std::string, func_decl>::iterator it = funcs.find(key);
+                if (ok && it != funcs.end())
+                    shared_funs.insert(std::pair<unsigned, func_decl>(fun_id, it->second));
+            }
+            // without a configuration, the one of LOAD is kept
+            std::string line;
+            if (ok && in.find_section(PZ3_sec_config, section))
+            {
+                ok = section.get(line) && section.get(timeout_ms);
+                if (ok)
+                    portfolio.set_line(line);
+            }
+            if (!ok)
+            {
+                if (!send_error(fd, "cannot read a constraint"))
+                    break;
+                continue;
+            }
+            solver s(c);
+            portfolio.apply(s, 0, timeout_ms);
+            s.add(part);
+            s.add(constr);
+            check_result result = s.check();
+            out.put((unsigned) result);
+            doc.put_section(PZ3_sec_result, out);
+            if (result == unsat)
+            {
+                expr proof = s.proof();
+                array<Z3_ast> _sts(2);
+                _sts[0] = part;
+                _sts[1] = constr;
+                Z3_ast _interp;
+                Z3_interpolate_proof(c, proof, 2, _sts.ptr(), 0, 0, &_interp, 0, 0);
+                exprEncoder interp_table;
+                unsigned root;
+                if (!interp_table.add(to_expr(c, _interp), root))
+                {
+                    if (!send_error(fd, "made an interpolant beyond QF_UF"))
+                        break;
+                    continue;
+                }
+                out.clear();
+                interp_table.write(out);
+                out.put(1u);
+                out.put(root);
+                doc.put_section(PZ3_sec_interpolants, out);
+            }
+            else if (result == sat)
+            {
+                // values of probe terms by their index, and entries of shared functions
+                model m = s.get_model();
+                closure_list values(probes.size());
+                for (unsigned i = 0; i < probes.size(); i++)
+                {
+                    values[i].first = i;
+                    values[i].second.set(m.eval(probes[i]));
+                }
+                out.clear();
+                out.put(values);
+                doc.put_section(PZ3_sec_svexpr, out);
+                entry_list entries;
+                read_entries(m, shared_funs, entries);
+                out.clear();
+                out.put(entries);
+                doc.put_section(PZ3_sec_sfist, out);
+            }
+        }
+        else
+        {
+            break;
+        }
+        if (!send_msg(fd, PZ3_msg_result, doc.data()))
+            break;
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef _WORKER_PROCESS_H_
+#define _WORKER_PROCESS_H_
+
+#include "core.hpp"
+#include "solverPortfolio.hpp"
+#include "exprCodec.hpp"
+#include <sys/types.h>
+#include <stdint.h>
+#include <sstream>
+#include <string>
+
+/*
+  Messages between a solver and the worker process of a partition. Every message is a header of
+  two 32-bit numbers, its type and the length of its body, followed by the body. A body is a
+  document of the binary format (see exprCodec.hpp), so either side refuses a message of a newer
+  version and skips sections it does not know. Formulas of a message share one expression table
+  followed by the indices of their roots, so they can be read into any context. The stream is a
+  Unix socket, and the same messages can go over TCP to other nodes.
+*/
+typedef enum
+{
+    // solver to worker
+    // LOAD: config (a line of a portfolio file, time limit), exprs (the sub-formula). The worker
+    // keeps the sub-formula and checks it.
+    PZ3_msg_load = 1,
+    // CHECK: config (the configuration which solved the sub-formula first), exprs (the constraint,
+    // then the probe terms), shared_funcs. The worker checks the constraint with the sub-formula.
+    PZ3_msg_check,
+    // worker to solver
+    // RESULT: result, then interpolants (unsat), or svexpr (values of probe terms by index) and
+    // sfist (entries of shared functions in the model) (sat)
+    PZ3_msg_result,
+    // ERROR: error, a formula cannot be read or written
+    PZ3_msg_error
+} PZ3_Msg_Type;
+
+/*
+  workerProcess: a process checking the sub-formula of a partition in its own Z3 context, so a crash
+  or a blow-up of memory in the search of one partition does not take the whole solver down, and
+  contexts do not share the allocator of one process.
+  The calling process may have other threads holding locks of malloc or Z3 at any time (other
+  solvers, the application embedding pz3), so the child of fork() only binds itself to its CPU and
+  executes a program which serves as a worker: pz3 itself, started as "pz3 --worker <fd>", calls
+  serve() on the socket it is given. Sockets are closed on exec, except the one of the worker.
+*/
+class workerProcess
+{
+protected:
+    pid_t pid;
+    // fd: our end of the socket pair, the worker has the other one
+    int fd;
+
+    static bool write_all(int fd, char const *data, size_t len);
+    static bool read_all(int fd, char *data, size_t len);
+
+    workerProcess(workerProcess const &);
+    workerProcess &operator=(workerProcess const &);
+
+public:
+    workerProcess();
+    ~workerProcess();
+    /* Start program as the worker, bound to cpu if not negative */
+    bool start(std::string const &program, int cpu);
+    bool send(unsigned type, std::string const &body);
+    bool recv(unsigned &type, std::string &body);
+    /* Make a recv waiting on the worker fail, from another thread; the worker runs until stop() */
+    void interrupt();
+    /* Stop the worker, even in the middle of a check */
+    void stop();
+    /* After send or recv failed: wait for the worker and tell how it ended, the first time only */
+    std::string failure();
+
+    static bool send_msg(int fd, unsigned type, std::string const &body);
+    static bool recv_msg(int fd, unsigned &type, std::string &body);
+    /* Main loop of a worker process on the socket fd, until the solver closes it */
+    static int serve(int fd);
+};
+
+#endif